@@ -0,0 +1,132 @@
+//
+// 缓存并发读写压测，不依赖网络，对比单分段与多分段缓存在多线程下的吞吐
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include <apr_thread_proc.h>
+
+#include "hdns_api.h"
+#include "hdns_cache.h"
+
+#define MOCK_HOST_COUNT           1024
+#define MOCK_OPS_PER_THREAD       200000
+// 每100次操作中写操作的次数
+#define MOCK_WRITE_PERCENT        5
+#define MAX_THREAD_COUNT          64
+
+typedef struct {
+    hdns_cache_t *cache;
+    char **hosts;
+    uint32_t seed;
+    int64_t hits;
+} hdns_bench_task_t;
+
+static uint32_t next_random(uint32_t *seed) {
+    // xorshift32，避免rand()内部锁影响压测结果
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+static hdns_cache_entry_t *create_mock_entry(hdns_pool_t *pool, const char *host) {
+    hdns_cache_entry_t *entry = hdns_resv_resp_create_empty(pool, host, HDNS_RR_TYPE_A);
+    entry->cache_key = apr_pstrdup(pool, host);
+    entry->ttl = 600;
+    entry->origin_ttl = 600;
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    return entry;
+}
+
+static void *APR_THREAD_FUNC cache_bench_thread_fn(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    hdns_bench_task_t *task = data;
+    hdns_pool_new(pool);
+    // 随机种子和命中数使用局部变量，结束时写回一次，避免相邻task共享缓存行
+    uint32_t seed = task->seed;
+    int64_t hits = 0;
+    for (int i = 0; i < MOCK_OPS_PER_THREAD; i++) {
+        uint32_t r = next_random(&seed);
+        char *host = task->hosts[r % MOCK_HOST_COUNT];
+        if ((r >> 16) % 100 < MOCK_WRITE_PERCENT) {
+            hdns_pool_new_with_pp(entry_pool, pool);
+            hdns_cache_table_add(task->cache, create_mock_entry(entry_pool, host));
+            hdns_pool_destroy(entry_pool);
+            continue;
+        }
+        hdns_cache_entry_t *entry = hdns_cache_table_get(task->cache, host, HDNS_RR_TYPE_A);
+        if (entry != NULL) {
+            hits++;
+        }
+        hdns_resv_resp_destroy(entry);
+    }
+    task->seed = seed;
+    task->hits = hits;
+    hdns_pool_destroy(pool);
+    return NULL;
+}
+
+static double run_cache_bench(uint32_t shard_count, int thread_count, char **hosts) {
+    hdns_pool_new(pool);
+    hdns_cache_t *cache = hdns_cache_table_create_with_shards(shard_count);
+    for (int i = 0; i < MOCK_HOST_COUNT; i++) {
+        hdns_pool_new_with_pp(entry_pool, pool);
+        hdns_cache_table_add(cache, create_mock_entry(entry_pool, hosts[i]));
+        hdns_pool_destroy(entry_pool);
+    }
+    apr_thread_t *threads[MAX_THREAD_COUNT];
+    hdns_bench_task_t tasks[MAX_THREAD_COUNT];
+    apr_time_t start = apr_time_now();
+    for (int i = 0; i < thread_count; i++) {
+        tasks[i].cache = cache;
+        tasks[i].hosts = hosts;
+        tasks[i].seed = 2463534242u + i * 7919;
+        tasks[i].hits = 0;
+        apr_thread_create(&threads[i], NULL, cache_bench_thread_fn, &tasks[i], pool);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        apr_status_t rv;
+        apr_thread_join(&rv, threads[i]);
+    }
+    apr_time_t cost_us = hdns_max(apr_time_now() - start, 1);
+    hdns_cache_table_cleanup(cache);
+    hdns_pool_destroy(pool);
+    return (double) thread_count * MOCK_OPS_PER_THREAD / ((double) cost_us / APR_USEC_PER_SEC);
+}
+
+int main(int argc, char *argv[]) {
+    hdns_unused_var(argv);
+    hdns_unused_var(argc);
+    if (hdns_sdk_init() != HDNS_OK) {
+        hdns_sdk_cleanup();
+        return -1;
+    }
+    hdns_pool_new(pool);
+    char **hosts = hdns_palloc(pool, MOCK_HOST_COUNT * sizeof(char *));
+    for (int i = 0; i < MOCK_HOST_COUNT; i++) {
+        hosts[i] = apr_psprintf(pool, "host-%d.bench.example.com", i);
+    }
+    int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    uint32_t shard_counts[] = {1, HDNS_CACHE_DEFAULT_SHARD_COUNT, 64};
+    printf("Cache Benchmark Summary (%d hosts, %d ops/thread, %d%% writes): \n",
+           MOCK_HOST_COUNT, MOCK_OPS_PER_THREAD, MOCK_WRITE_PERCENT);
+    printf("%-10s", "threads");
+    for (size_t j = 0; j < sizeof(shard_counts) / sizeof(shard_counts[0]); j++) {
+        printf("\t%4u shard(s) ops/s", shard_counts[j]);
+    }
+    printf("\n");
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        printf("%-10d", thread_counts[i]);
+        for (size_t j = 0; j < sizeof(shard_counts) / sizeof(shard_counts[0]); j++) {
+            printf("\t%18.0f", run_cache_bench(shard_counts[j], thread_counts[i], hosts));
+        }
+        printf("\n");
+    }
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    return 0;
+}
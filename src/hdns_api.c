@@ -5,7 +5,9 @@
 #include "hdns_log.h"
 #include "hdns_status.h"
 #include "hdns_client.h"
+#include "hdns_clock.h"
 #include "hdns_session.h"
+#include "hdns_utils.h"
 #include "apr_thread_pool.h"
 
 #define HDNS_THREAD_POOL_CORE_SIZE  4
@@ -29,6 +31,11 @@ static volatile int32_t g_hdns_api_initialized = 0;
 
 static hdns_net_detector_t *g_hdns_net_detector = NULL;
 
+// 按账号共享缓存和调度器的客户端分组
+static apr_thread_mutex_t *g_hdns_client_group_lock = NULL;
+
+static hdns_list_head_t *g_hdns_client_groups = NULL;
+
 
 static void empty_hdns_resv_done_callback(hdns_status_t *status, hdns_list_head_t *results, void *param) {
     hdns_unused_var(status);
@@ -75,9 +82,23 @@ int hdns_sdk_init() {
     apr_thread_pool_idle_wait_set(g_hdns_api_thread_pool, apr_time_from_sec(HDNS_THREAD_IDLE_TIME));
 
     g_hdns_net_detector = hdns_net_detector_create(g_hdns_api_thread_pool);
+    apr_thread_mutex_create(&g_hdns_client_group_lock, APR_THREAD_MUTEX_DEFAULT, g_hdns_api_pool);
+    g_hdns_client_groups = hdns_list_new(g_hdns_api_pool);
 
     srand((unsigned) time(NULL));
 
+    if (hdns_clock_init(g_hdns_api_pool) != HDNS_OK) {
+        hdns_log_fatal("create clock lock failed.");
+        return HDNS_ERROR;
+    }
+    if (hdns_cache_local_init(g_hdns_api_pool) != HDNS_OK) {
+        hdns_log_fatal("create thread local cache key failed.");
+        return HDNS_ERROR;
+    }
+    if (hdns_resolver_init(g_hdns_api_pool) != HDNS_OK) {
+        hdns_log_fatal("create thread local format pool key failed.");
+        return HDNS_ERROR;
+    }
     return hdns_session_pool_init(g_hdns_api_pool, 0);
 }
 
@@ -97,24 +118,259 @@ hdns_client_t *hdns_client_create(const char *account_id, const char *secret_key
     client->net_detector = g_hdns_net_detector;
     client->scheduler = hdns_scheduler_create(config, g_hdns_net_detector, g_hdns_api_thread_pool);
     client->cache = hdns_cache_table_create();
+    client->thread_pool = g_hdns_api_thread_pool;
+    client->persist = NULL;
     client->state = HDNS_STATE_INIT;
+    client->group = NULL;
+    client->update_cache_on_net_change = false;
+    client->flights = hdns_flight_group_create(g_hdns_api_thread_pool);
     return client;
 }
 
+/*
+ * 在pool上拷贝并规范化域名，域名非法时返回NULL
+ */
+static char *canonical_host_dup(hdns_pool_t *pool, const char *host) {
+    if (hdns_str_is_blank(host)) {
+        return NULL;
+    }
+    char *canonical_host = apr_pstrdup(pool, host);
+    if (hdns_canonicalize_host(canonical_host) != HDNS_OK) {
+        hdns_log_info("host %s is invalid", host);
+        return NULL;
+    }
+    return canonical_host;
+}
+
+/*
+ * 拷贝并规范化域名列表，存在非法域名时返回NULL
+ */
+static hdns_list_head_t *canonical_hosts_dup(const hdns_list_head_t *hosts) {
+    hdns_list_head_t *canonical_hosts = hdns_list_create();
+    hdns_list_for_each_entry(cursor, hosts) {
+        char *canonical_host = canonical_host_dup(canonical_hosts->pool, cursor->data);
+        if (NULL == canonical_host) {
+            hdns_list_free(canonical_hosts);
+            return NULL;
+        }
+        hdns_list_add(canonical_hosts, canonical_host, NULL);
+    }
+    return canonical_hosts;
+}
+
 void hdns_client_add_pre_resolve_host(hdns_client_t *client, const char *host) {
     apr_thread_mutex_lock(client->config->lock);
-    hdns_list_add(client->config->pre_resolve_hosts, host, hdns_to_list_clone_fn_t(apr_pstrdup));
+    char *canonical_host = canonical_host_dup(client->config->pool, host);
+    if (canonical_host != NULL) {
+        hdns_list_add(client->config->pre_resolve_hosts, canonical_host, NULL);
+    }
     apr_thread_mutex_unlock(client->config->lock);
 }
 
 
+/*
+ * 在分组锁内调用，由分组中第一个开启网络切换刷新的成员负责刷新共享缓存
+ */
+static void refresh_net_change_task(hdns_cache_t *cache, const hdns_list_head_t *clients) {
+    hdns_net_cancel_chg_cb_task(g_hdns_net_detector, cache);
+    hdns_list_for_each_entry(cursor, clients) {
+        hdns_client_t *member = cursor->data;
+        if (member->update_cache_on_net_change) {
+            hdns_net_add_chg_cb_task(g_hdns_net_detector,
+                                     HDNS_NET_CB_UPDATE_CACHE,
+                                     (hdns_net_chg_cb_fn_t) hdns_update_cache_on_net_change,
+                                     member,
+                                     cache);
+            return;
+        }
+    }
+}
+
+/*
+ * 分组调度器使用的配置，只拷贝调度相关的字段
+ */
+static hdns_config_t *clone_scheduler_config(hdns_config_t *origin) {
+    hdns_config_t *config = hdns_config_create();
+    apr_thread_mutex_lock(origin->lock);
+    config->account_id = apr_pstrdup(config->pool, origin->account_id);
+    config->secret_key = origin->secret_key != NULL ? apr_pstrdup(config->pool, origin->secret_key) : NULL;
+    config->using_sign = origin->using_sign;
+    config->using_https = origin->using_https;
+    config->timeout = origin->timeout;
+    config->region = apr_pstrdup(config->pool, origin->region);
+    config->boot_server_region = apr_pstrdup(config->pool, origin->boot_server_region);
+    apr_thread_mutex_unlock(origin->lock);
+    return config;
+}
+
+/*
+ * 加入账号、region和调度中心region都相同的分组，替换客户端自己的缓存和调度器；
+ * 返回true表示分组已在运行，缓存过期和调度器刷新无需再次启动
+ */
+static bool join_client_group(hdns_client_t *client) {
+    hdns_config_t *config = client->config;
+    apr_thread_mutex_lock(config->lock);
+    char *key = apr_pstrcat(client->pool,
+                            config->account_id, "|",
+                            config->region, "|",
+                            config->boot_server_region, NULL);
+    apr_thread_mutex_unlock(config->lock);
+
+    apr_thread_mutex_lock(g_hdns_client_group_lock);
+    hdns_client_group_t *group = NULL;
+    hdns_list_for_each_entry(cursor, g_hdns_client_groups) {
+        hdns_client_group_t *candidate = cursor->data;
+        // 全部成员已关闭的分组等待释放，不再接纳新成员
+        if (strcmp(candidate->key, key) == 0 && candidate->scheduler->state != HDNS_STATE_STOPPING) {
+            group = candidate;
+            break;
+        }
+    }
+    bool running = group != NULL;
+    hdns_cache_t *own_cache = client->cache;
+    hdns_flight_group_t *own_flights = client->flights;
+    if (NULL == group) {
+        hdns_pool_new(group_pool);
+        group = hdns_palloc(group_pool, sizeof(hdns_client_group_t));
+        group->pool = group_pool;
+        group->key = apr_pstrdup(group_pool, key);
+        group->config = clone_scheduler_config(config);
+        group->scheduler = hdns_scheduler_create(group->config, g_hdns_net_detector, g_hdns_api_thread_pool);
+        // 首个成员的缓存成为共享缓存，启动前写入的条目得以保留
+        group->cache = own_cache;
+        group->flights = own_flights;
+        group->persist = NULL;
+        group->clients = hdns_list_new(group_pool);
+        hdns_list_add(g_hdns_client_groups, group, NULL);
+    }
+    // 启动前登记的网络切换任务归属于原缓存，改由分组统一登记
+    hdns_net_cancel_chg_cb_task(g_hdns_net_detector, own_cache);
+    if (own_cache != group->cache) {
+        // 启动前登记在自己缓存上的订阅和设置合并到共享缓存
+        hdns_cache_table_move_subscribers(own_cache, group->cache);
+        hdns_cache_table_merge_settings(group->cache, own_cache);
+        if (own_cache->shm != NULL && NULL == group->cache->shm) {
+            hdns_cache_table_attach_shm(group->cache, own_cache->shm);
+            own_cache->shm = NULL;
+        }
+        hdns_cache_table_cleanup(own_cache);
+    }
+    hdns_scheduler_cleanup(client->scheduler);
+    client->cache = group->cache;
+    client->scheduler = group->scheduler;
+    client->flights = group->flights;
+    client->group = group;
+    hdns_list_add(group->clients, client, NULL);
+    refresh_net_change_task(group->cache, group->clients);
+    apr_thread_mutex_unlock(g_hdns_client_group_lock);
+    // 启动前发起的请求可能仍在进行，在分组锁外等待完成后释放
+    if (own_flights != group->flights) {
+        hdns_flight_group_cleanup(own_flights);
+    }
+    return running;
+}
+
+/*
+ * 分组内任一成员开启缓存持久化时创建，所有成员共用一个快照文件和定时任务
+ */
+static hdns_status_t start_group_persist(hdns_client_group_t *group) {
+    apr_thread_mutex_lock(g_hdns_client_group_lock);
+    hdns_status_t status = hdns_status_ok(group->config->session_id);
+    if (NULL == group->persist) {
+        group->persist = hdns_persist_create(group->config, group->cache, group->scheduler, g_hdns_api_thread_pool);
+        hdns_persist_load(group->persist);
+        status = hdns_persist_start_timer(group->persist);
+    }
+    apr_thread_mutex_unlock(g_hdns_client_group_lock);
+    return status;
+}
+
+/*
+ * 成员关闭时调用，全部成员都已关闭时停止共享的调度器，返回true
+ */
+static bool stop_client_group_if_idle(hdns_client_group_t *group) {
+    apr_thread_mutex_lock(g_hdns_client_group_lock);
+    bool idle = true;
+    hdns_list_for_each_entry(cursor, group->clients) {
+        hdns_client_t *member = cursor->data;
+        if (member->state != HDNS_STATE_STOPPING) {
+            idle = false;
+            break;
+        }
+    }
+    if (idle) {
+        group->scheduler->state = HDNS_STATE_STOPPING;
+    }
+    apr_thread_mutex_unlock(g_hdns_client_group_lock);
+    return idle;
+}
+
+/*
+ * 退出分组，最后一个成员退出时返回分组，由调用方释放共享的缓存和调度器
+ */
+static hdns_client_group_t *leave_client_group(hdns_client_t *client) {
+    hdns_client_group_t *group = client->group;
+    // 共享缓存由其他成员继续使用，取消该客户端的订阅，避免退出后仍回调其参数
+    hdns_cache_table_unsubscribe_owner(group->cache, client);
+    apr_thread_mutex_lock(g_hdns_client_group_lock);
+    hdns_list_for_each_entry_safe(cursor, group->clients) {
+        if (cursor->data == client) {
+            hdns_list_del(cursor);
+        }
+    }
+    bool last = hdns_list_is_empty(group->clients);
+    if (last) {
+        hdns_list_for_each_entry_safe(cursor, g_hdns_client_groups) {
+            if (cursor->data == group) {
+                hdns_list_del(cursor);
+            }
+        }
+    } else {
+        refresh_net_change_task(group->cache, group->clients);
+    }
+    apr_thread_mutex_unlock(g_hdns_client_group_lock);
+    return last ? group : NULL;
+}
+
 hdns_status_t hdns_client_start(hdns_client_t *client) {
     if (NULL == client) {
         return hdns_status_error(HDNS_INVALID_ARGUMENT, HDNS_INVALID_ARGUMENT_CODE, "The client is null.", NULL);
     }
     client->state = HDNS_STATE_START;
+    apr_thread_mutex_lock(client->config->lock);
+    bool enable_persistent_cache = client->config->enable_persistent_cache;
+    float prefetch_ratio = client->config->prefetch_ratio;
+    bool share_account_cache = client->config->share_account_cache && hdns_str_is_not_blank(client->config->account_id);
+    bool hot_host_refresh = client->config->hot_host_refresh_count > 0;
+    apr_thread_mutex_unlock(client->config->lock);
+    // 分组已在运行时，缓存过期和调度器刷新由先启动的成员负责
+    bool group_running = share_account_cache && NULL == client->group && join_client_group(client);
+    if (!group_running) {
+        // 由时间轮维护缓存条目的过期状态，需早于加载快照，使加载的条目同样被跟踪
+        hdns_cache_table_set_refresh_ratio(client->cache, prefetch_ratio);
+        hdns_status_t expiry_status = hdns_cache_table_start_expiry(client->cache, g_hdns_api_thread_pool);
+        if (!hdns_status_is_ok(&expiry_status)) {
+            return expiry_status;
+        }
+    }
+    // 加载磁盘快照，需早于预解析，使预解析和首批请求可以命中缓存
+    if (enable_persistent_cache && client->group != NULL) {
+        hdns_status_t status = start_group_persist(client->group);
+        if (!hdns_status_is_ok(&status)) {
+            return status;
+        }
+    } else if (enable_persistent_cache && NULL == client->persist) {
+        client->persist = hdns_persist_create(client->config, client->cache, client->scheduler, g_hdns_api_thread_pool);
+        hdns_persist_load(client->persist);
+        hdns_status_t status = hdns_persist_start_timer(client->persist);
+        if (!hdns_status_is_ok(&status)) {
+            return status;
+        }
+    }
     // 定时刷新解析服务IP列表
-    hdns_status_t status = hdns_scheduler_start_refresh_timer(client->scheduler);
+    hdns_status_t status = group_running
+                           ? hdns_status_ok(client->config->session_id)
+                           : hdns_scheduler_start_refresh_timer(client->scheduler);
     if (!hdns_status_is_ok(&status)) {
         return status;
     }
@@ -129,6 +385,10 @@ hdns_status_t hdns_client_start(hdns_client_t *client) {
         return status;
     }
     client->state = HDNS_STATE_RUNNING;
+    // 定时刷新热点域名，任务在客户端停止后不再续期
+    if (hot_host_refresh) {
+        return hdns_client_start_hot_host_refresh(client);
+    }
     return hdns_status_ok(client->config->session_id);
 }
 
@@ -147,6 +407,138 @@ void hdns_client_set_using_cache(hdns_client_t *client, bool using_cache) {
     apr_thread_mutex_unlock(client->config->lock);
 }
 
+void hdns_client_set_prefetch_ratio(hdns_client_t *client, float ratio) {
+    if (ratio < 0 || ratio >= 1) {
+        return;
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->prefetch_ratio = ratio;
+    hdns_config_sync_resolve_options(client->config);
+    apr_thread_mutex_unlock(client->config->lock);
+    hdns_cache_table_set_refresh_ratio(client->cache, ratio);
+}
+
+void hdns_client_set_negative_ttl(hdns_client_t *client, int32_t ttl) {
+    if (ttl < 0) {
+        return;
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->negative_ttl = ttl;
+    apr_thread_mutex_unlock(client->config->lock);
+}
+
+void hdns_client_set_client_subnet_cache(hdns_client_t *client,
+                                         bool enable,
+                                         int32_t ipv4_prefix_len,
+                                         int32_t ipv6_prefix_len) {
+    if (ipv4_prefix_len <= 0 || ipv4_prefix_len > 32) {
+        ipv4_prefix_len = HDNS_DEFAULT_CLIENT_SUBNET_IPV4_PREFIX;
+    }
+    if (ipv6_prefix_len <= 0 || ipv6_prefix_len > 128) {
+        ipv6_prefix_len = HDNS_DEFAULT_CLIENT_SUBNET_IPV6_PREFIX;
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->client_subnet_ipv4_prefix = enable ? ipv4_prefix_len : 0;
+    client->config->client_subnet_ipv6_prefix = enable ? ipv6_prefix_len : 0;
+    hdns_config_sync_resolve_options(client->config);
+    apr_thread_mutex_unlock(client->config->lock);
+}
+
+typedef int32_t (*hdns_subscribe_fn_t)(hdns_cache_t *cache,
+                                       const char *host,
+                                       hdns_cache_update_cb_fn_t fn,
+                                       void *param,
+                                       const void *owner);
+
+static hdns_status_t update_host_subscription(hdns_client_t *client,
+                                              const char *host,
+                                              hdns_host_update_callback_pt cb,
+                                              void *cb_param,
+                                              hdns_subscribe_fn_t subscribe_fn) {
+    if (NULL == client || NULL == cb) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT, HDNS_INVALID_ARGUMENT_CODE, "client or callback is null", NULL);
+    }
+    hdns_pool_new(pool);
+    char *canonical_host = NULL;
+    if (host != NULL) {
+        canonical_host = canonical_host_dup(pool, host);
+        if (NULL == canonical_host) {
+            hdns_pool_destroy(pool);
+            return hdns_status_error(HDNS_INVALID_ARGUMENT,
+                                     HDNS_INVALID_ARGUMENT_CODE,
+                                     "host is invalid",
+                                     client->config->session_id);
+        }
+    }
+    // 以客户端登记，共享缓存时客户端退出分组可以只取消自己的订阅
+    int32_t ret = subscribe_fn(client->cache, canonical_host, cb, cb_param, client);
+    hdns_pool_destroy(pool);
+    if (ret != HDNS_OK) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT,
+                                 HDNS_INVALID_ARGUMENT_CODE,
+                                 "subscription not found",
+                                 client->config->session_id);
+    }
+    return hdns_status_ok(client->config->session_id);
+}
+
+hdns_status_t hdns_client_subscribe_host_update(hdns_client_t *client,
+                                                const char *host,
+                                                hdns_host_update_callback_pt cb,
+                                                void *cb_param) {
+    return update_host_subscription(client, host, cb, cb_param, hdns_cache_table_subscribe);
+}
+
+hdns_status_t hdns_client_unsubscribe_host_update(hdns_client_t *client,
+                                                  const char *host,
+                                                  hdns_host_update_callback_pt cb,
+                                                  void *cb_param) {
+    return update_host_subscription(client, host, cb, cb_param, hdns_cache_table_unsubscribe);
+}
+
+void hdns_client_enable_account_shared_cache(hdns_client_t *client, bool enable) {
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->share_account_cache = enable;
+    apr_thread_mutex_unlock(client->config->lock);
+}
+
+void hdns_client_enable_thread_local_cache(hdns_client_t *client, bool enable) {
+    hdns_cache_table_enable_local_cache(client->cache, enable);
+}
+
+void hdns_client_set_hot_host_refresh(hdns_client_t *client, int32_t count) {
+    if (count < 0) {
+        return;
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->hot_host_refresh_count = hdns_min(count, HDNS_SKETCH_HOT_KEY_CAPACITY);
+    apr_thread_mutex_unlock(client->config->lock);
+}
+
+void hdns_client_enable_persistent_cache(hdns_client_t *client, bool enable) {
+    apr_thread_mutex_lock(client->config->lock);
+    client->config->enable_persistent_cache = enable;
+    apr_thread_mutex_unlock(client->config->lock);
+}
+
+hdns_status_t hdns_client_enable_shared_cache(hdns_client_t *client, const char *shm_file, uint32_t capacity) {
+    if (NULL == client || hdns_str_is_blank(shm_file)) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT, HDNS_INVALID_ARGUMENT_CODE, "shm file is blank", NULL);
+    }
+    if (client->cache->shm != NULL) {
+        return hdns_status_ok(client->config->session_id);
+    }
+    hdns_shm_cache_t *shm = hdns_shm_cache_open(shm_file, capacity);
+    if (NULL == shm) {
+        return hdns_status_error(HDNS_OPEN_FILE_ERROR,
+                                 HDNS_OPEN_FILE_ERROR_CODE,
+                                 "open shared cache failed",
+                                 client->config->session_id);
+    }
+    hdns_cache_table_attach_shm(client->cache, shm);
+    return hdns_status_ok(client->config->session_id);
+}
+
 void hdns_client_set_using_https(hdns_client_t *client, bool using_https) {
     apr_thread_mutex_lock(client->config->lock);
     client->config->using_https = using_https;
@@ -172,7 +564,12 @@ void hdns_client_set_region(hdns_client_t *client, const char *region) {
     apr_thread_mutex_lock(client->config->lock);
     if (strcmp(region, client->config->region)) {
         client->config->region = apr_pstrdup(client->config->pool, region);
-        if (client->state == HDNS_STATE_RUNNING) {
+        if (client->group != NULL) {
+            hdns_log_warn("region of a client sharing cache changed after start, shared cache is kept");
+        } else if (client->state == HDNS_STATE_RUNNING) {
+            if (client->cache->shm != NULL) {
+                hdns_log_warn("region of a client attached to shm cache changed, shared entries are kept");
+            }
             hdns_cache_table_clean(client->cache);
             hdns_scheduler_refresh_async(client->scheduler);
         }
@@ -187,6 +584,10 @@ void hdns_client_set_schedule_center_region(hdns_client_t *client, const char *r
         client->config->boot_server_region = apr_pstrdup(client->config->pool, region);
     }
     apr_thread_mutex_unlock(client->config->lock);
+    if (client->group != NULL) {
+        hdns_log_warn("schedule center region of a client sharing cache changed after start, shared scheduler is kept");
+        return;
+    }
 
     apr_thread_mutex_lock(client->scheduler->lock);
     if (changed) {
@@ -208,6 +609,14 @@ void hdns_client_set_schedule_center_region(hdns_client_t *client, const char *r
 }
 
 void hdns_client_enable_update_cache_after_net_change(hdns_client_t *client, bool enable) {
+    apr_thread_mutex_lock(g_hdns_client_group_lock);
+    client->update_cache_on_net_change = enable;
+    if (client->group != NULL) {
+        refresh_net_change_task(client->group->cache, client->group->clients);
+        apr_thread_mutex_unlock(g_hdns_client_group_lock);
+        return;
+    }
+    apr_thread_mutex_unlock(g_hdns_client_group_lock);
     if (enable) {
         hdns_net_add_chg_cb_task(client->net_detector,
                                  HDNS_NET_CB_UPDATE_CACHE,
@@ -223,38 +632,65 @@ void hdns_client_enable_update_cache_after_net_change(hdns_client_t *client, boo
 void hdns_client_enable_expired_ip(hdns_client_t *client, bool enable) {
     apr_thread_mutex_lock(client->config->lock);
     client->config->enable_expired_ip = enable;
+    hdns_config_sync_resolve_options(client->config);
     apr_thread_mutex_unlock(client->config->lock);
 }
 
 void hdns_client_enable_failover_localdns(hdns_client_t *client, bool enable) {
     apr_thread_mutex_lock(client->config->lock);
     client->config->enable_failover_localdns = enable;
+    hdns_config_sync_resolve_options(client->config);
     apr_thread_mutex_unlock(client->config->lock);
 }
 
 void hdns_config_add_pre_resolve_host(hdns_client_t *client, const char *host) {
-    apr_thread_mutex_lock(client->config->lock);
-    hdns_list_add(client->config->pre_resolve_hosts, host, hdns_to_list_clone_fn_t(apr_pstrdup));
-    apr_thread_mutex_unlock(client->config->lock);
+    hdns_client_add_pre_resolve_host(client, host);
 }
 
 
 void hdns_client_add_ip_probe_item(hdns_client_t *client, const char *host, const int port) {
-    apr_thread_mutex_lock(client->config->lock);
-    hdns_config_t *config = client->config;
-    int *port_pr = hdns_palloc(config->pool, sizeof(int));
-    *port_pr = port;
-    apr_hash_set(config->ip_probe_items, apr_pstrdup(config->pool, host), APR_HASH_KEY_STRING, port_pr);
-    apr_thread_mutex_unlock(client->config->lock);
+    hdns_pool_new(pool);
+    char *canonical_host = canonical_host_dup(pool, host);
+    if (canonical_host != NULL) {
+        hdns_config_add_ip_probe_rule(client->config, canonical_host, port);
+    }
+    hdns_pool_destroy(pool);
 }
 
 void hdns_client_add_custom_ttl_item(hdns_client_t *client, const char *host, const int ttl) {
-    apr_thread_mutex_lock(client->config->lock);
-    hdns_config_t *config = client->config;
-    int *ttl_pr = hdns_palloc(config->pool, sizeof(int));
-    *ttl_pr = ttl;
-    apr_hash_set(config->custom_ttl_items, apr_pstrdup(config->pool, host), APR_HASH_KEY_STRING, ttl_pr);
-    apr_thread_mutex_unlock(client->config->lock);
+    hdns_pool_new(pool);
+    char *canonical_host = canonical_host_dup(pool, host);
+    if (canonical_host != NULL) {
+        hdns_config_add_custom_ttl_rule(client->config, canonical_host, ttl);
+    }
+    hdns_pool_destroy(pool);
+}
+
+void hdns_client_set_cache_capacity(hdns_client_t *client, size_t max_entries, size_t max_bytes) {
+    hdns_cache_table_set_capacity(client->cache, max_entries, max_bytes);
+}
+
+uint64_t hdns_client_get_cache_evictions(hdns_client_t *client) {
+    return hdns_cache_table_get_evictions(client->cache);
+}
+
+void hdns_client_get_cache_stats(hdns_client_t *client, hdns_cache_stats_t *stats) {
+    hdns_cache_table_get_stats(client->cache, stats);
+}
+
+void hdns_client_enable_host_cache_stats(hdns_client_t *client, bool enable) {
+    hdns_cache_table_enable_host_stats(client->cache, enable);
+}
+
+int hdns_client_get_host_cache_stats(hdns_client_t *client, const char *host, hdns_cache_stats_t *stats) {
+    if (NULL == client || hdns_str_is_blank(host) || NULL == stats) {
+        return HDNS_ERROR;
+    }
+    hdns_pool_new(pool);
+    char *canonical_host = canonical_host_dup(pool, host);
+    int ret = canonical_host != NULL ? hdns_cache_table_get_host_stats(client->cache, canonical_host, stats) : HDNS_ERROR;
+    hdns_pool_destroy(pool);
+    return ret;
 }
 
 int hdns_client_get_session_id(hdns_client_t *client, char *session_id) {
@@ -293,8 +729,17 @@ hdns_status_t hdns_resv_req_set_host(hdns_resv_req_t *req, const char *host) {
 
     }
     apr_thread_mutex_lock(req->lock);
-    req->host = apr_pstrdup(req->pool, host);
+    char *canonical_host = canonical_host_dup(req->pool, host);
+    if (canonical_host != NULL) {
+        req->host = canonical_host;
+    }
     apr_thread_mutex_unlock(req->lock);
+    if (NULL == canonical_host) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT,
+                                 HDNS_INVALID_ARGUMENT_CODE,
+                                 "host is invalid",
+                                 req->session_id);
+    }
     return hdns_status_ok(req->session_id);
 }
 
@@ -406,7 +851,15 @@ static hdns_status_t hdns_get_result_for_host_sync(hdns_client_t *client,
                                  client->config->session_id);
     }
     hdns_pool_new(pool);
-    char *tmp_host = apr_pstrdup(pool, host);
+    char *tmp_host = canonical_host_dup(pool, host);
+    if (NULL == tmp_host) {
+        hdns_pool_destroy(pool);
+        (*results) = NULL;
+        return hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                 HDNS_FAILED_VERIFICATION_CODE,
+                                 "host is invalid",
+                                 client->config->session_id);
+    }
     hdns_list_head_t *tmp_results = hdns_list_create();
     hdns_status_t status = hdns_do_single_resolve(client, tmp_host, query_type, using_cache, client_ip, tmp_results);
     hdns_pool_destroy(pool);
@@ -460,8 +913,14 @@ static hdns_status_t hdns_get_results_for_hosts_sync(hdns_client_t *client,
                                  "query_type is invalid",
                                  client->config->session_id);
     }
-    hdns_list_head_t *tmp_hosts = hdns_list_create();
-    hdns_list_dup(tmp_hosts, hosts, hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_head_t *tmp_hosts = canonical_hosts_dup(hosts);
+    if (NULL == tmp_hosts) {
+        (*results) = NULL;
+        return hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                 HDNS_FAILED_VERIFICATION_CODE,
+                                 "hosts contain invalid host",
+                                 client->config->session_id);
+    }
     hdns_list_head_t *tmp_results = hdns_list_create();
     hdns_status_t status = hdns_do_batch_resolve(client, tmp_hosts, query_type, using_cache, client_ip, tmp_results);
     hdns_list_free(tmp_hosts);
@@ -490,6 +949,42 @@ hdns_status_t hdns_get_results_for_hosts_sync_without_cache(hdns_client_t *clien
     return hdns_get_results_for_hosts_sync(client, hosts, query_type, client_ip, false, results);
 }
 
+hdns_status_t hdns_get_results_for_hosts_from_cache(hdns_client_t *client,
+                                                   const hdns_list_head_t *hosts,
+                                                   hdns_query_type_t query_type,
+                                                   hdns_list_head_t **results) {
+    if (NULL == results) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT,
+                                 HDNS_INVALID_ARGUMENT_CODE,
+                                 "The results_pt is null.",
+                                 client->config->session_id);
+    }
+    if (hdns_list_is_empty(hosts)) {
+        return hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                 HDNS_FAILED_VERIFICATION_CODE,
+                                 "hosts is empty",
+                                 client->config->session_id);
+    }
+    if (query_type > HDNS_QUERY_BOTH) {
+        return hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                 HDNS_FAILED_VERIFICATION_CODE,
+                                 "query_type is invalid",
+                                 client->config->session_id);
+    }
+    hdns_list_head_t *tmp_hosts = canonical_hosts_dup(hosts);
+    if (NULL == tmp_hosts) {
+        (*results) = NULL;
+        return hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                 HDNS_FAILED_VERIFICATION_CODE,
+                                 "hosts contain invalid host",
+                                 client->config->session_id);
+    }
+    (*results) = hdns_list_create();
+    hdns_status_t status = hdns_do_batch_lookup_cache(client, tmp_hosts, query_type, *results);
+    hdns_list_free(tmp_hosts);
+    return status;
+}
+
 
 typedef struct {
     hdns_pool_t *pool;
@@ -499,14 +994,20 @@ typedef struct {
     void *cb_param;
 } hdns_single_resv_with_custom_req_param_t;
 
+static void hdns_single_resv_with_custom_req_done(hdns_status_t *status, hdns_list_head_t *results, void *data) {
+    hdns_single_resv_with_custom_req_param_t *param = data;
+    param->cb(status, hdns_status_is_ok(status) ? results : NULL, param->cb_param);
+    hdns_pool_destroy(param->pool);
+}
+
 static void *APR_THREAD_FUNC hdns_single_resv_with_custom_req_task(apr_thread_t *thread, void *data) {
     hdns_unused_var(thread);
     hdns_single_resv_with_custom_req_param_t *param = data;
-    hdns_list_head_t *results = NULL;
-    hdns_status_t status = hdns_get_result_for_host_sync_with_custom_request(param->client, param->resv_req, &results);
-    param->cb(&status, results, param->cb_param);
-    hdns_list_free(results);
-    hdns_pool_destroy(param->pool);
+    // 相同请求正在进行时挂载回调后直接返回，不阻塞线程池中的线程
+    hdns_do_single_resolve_with_req_async(param->client,
+                                          param->resv_req,
+                                          hdns_single_resv_with_custom_req_done,
+                                          param);
     return NULL;
 }
 
@@ -556,19 +1057,31 @@ typedef struct {
     void *cb_param;
 } hdns_single_resv_task_param_t;
 
+static void hdns_single_resv_done(hdns_status_t *status, hdns_list_head_t *results, void *data) {
+    hdns_single_resv_task_param_t *param = data;
+    param->cb(status, hdns_status_is_ok(status) ? results : NULL, param->cb_param);
+    hdns_pool_destroy(param->pool);
+}
+
 static void *APR_THREAD_FUNC hdns_single_resv_task(apr_thread_t *thread, void *data) {
     hdns_unused_var(thread);
     hdns_single_resv_task_param_t *param = data;
-    hdns_list_head_t *results = NULL;
-    hdns_status_t status = hdns_get_result_for_host_sync(param->client,
-                                                         param->host,
-                                                         param->query_type,
-                                                         param->client_ip,
-                                                         param->using_cache,
-                                                         &results);
-    param->cb(&status, results, param->cb_param);
-    hdns_list_free(results);
-    hdns_pool_destroy(param->pool);
+    char *host = canonical_host_dup(param->pool, param->host);
+    if (NULL == host) {
+        hdns_status_t status = hdns_status_error(HDNS_FAILED_VERIFICATION,
+                                                 HDNS_FAILED_VERIFICATION_CODE,
+                                                 "host is invalid",
+                                                 param->client->config->session_id);
+        hdns_single_resv_done(&status, NULL, param);
+        return NULL;
+    }
+    hdns_do_single_resolve_async(param->client,
+                                 host,
+                                 param->query_type,
+                                 param->using_cache,
+                                 param->client_ip,
+                                 hdns_single_resv_done,
+                                 param);
     return NULL;
 }
 
@@ -774,8 +1287,13 @@ void hdns_log_set_log_level(hdns_log_level_e level) {
 
 void hdns_remove_host_cache(hdns_client_t *client, const char *host) {
     if (client != NULL && client->cache != NULL && hdns_str_is_not_blank(host)) {
-        hdns_cache_table_delete(client->cache, host, HDNS_RR_TYPE_A);
-        hdns_cache_table_delete(client->cache, host, HDNS_RR_TYPE_AAAA);
+        hdns_pool_new(pool);
+        char *canonical_host = canonical_host_dup(pool, host);
+        if (canonical_host != NULL) {
+            hdns_cache_table_delete(client->cache, canonical_host, HDNS_RR_TYPE_A);
+            hdns_cache_table_delete(client->cache, canonical_host, HDNS_RR_TYPE_AAAA);
+        }
+        hdns_pool_destroy(pool);
     }
 }
 
@@ -844,6 +1362,46 @@ int hdns_select_first_ip(hdns_list_head_t *results, hdns_query_type_t query_type
 }
 
 
+int hdns_get_sockaddrs(hdns_list_head_t *results,
+                       hdns_query_type_t query_type,
+                       uint16_t port,
+                       struct sockaddr_storage *addrs,
+                       int max_count) {
+    if (hdns_list_is_empty(results) || NULL == addrs || max_count <= 0) {
+        return 0;
+    }
+    hdns_net_type_t net_type;
+    switch (query_type) {
+        case HDNS_QUERY_AUTO: {
+            net_type = hdns_net_get_type(g_hdns_net_detector);
+            if (net_type == HDNS_NET_UNKNOWN) {
+                net_type = HDNS_IPV4_ONLY;
+            }
+            break;
+        }
+        case HDNS_QUERY_BOTH: {
+            net_type = HDNS_DUAL_STACK;
+            break;
+        }
+        case HDNS_QUERY_IPV6: {
+            net_type = HDNS_IPV6_ONLY;
+            break;
+        }
+        default: {
+            net_type = HDNS_IPV4_ONLY;
+        }
+    }
+    int count = 0;
+    // 结果列表中ipv4在前
+    hdns_list_for_each_entry_safe(cursor, results) {
+        hdns_resv_resp_t *resp = cursor->data;
+        if (is_net_match(net_type, resp->type)) {
+            count += hdns_resv_resp_to_sockaddrs(resp, port, addrs + count, max_count - count);
+        }
+    }
+    return count;
+}
+
 int hdns_get_sdns_extra(hdns_list_head_t *results, hdns_query_type_t query_type, char *extra) {
     if (hdns_list_is_empty(results)) {
         return HDNS_ERROR;
@@ -884,14 +1442,32 @@ int hdns_get_sdns_extra(hdns_list_head_t *results, hdns_query_type_t query_type,
 static void *APR_THREAD_FUNC hdns_client_cleanup_task(apr_thread_t *thread, void *data) {
     hdns_client_t *client = data;
     if (client != NULL) {
-        // 停止该客户端关联的所有ip测速线程
+        // 尚未提交的合并请求回调以失败状态结束，之后不会再有属于该客户端的回调任务提交
+        hdns_flight_group_cancel(client->flights, client);
+        // 停止该客户端关联的所有ip测速线程和合并请求回调
         apr_thread_pool_tasks_cancel(g_hdns_api_thread_pool, client);
-        // 停止该客户端关联的所有缓存刷新线程
-        hdns_net_cancel_chg_cb_task(g_hdns_net_detector, client->cache);
-        // 清理调度器相关资源
-        hdns_scheduler_cleanup(client->scheduler);
-        // 清理缓存相关资源
-        hdns_cache_table_cleanup(client->cache);
+        // 共享的缓存和调度器由分组最后一个成员释放
+        hdns_client_group_t *group = client->group != NULL ? leave_client_group(client) : NULL;
+        bool release_shared = NULL == client->group || group != NULL;
+        if (release_shared) {
+            // 停止该客户端关联的所有缓存刷新线程
+            hdns_net_cancel_chg_cb_task(g_hdns_net_detector, client->cache);
+        }
+        // 清理缓存持久化相关资源
+        hdns_persist_cleanup(client->persist);
+        if (release_shared) {
+            // 等待进行中的请求完成后清理合并请求相关资源，发起方完成时仍会写入缓存
+            hdns_flight_group_cleanup(client->flights);
+            // 清理调度器相关资源
+            hdns_scheduler_cleanup(client->scheduler);
+            // 清理缓存相关资源
+            hdns_cache_table_cleanup(client->cache);
+        }
+        if (group != NULL) {
+            hdns_persist_cleanup(group->persist);
+            hdns_config_cleanup(group->config);
+            hdns_pool_destroy(group->pool);
+        }
         // 清理配置项相关资源
         hdns_config_cleanup(client->config);
         // 释放客户端内存池
@@ -904,7 +1480,18 @@ static void *APR_THREAD_FUNC hdns_client_cleanup_task(apr_thread_t *thread, void
 void hdns_client_cleanup(hdns_client_t *client) {
     if (client != NULL) {
         client->state = HDNS_STATE_STOPPING;
-        client->scheduler->state = HDNS_STATE_STOPPING;
+        hdns_persist_t *persist = client->persist;
+        if (NULL == client->group) {
+            client->scheduler->state = HDNS_STATE_STOPPING;
+        } else if (stop_client_group_if_idle(client->group)) {
+            // 分组的快照由最后一个关闭的成员停止
+            persist = client->group->persist;
+        }
+        // 停止定时快照并同步写入最后一次快照，保证重启后可以加载到最新的缓存
+        if (persist != NULL) {
+            hdns_persist_stop(persist);
+            hdns_persist_save(persist);
+        }
         // 延迟30秒结束，等待正在执行的异步任务
         apr_thread_pool_schedule(g_hdns_api_thread_pool,
                                  hdns_client_cleanup_task,
@@ -928,6 +1515,12 @@ void hdns_sdk_cleanup() {
         g_hdns_api_thread_pool = NULL;
     }
     hdns_net_detector_cleanup(g_hdns_net_detector);
+    hdns_cache_local_cleanup();
+    hdns_resolver_cleanup();
+    hdns_clock_cleanup();
+    apr_thread_mutex_destroy(g_hdns_client_group_lock);
+    g_hdns_client_group_lock = NULL;
+    g_hdns_client_groups = NULL;
     hdns_session_pool_cleanup();
     if (hdns_stdout_file != NULL) {
         apr_file_close(hdns_stdout_file);
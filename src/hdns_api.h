@@ -21,6 +21,18 @@ HDNS_CPP_START
  */
 typedef void (*hdns_resv_done_callback_pt)(hdns_status_t *status, hdns_list_head_t *results, void *param);
 
+/*
+ * @brief 缓存IP变化回调函数
+ * @param[in]   host      发生变化的域名
+ * @param[in]   type      记录类型，HDNS_RR_TYPE_A或HDNS_RR_TYPE_AAAA
+ * @param[in]   old_ips   变化前的IP列表，此前没有缓存时为空列表
+ * @param[in]   new_ips   变化后的IP列表
+ * @param[in]   param     用户传递的自定义参数
+ * @note :
+ *    - 在写入缓存的线程中同步执行，请勿阻塞，也不要持有old_ips和new_ips
+ */
+typedef hdns_cache_update_cb_fn_t hdns_host_update_callback_pt;
+
 /*
  * @brief SDK环境初始化，主要包括全局随机数、session池、网络检测器、线程池
  * @return 0：初始化成功；1：初始化失败
@@ -68,6 +80,139 @@ void hdns_client_set_timeout(hdns_client_t *client, int32_t timeout);
  */
 void hdns_client_set_using_cache(hdns_client_t *client, bool using_cache);
 
+/*
+ * @brief  设置缓存预取比例，命中的缓存已过去的TTL比例达到该值时，后台异步刷新，本次请求直接返回缓存结果
+ * @param[in]   client        客户端实例
+ * @param[in]   ratio         取值范围[0, 1)，例如0.75表示TTL过去75%后预取，0表示关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 同一缓存条目只会触发一次预取，刷新失败后下次命中会重新触发
+ */
+void hdns_client_set_prefetch_ratio(hdns_client_t *client, float ratio);
+
+/*
+ * @brief  设置负缓存TTL，服务端返回某个域名没有A或AAAA记录时，缓存空结果，有效期内不再发起网络请求
+ * @param[in]   client        客户端实例
+ * @param[in]   ttl           负缓存有效期，单位秒，默认30秒，0表示关闭负缓存
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 负缓存按域名和地址类型分别记录，例如没有AAAA记录的域名，HDNS_QUERY_BOTH解析时只请求A记录
+ *    - 开启hdns_client_enable_failover_localdns时，命中负缓存仍会降级到localdns
+ */
+void hdns_client_set_negative_ttl(hdns_client_t *client, int32_t ttl);
+
+/*
+ * @brief  按client_ip所在子网分区缓存，指定client_ip的解析结果按域名和子网分别缓存，不同地域的结果互不覆盖
+ * @param[in]   client             客户端实例
+ * @param[in]   enable             是否开启，默认关闭，关闭时指定client_ip的结果仍按域名缓存
+ * @param[in]   ipv4_prefix_len    IPv4子网前缀长度，取值1~32，超出范围时使用默认值24
+ * @param[in]   ipv6_prefix_len    IPv6子网前缀长度，取值1~128，超出范围时使用默认值56
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 适用于代理为不同地域的终端用户解析的场景，未指定client_ip的解析不受影响
+ *    - 分区的缓存条目与本机网络无关，网络切换后不会随之刷新
+ */
+void hdns_client_set_client_subnet_cache(hdns_client_t *client,
+                                         bool enable,
+                                         int32_t ipv4_prefix_len,
+                                         int32_t ipv6_prefix_len);
+
+/*
+ * @brief  订阅域名缓存的IP变化，写入缓存的IP集合与原有集合不同时回调，IP相同仅顺序不同时不回调
+ * @param[in]   client     客户端实例
+ * @param[in]   host       订阅的域名，NULL表示订阅全部域名
+ * @param[in]   cb         回调函数
+ * @param[in]   cb_param   回调函数的自定义参数
+ * @return  操作状态，如果返回的status的code是0表示成功，否则表示失败
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 同一个(host, cb, cb_param)重复订阅只回调一次
+ *    - 回调可由解析、预取、网络切换刷新等任意写入缓存的线程触发
+ */
+hdns_status_t hdns_client_subscribe_host_update(hdns_client_t *client,
+                                                const char *host,
+                                                hdns_host_update_callback_pt cb,
+                                                void *cb_param);
+
+/*
+ * @brief  取消hdns_client_subscribe_host_update的订阅，参数需与订阅时一致
+ * @param[in]   client     客户端实例
+ * @param[in]   host       订阅的域名，NULL表示订阅全部域名
+ * @param[in]   cb         回调函数
+ * @param[in]   cb_param   回调函数的自定义参数
+ * @return  操作状态，未找到订阅时返回失败
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 返回后不会再触发回调，其他线程中正在执行的回调也已返回，之后可以安全释放cb_param
+ *    - 回调中可以取消自身的订阅，但不要取消其他订阅，否则可能与其他线程的回调互相等待
+ */
+hdns_status_t hdns_client_unsubscribe_host_update(hdns_client_t *client,
+                                                  const char *host,
+                                                  hdns_host_update_callback_pt cb,
+                                                  void *cb_param);
+
+/*
+ * @brief  与同一账号的其他客户端共享缓存和解析服务调度器，多个客户端只占用一份缓存，解析服务IP列表只刷新一次
+ * @param[in]   client        客户端实例
+ * @param[in]   enable        true: 开启，false：关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 需要在hdns_client_start之前调用，启动时加入账号、region、调度中心region都相同的分组
+ *    - 缓存TTL等写入策略仍按各客户端自己的配置生效，写入的结果对分组内所有客户端可见
+ *    - 启动后修改region或调度中心region不影响共享的缓存和调度器
+ *    - 共享的缓存和调度器在分组内最后一个客户端释放时释放
+ */
+void hdns_client_enable_account_shared_cache(hdns_client_t *client, bool enable);
+
+/*
+ * @brief  设置后台持续刷新的热点域名个数，SDK按解析请求统计各域名的访问频次，定时刷新频次最高且即将过期的域名
+ * @param[in]   client        客户端实例
+ * @param[in]   count         热点域名个数，最大64，0表示关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 需要在hdns_client_start之前开启，启动后可调整个数，设置为0时暂停刷新
+ *    - 访问频次随时间衰减，热点域名随访问变化自动更新
+ *    - 网络切换刷新缓存时，热点域名优先刷新
+ */
+void hdns_client_set_hot_host_refresh(hdns_client_t *client, int32_t count);
+
+/*
+ * @brief  开启线程本地缓存，每个线程保留最近解析的少量域名，重复解析同一域名时不加锁、不写共享内存
+ * @param[in]   client        客户端实例
+ * @param[in]   enable        true: 开启，false：关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 只作用于单域名的缓存解析，任一缓存条目更新、删除或淘汰时所有线程的本地缓存失效，不会读到旧结果
+ *    - 本地缓存命中不计入缓存命中统计，也不更新LRU顺序
+ *    - 按账号共享缓存时，对分组内所有客户端生效
+ */
+void hdns_client_enable_thread_local_cache(hdns_client_t *client, bool enable);
+
+/*
+ * @brief  设置是否将本地缓存持久化到磁盘，开启后定期及客户端关闭时将解析缓存和解析服务IP列表写入
+ *         ~/.httpdns/<account_id>/cache.json，客户端启动时加载
+ * @param[in]   client        客户端实例
+ * @param[in]   enable        true: 开启，false：关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 需要在hdns_client_start之前调用
+ *    - 加载的缓存按原查询时间计算剩余TTL，已过期的结果仅在开启hdns_client_enable_expired_ip时使用
+ */
+void hdns_client_enable_persistent_cache(hdns_client_t *client, bool enable);
+
+/*
+ * @brief  开启跨进程共享缓存，同一机器上挂载同一文件的多个进程共享解析结果
+ * @param[in]   client        客户端实例
+ * @param[in]   shm_file      共享内存对应的文件路径，第一个进程创建，其余进程挂载
+ * @param[in]   capacity      共享缓存的槽位数，0表示使用默认值4096，以创建者为准
+ * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
+ * @note :
+ *    - 需要在hdns_client_start之前调用
+ *    - 不支持Windows平台
+ *    - 进程退出时只解除挂载，不删除共享内存；升级SDK导致结构不兼容时需手动删除该文件
+ */
+hdns_status_t hdns_client_enable_shared_cache(hdns_client_t *client, const char *shm_file, uint32_t capacity);
+
 /*
  * @brief  设置访问HTTPDNS服务器时是否使用https协议
  * @param[in]   client        客户端实例
@@ -153,10 +298,11 @@ void hdns_client_add_pre_resolve_host(hdns_client_t *client, const char *host);
 /*
  * @brief   添加进行IP嗅探的域名和端口，一个域名只允许探测一个端口
  * @param[in]   client        客户端实例
- * @param[in]   host          探测域名
+ * @param[in]   host          探测域名，支持*.example.com形式的通配域名，匹配example.com的任意子域名
  * @param[in]   port          探测端口
  * @note :
  *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 同时命中多条规则时，完全匹配优先，其次是最长的通配后缀
  */
 void hdns_client_add_ip_probe_item(hdns_client_t *client, const char *host, const int port);
 
@@ -164,13 +310,66 @@ void hdns_client_add_ip_probe_item(hdns_client_t *client, const char *host, cons
 /*
  * @brief   针对某个域名，添加一个自定义的解析ttl，仅对HTTPDNS的解析结果有效，降级到localdns无效
  * @param[in]   client        客户端实例
- * @param[in]   host          探测域名
+ * @param[in]   host          域名，支持*.example.com形式的通配域名，匹配example.com的任意子域名
  * @param[in]   ttl           自定义ttl
  * @note :
  *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 同时命中多条规则时，完全匹配优先，其次是最长的通配后缀
  */
 void hdns_client_add_custom_ttl_item(hdns_client_t *client, const char *host, const int ttl);
 
+/*
+ * @brief   设置本地缓存的容量上限，超出时淘汰最久未访问的解析结果
+ * @param[in]   client        客户端实例
+ * @param[in]   max_entries   最大缓存条目数，0表示不限制（默认）
+ * @param[in]   max_bytes     缓存估算占用的最大内存字节数，0表示不限制（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 容量按缓存分段均分，淘汰在分段内进行
+ */
+void hdns_client_set_cache_capacity(hdns_client_t *client, size_t max_entries, size_t max_bytes);
+
+/*
+ * @brief   获取本地缓存因容量限制累计淘汰的条目数
+ * @param[in]   client        客户端实例
+ * @return  淘汰条目数
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ */
+uint64_t hdns_client_get_cache_evictions(hdns_client_t *client);
+
+/*
+ * @brief   获取本地缓存的统计快照，包括命中、未命中、命中过期结果、过期、淘汰、写入次数及当前条目数和内存占用
+ * @param[in]   client        客户端实例
+ * @param[out]  stats         统计结果
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 计数在各缓存分段的锁内累加，不引入额外的锁竞争
+ *    - 过期次数由后台时间轮统计，需在hdns_client_start之后才会增长
+ */
+void hdns_client_get_cache_stats(hdns_client_t *client, hdns_cache_stats_t *stats);
+
+/*
+ * @brief   设置是否按域名统计缓存命中情况
+ * @param[in]   client        客户端实例
+ * @param[in]   enable        true: 开启，false：关闭（默认）
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ *    - 域名的统计随缓存条目保存，条目被淘汰或回收后清零
+ */
+void hdns_client_enable_host_cache_stats(hdns_client_t *client, bool enable);
+
+/*
+ * @brief   获取单个域名的缓存统计，需先通过hdns_client_enable_host_cache_stats开启
+ * @param[in]   client        客户端实例
+ * @param[in]   host          域名
+ * @param[out]  stats         统计结果，evictions恒为0
+ * @return  0 获取成功，域名不在缓存中时返回失败
+ * @note :
+ *    - hdns_client_t是线程安全的，可多线程共享
+ */
+int hdns_client_get_host_cache_stats(hdns_client_t *client, const char *host, hdns_cache_stats_t *stats);
+
 
 /*
  * @brief   获取客户端的session id，用于问题排查
@@ -281,7 +480,7 @@ void hdns_list_cleanup(hdns_list_head_t *list);
  * @brief   自定义同步解析
  * @param[in]   client          客户端实例
  * @param[in]   req             自定义解析请求实例
- * @param[out]  results         解析结果，需要通过hdns_list_cleanup进行内存释放
+ * @param[out]  results         解析结果（只读），需要通过hdns_list_cleanup进行内存释放
  * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
  * @note :
  *    - hdns_list_head_t是非线程安全的，多线程共享时应该通过互斥量等手段进行同步
@@ -302,7 +501,7 @@ hdns_status_t hdns_get_result_for_host_sync_with_custom_request(hdns_client_t *c
  *         - HDNS_QUERY_IPV6：解析IPv6类型
  *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
  * @param[in]      client_ip 可选，客户端ip, 默认为接口调用方的出口IP
- * @param[out]     results         解析结果，需要通过hdns_list_cleanup进行内存释放
+ * @param[out]     results         解析结果（只读），需要通过hdns_list_cleanup进行内存释放
  * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
  * @note :
  *    - hdns_client_t线程安全，可多线程共享
@@ -325,7 +524,7 @@ hdns_status_t hdns_get_result_for_host_sync_with_cache(hdns_client_t *client,
  *         - HDNS_QUERY_IPV6：解析IPv6类型
  *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
  * @param[in]      client_ip 可选，客户端ip, 默认为接口调用方的出口IP
- * @param[out]     results         解析结果，需要通过hdns_list_cleanup进行内存释放
+ * @param[out]     results         解析结果（只读），需要通过hdns_list_cleanup进行内存释放
  * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
  * @note :
  *    - hdns_client_t线程安全，可多线程共享
@@ -348,7 +547,7 @@ hdns_status_t hdns_get_result_for_host_sync_without_cache(hdns_client_t *client,
  *         - HDNS_QUERY_IPV6：解析IPv6类型
  *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
  * @param[in]      client_ip 可选，客户端ip, 默认为接口调用方的出口IP
- * @param[out]     results         解析结果，需要通过hdns_list_cleanup进行内存释放
+ * @param[out]     results         解析结果（只读），需要通过hdns_list_cleanup进行内存释放
  * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
  * @note :
  *    - hdns_client_t线程安全，可多线程共享
@@ -371,7 +570,7 @@ hdns_status_t hdns_get_results_for_hosts_sync_with_cache(hdns_client_t *client,
  *         - HDNS_QUERY_IPV6：解析IPv6类型
  *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
  * @param[in]      client_ip 可选，客户端ip, 默认为接口调用方的出口IP
- * @param[out]     results         解析结果，需要通过hdns_list_cleanup进行内存释放
+ * @param[out]     results         解析结果（只读），需要通过hdns_list_cleanup进行内存释放
  * @return  操作状态，如果status的code是0表示成功，否则表示失败，error_msg包含了错误信息
  * @note :
  *    - hdns_client_t线程安全，可多线程共享
@@ -382,6 +581,28 @@ hdns_status_t hdns_get_results_for_hosts_sync_without_cache(hdns_client_t *clien
                                                             const char *client_ip,
                                                             hdns_list_head_t **results);
 
+/*
+ *
+ * @brief 批量域名只读查询本地缓存，不发起网络请求，适合单次需要查询大量域名的场景
+ *
+ * @param[in]      client        客户端实例
+ * @param[in]      hosts         待查询的域名列表
+ * @param[in]      query_type    请求类型
+ *         - HDNS_QUERY_AUTO：根据网络栈自动解析；
+ *         - HDNS_QUERY_IPV4：解析IPV4类型；
+ *         - HDNS_QUERY_IPV6：解析IPv6类型
+ *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
+ * @param[out]     results       查询结果（只读），未命中的域名为空结果，需要通过hdns_list_cleanup进行内存释放
+ * @return  操作状态，所有域名都命中时code为0，否则表示存在未命中的域名，此时results依然有效
+ * @note :
+ *    - hdns_client_t线程安全，可多线程共享
+ *    - 域名按缓存分段归并，每个分段只加一次锁
+ */
+hdns_status_t hdns_get_results_for_hosts_from_cache(hdns_client_t *client,
+                                                   const hdns_list_head_t *hosts,
+                                                   hdns_query_type_t query_type,
+                                                   hdns_list_head_t **results);
+
 /*
  * @brief   先进行自定义异步步解析，最后触发函数回调
  * @param[in]   client          客户端实例
@@ -528,6 +749,27 @@ int hdns_select_ip_randomly(hdns_list_head_t *results, hdns_query_type_t query_t
 int hdns_select_first_ip(hdns_list_head_t *results, hdns_query_type_t query_type, char *ip);
 
 
+/*
+ *
+ * @brief 将解析结果中的ip转换为可直接用于connect的地址，缓存结果使用写入缓存时生成的二进制地址，不再逐个解析字符串
+ *
+ * @param[in]      results       已获取的解析结果
+ * @param[in]      query_type    请求类型
+ *         - HDNS_QUERY_AUTO：根据网络栈自动解析；
+ *         - HDNS_QUERY_IPV4：解析IPV4类型；
+ *         - HDNS_QUERY_IPV6：解析IPv6类型
+ *         - HDNS_QUERY_BOTH：解析IPV4和IPV6类型
+ * @param[in]      port          写入地址的端口
+ * @param[out]     addrs         地址数组
+ * @param[in]      max_count     地址数组的容量
+ * @return  写入的地址个数，双栈时ipv4在前
+ */
+int hdns_get_sockaddrs(hdns_list_head_t *results,
+                       hdns_query_type_t query_type,
+                       uint16_t port,
+                       struct sockaddr_storage *addrs,
+                       int max_count);
+
 /*
  *
  * @brief 返回软件自定义解析中的extra字段
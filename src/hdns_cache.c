@@ -1,136 +1,1530 @@
 //
 // Created by caogaoshuai on 2024/1/18.
 //
+#include <apr_thread_proc.h>
+
 #include "hdns_log.h"
 #include "hdns_resolver.h"
 
 #include "hdns_cache.h"
 
+static volatile apr_uint32_t g_hdns_cache_next_id = 0;
+static apr_threadkey_t *g_hdns_cache_local_key = NULL;
+
+typedef struct {
+    // 0表示空槽位
+    apr_uint32_t cache_id;
+    apr_uint32_t generation;
+    // 命中次数，每HDNS_CACHE_LOCAL_ACCESS_SAMPLE次记录一次访问频次
+    apr_uint32_t hits;
+    uint64_t hash;
+    char key[HDNS_CACHE_LOCAL_MAX_KEY_LENGTH];
+    // 填充时持有的引用，槽位被替换或线程退出时释放
+    hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT];
+} hdns_cache_local_slot_t;
+
+typedef struct {
+    hdns_cache_local_slot_t slots[HDNS_CACHE_LOCAL_SLOT_COUNT];
+} hdns_cache_local_t;
 
 static char *get_cache_key(const hdns_cache_entry_t *entry) {
     return hdns_str_is_blank(entry->cache_key) ? entry->host : entry->cache_key;
 }
 
-static hdns_hash_t *select_hash_table(hdns_cache_t *cache, hdns_rr_type_t type) {
-    return type == HDNS_RR_TYPE_A ? cache->v4_table : cache->v6_table;
+static APR_INLINE int family_index(hdns_rr_type_t type) {
+    return type == HDNS_RR_TYPE_AAAA ? 1 : 0;
+}
+
+static hdns_cache_shard_t *select_shard(hdns_cache_t *cache, uint64_t hash) {
+    // 分段使用哈希的高32位，哈希表探测使用低位，两者互不干扰
+    return &cache->shards[(uint32_t) (hash >> 32) & (cache->shard_count - 1)];
+}
+
+static APR_INLINE size_t str_bytes(const char *str) {
+    return str == NULL ? 0 : strlen(str) + 1;
+}
+
+static size_t estimate_entry_bytes(const hdns_cache_entry_t *entry) {
+    size_t bytes = sizeof(hdns_cache_entry_t) + sizeof(hdns_list_head_t);
+    bytes += str_bytes(entry->host) + str_bytes(entry->client_ip) + str_bytes(entry->extra) + str_bytes(entry->cache_key);
+    hdns_list_for_each_entry(cursor, entry->ips) {
+        bytes += sizeof(hdns_list_node_t) + str_bytes(cursor->data);
+    }
+    bytes += entry->addr_count * (entry->type == HDNS_RR_TYPE_AAAA ? sizeof(struct in6_addr) : sizeof(struct in_addr));
+    return bytes;
+}
+
+static APR_INLINE void lru_unlink(hdns_cache_node_t *node) {
+    node->lru_prev->lru_next = node->lru_next;
+    node->lru_next->lru_prev = node->lru_prev;
+    node->lru_prev = NULL;
+    node->lru_next = NULL;
+}
+
+static APR_INLINE void lru_push_front(hdns_cache_shard_t *shard, hdns_cache_node_t *node) {
+    node->lru_prev = &shard->lru;
+    node->lru_next = shard->lru.lru_next;
+    shard->lru.lru_next->lru_prev = node;
+    shard->lru.lru_next = node;
+}
+
+static APR_INLINE void lru_move_to_front(hdns_cache_shard_t *shard, hdns_cache_node_t *node) {
+    if (shard->lru.lru_next == node) {
+        return;
+    }
+    lru_unlink(node);
+    lru_push_front(shard, node);
+}
+
+static hdns_cache_node_t *shard_alloc_node(hdns_cache_shard_t *shard) {
+    hdns_cache_node_t *node = shard->free_nodes;
+    if (node != NULL) {
+        shard->free_nodes = node->lru_next;
+    } else {
+        node = hdns_palloc(shard->pool, sizeof(hdns_cache_node_t));
+    }
+    memset(node, 0, sizeof(hdns_cache_node_t));
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        node->timers[i].tag = i;
+    }
+    return node;
+}
+
+static APR_INLINE void shard_free_node(hdns_cache_shard_t *shard, hdns_cache_node_t *node) {
+    node->lru_next = shard->free_nodes;
+    shard->free_nodes = node;
+}
+
+/*
+ * 替换节点中某一类型的条目，返回被替换的旧条目
+ */
+static hdns_cache_entry_t *node_set_entry(hdns_cache_shard_t *shard,
+                                          hdns_cache_node_t *node,
+                                          int index,
+                                          hdns_cache_entry_t *entry,
+                                          size_t bytes) {
+    hdns_cache_entry_t *old_entry = node->entries[index];
+    apr_atomic_inc32(&shard->generation);
+    hdns_timer_wheel_remove(shard->wheel, &node->timers[index]);
+    if (old_entry != NULL) {
+        shard->entry_count--;
+        shard->bytes -= node->entry_bytes[index];
+    }
+    node->entries[index] = entry;
+    node->entry_bytes[index] = bytes;
+    if (entry != NULL) {
+        shard->entry_count++;
+        shard->bytes += bytes;
+    }
+    return old_entry;
+}
+
+/*
+ * 将节点移出哈希表和LRU链表，节点持有的条目转移到released中，由调用方在锁外释放
+ */
+static void shard_remove_node(hdns_cache_shard_t *shard,
+                              hdns_cache_node_t *node,
+                              hdns_cache_entry_t **released,
+                              int *released_count) {
+    hdns_htable_remove_with_hash(shard->table, node->key, node->klen, node->hash);
+    lru_unlink(node);
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        hdns_cache_entry_t *entry = node_set_entry(shard, node, i, NULL, 0);
+        if (entry != NULL) {
+            released[(*released_count)++] = entry;
+        }
+    }
+    shard_free_node(shard, node);
+}
+
+/*
+ * 移除节点中某一类型的条目，两种类型都不存在时移除节点，返回被移除的条目
+ */
+static hdns_cache_entry_t *node_remove_entry(hdns_cache_shard_t *shard, hdns_cache_node_t *node, int index) {
+    hdns_cache_entry_t *old_entry = node_set_entry(shard, node, index, NULL, 0);
+    hdns_cache_entry_t *remain_entry = node->entries[1 - index];
+    if (NULL == remain_entry) {
+        int released_count = 0;
+        shard_remove_node(shard, node, NULL, &released_count);
+    } else if (old_entry != NULL) {
+        node->key = get_cache_key(remain_entry);
+        hdns_htable_set_with_hash(shard->table, node->key, node->klen, node->hash, node);
+    }
+    return old_entry;
+}
+
+static APR_INLINE bool shard_is_over_capacity(const hdns_cache_shard_t *shard) {
+    return (shard->max_entries > 0 && shard->entry_count > shard->max_entries)
+           || (shard->max_bytes > 0 && shard->bytes > shard->max_bytes);
+}
+
+static APR_INLINE void release_entries(hdns_cache_entry_t **entries, int count) {
+    for (int i = 0; i < count; i++) {
+        hdns_resv_resp_destroy(entries[i]);
+    }
+}
+
+/*
+ * 分段锁内被淘汰的条目，调用方释放最后一次锁后统一释放；超出内联容量时转存到按需创建的列表
+ */
+typedef struct {
+    hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT * 16];
+    int count;
+    hdns_list_head_t *overflow;
+} hdns_cache_evicted_t;
+
+static APR_INLINE void evicted_init(hdns_cache_evicted_t *evicted) {
+    evicted->count = 0;
+    evicted->overflow = NULL;
+}
+
+static void evicted_add(hdns_cache_evicted_t *evicted, hdns_cache_entry_t *entry) {
+    if (evicted->count < (int) (sizeof(evicted->entries) / sizeof(evicted->entries[0]))) {
+        evicted->entries[evicted->count++] = entry;
+        return;
+    }
+    if (NULL == evicted->overflow) {
+        evicted->overflow = hdns_list_new(NULL);
+    }
+    hdns_list_add(evicted->overflow, entry, NULL);
+}
+
+/*
+ * 在锁外调用
+ */
+static void evicted_release(hdns_cache_evicted_t *evicted) {
+    release_entries(evicted->entries, evicted->count);
+    evicted->count = 0;
+    if (evicted->overflow != NULL) {
+        hdns_list_for_each_entry(cursor, evicted->overflow) {
+            hdns_resv_resp_destroy(cursor->data);
+        }
+        hdns_list_free(evicted->overflow);
+        evicted->overflow = NULL;
+    }
+}
+
+/*
+ * 淘汰最久未访问的域名直到满足容量，全程持有分段锁，被淘汰的条目加入evicted由调用方在锁外释放
+ */
+static void shard_evict_if_needed(hdns_cache_shard_t *shard, hdns_cache_evicted_t *evicted) {
+    while (shard_is_over_capacity(shard) && shard->lru.lru_prev != shard->lru.lru_next) {
+        hdns_cache_node_t *victim = shard->lru.lru_prev;
+        hdns_log_debug("cache evict entry, key:%s", victim->key);
+        hdns_cache_entry_t *removed[HDNS_CACHE_FAMILY_COUNT];
+        int removed_count = 0;
+        shard_remove_node(shard, victim, removed, &removed_count);
+        shard->evictions += removed_count;
+        for (int i = 0; i < removed_count; i++) {
+            evicted_add(evicted, removed[i]);
+        }
+    }
+}
+
+
+static APR_INLINE uint64_t time_to_tick(apr_time_t time) {
+    // 向上取整，保证不会提前变更状态
+    apr_time_t tick = apr_time_from_sec(HDNS_CACHE_EXPIRY_TICK_SEC);
+    return (uint64_t) ((time + tick - 1) / tick);
+}
+
+/*
+ * 根据当前时间计算条目的状态和下一次状态变化的时间，返回false表示过期超过保留时长，需要回收
+ */
+static bool evaluate_entry(hdns_cache_t *cache,
+                           const hdns_cache_entry_t *entry,
+                           apr_time_t now,
+                           apr_uint32_t *state,
+                           apr_time_t *next_time) {
+    int64_t ttl = entry->origin_ttl > 0 ? entry->origin_ttl : entry->ttl;
+    apr_time_t expire_time = entry->query_time + ttl * APR_USEC_PER_SEC;
+    apr_time_t reclaim_time = expire_time + apr_time_from_sec(cache->stale_retention_sec);
+    apr_uint32_t refresh_permille = apr_atomic_read32(&cache->refresh_permille);
+    apr_time_t refresh_time = entry->query_time + ttl * APR_USEC_PER_SEC / 1000 * refresh_permille;
+    if (now >= reclaim_time) {
+        *state = HDNS_CACHE_ENTRY_EXPIRED;
+        *next_time = now;
+        return false;
+    }
+    if (now >= expire_time) {
+        *state = HDNS_CACHE_ENTRY_EXPIRED;
+        *next_time = reclaim_time;
+    } else if (refresh_permille > 0 && now >= refresh_time) {
+        *state = HDNS_CACHE_ENTRY_REFRESH_DUE;
+        *next_time = expire_time;
+    } else {
+        *state = HDNS_CACHE_ENTRY_FRESH;
+        *next_time = refresh_permille > 0 ? refresh_time : expire_time;
+    }
+    return true;
+}
+
+/*
+ * 更新条目状态并挂到时间轮上，返回false表示条目需要回收；未启动时间轮时条目不被跟踪
+ */
+static bool schedule_entry(hdns_cache_t *cache,
+                           hdns_cache_shard_t *shard,
+                           hdns_cache_node_t *node,
+                           int index,
+                           apr_time_t now) {
+    if (!apr_atomic_read32(&cache->expiry_running)) {
+        return true;
+    }
+    hdns_cache_entry_t *entry = node->entries[index];
+    apr_uint32_t state;
+    apr_time_t next_time;
+    bool alive = evaluate_entry(cache, entry, now, &state, &next_time);
+    apr_uint32_t old_state = apr_atomic_xchg32(&entry->expiry_state, state);
+    if (state == HDNS_CACHE_ENTRY_EXPIRED
+        && (old_state == HDNS_CACHE_ENTRY_FRESH || old_state == HDNS_CACHE_ENTRY_REFRESH_DUE)) {
+        shard->counters.expirations++;
+        if (apr_atomic_read32(&cache->host_stats_enabled)) {
+            node->counters.expirations++;
+        }
+    }
+    hdns_timer_wheel_add(shard->wheel, &node->timers[index], time_to_tick(next_time));
+    return alive;
 }
 
+typedef struct {
+    hdns_cache_t *cache;
+    hdns_cache_shard_t *shard;
+    apr_time_t now;
+    hdns_list_head_t *released;
+} hdns_cache_expire_param_t;
+
+static void expire_entry_timer(void *arg, hdns_timer_wheel_node_t *timer) {
+    hdns_cache_expire_param_t *param = arg;
+    int index = (int) timer->tag;
+    hdns_cache_node_t *node = (hdns_cache_node_t *) ((char *) (timer - index) - offsetof(hdns_cache_node_t, timers));
+    if (NULL == node->entries[index]) {
+        return;
+    }
+    if (schedule_entry(param->cache, param->shard, node, index, param->now)) {
+        return;
+    }
+    hdns_log_debug("cache reclaim expired entry, key:%s", node->key);
+    hdns_cache_entry_t *entry = node_remove_entry(param->shard, node, index);
+    if (NULL == param->released) {
+        param->released = hdns_list_new(NULL);
+    }
+    hdns_list_add(param->released, entry, NULL);
+}
+
+static hdns_cache_t *create_cache(uint32_t count, bool full);
 
 hdns_cache_t *hdns_cache_table_create() {
+    return hdns_cache_table_create_with_shards(HDNS_CACHE_DEFAULT_SHARD_COUNT);
+}
+
+hdns_cache_t *hdns_cache_table_create_with_shards(uint32_t shard_count) {
+    uint32_t count = 1;
+    while (count < shard_count && count < HDNS_CACHE_MAX_SHARD_COUNT) {
+        count <<= 1;
+    }
+    return create_cache(count, true);
+}
+
+hdns_cache_t *hdns_cache_table_create_scratch() {
+    return create_cache(1, false);
+}
+
+/*
+ * full为false时创建临时缓存：不带时间轮、slab和访问频次统计，条目使用独立pool
+ */
+static hdns_cache_t *create_cache(uint32_t count, bool full) {
     hdns_pool_new(pool);
     hdns_cache_t *cache = hdns_palloc(pool, sizeof(hdns_cache_t));
     cache->pool = pool;
-    cache->v4_table = apr_hash_make(pool);
-    cache->v6_table = apr_hash_make(pool);
-    apr_thread_mutex_create(&cache->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    cache->shard_count = count;
+    cache->max_entries = 0;
+    cache->max_bytes = 0;
+    cache->slab = full ? hdns_slab_create() : NULL;
+    cache->shm = NULL;
+    cache->thread_pool = NULL;
+    apr_atomic_set32(&cache->expiry_running, 0);
+    apr_thread_mutex_create(&cache->expiry_lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    apr_atomic_set32(&cache->refresh_permille, 0);
+    cache->stale_retention_sec = HDNS_CACHE_STALE_RETENTION_SEC;
+    apr_atomic_set32(&cache->host_stats_enabled, 0);
+    apr_thread_mutex_create(&cache->subscriber_lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    cache->subscribers = hdns_list_new(pool);
+    apr_atomic_set32(&cache->subscriber_count, 0);
+    cache->notifying = hdns_list_new(pool);
+    apr_thread_cond_create(&cache->notify_done_cond, pool);
+    cache->sketch = full ? hdns_sketch_create(HDNS_SKETCH_DEFAULT_WIDTH, HDNS_SKETCH_HOT_KEY_CAPACITY) : NULL;
+    cache->id = apr_atomic_inc32(&g_hdns_cache_next_id) + 1;
+    apr_atomic_set32(&cache->local_cache_enabled, 0);
+    uint64_t current_tick = time_to_tick(hdns_clock_now());
+    cache->shards = hdns_pcalloc(pool, count * sizeof(hdns_cache_shard_t));
+    for (uint32_t i = 0; i < count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        hdns_pool_create(&shard->pool, pool);
+        shard->table = hdns_htable_make(shard->pool);
+        apr_thread_mutex_create(&shard->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+        shard->lru.lru_prev = &shard->lru;
+        shard->lru.lru_next = &shard->lru;
+        shard->free_nodes = NULL;
+        shard->wheel = full ? hdns_timer_wheel_create(shard->pool, current_tick) : NULL;
+    }
     return cache;
 }
 
-int32_t hdns_cache_table_add(hdns_cache_t *cache, const hdns_cache_entry_t *entry) {
-    apr_thread_mutex_lock(cache->lock);
+/*
+ * 在分段锁内将条目挂入本地表，接管entry的一个引用，返回被替换的旧条目；
+ * 旧条目和被淘汰的条目均由调用方在锁外释放
+ */
+static hdns_cache_entry_t *insert_entry_locked(hdns_cache_t *cache,
+                                               hdns_cache_shard_t *shard,
+                                               hdns_cache_entry_t *entry,
+                                               size_t klen,
+                                               uint64_t hash,
+                                               apr_time_t now,
+                                               hdns_cache_evicted_t *evicted) {
+    const char *key = get_cache_key(entry);
+    size_t bytes = estimate_entry_bytes(entry);
+    hdns_cache_node_t *node = hdns_htable_get_with_hash(shard->table, key, klen, hash);
+    if (NULL == node) {
+        node = shard_alloc_node(shard);
+        node->klen = klen;
+        node->hash = hash;
+        lru_push_front(shard, node);
+    } else {
+        lru_move_to_front(shard, node);
+    }
+    int index = family_index(entry->type);
+    hdns_cache_entry_t *old_entry = node_set_entry(shard, node, index, entry, bytes);
+    shard->counters.inserts++;
+    if (apr_atomic_read32(&cache->host_stats_enabled)) {
+        node->counters.inserts++;
+    }
+    // 键指向新条目，旧条目释放后依然有效
+    node->key = key;
+    hdns_htable_set_with_hash(shard->table, key, klen, hash, node);
+    // 过期过久的条目由下一次推进回收
+    schedule_entry(cache, shard, node, index, now);
+    shard_evict_if_needed(shard, evicted);
+    return old_entry;
+}
 
-    apr_hash_t *ht = select_hash_table(cache, entry->type);
-    char *cache_key = get_cache_key(entry);
+void hdns_cache_table_record_access(hdns_cache_t *cache, const char *key) {
+    if (NULL == cache->sketch || hdns_str_is_blank(key)) {
+        return;
+    }
+    hdns_sketch_increment(cache->sketch, key, hdns_htable_hash(key, NULL));
+}
 
-    hdns_cache_entry_t *old_entry = apr_hash_get(ht, cache_key, APR_HASH_KEY_STRING);
-    if (old_entry != NULL) {
-        apr_hash_set(ht, cache_key, APR_HASH_KEY_STRING, NULL);
-        hdns_resv_resp_destroy(old_entry);
+uint32_t hdns_cache_table_get_access_frequency(hdns_cache_t *cache, const char *key) {
+    if (NULL == cache->sketch || hdns_str_is_blank(key)) {
+        return 0;
+    }
+    return hdns_sketch_estimate(cache->sketch, hdns_htable_hash(key, NULL));
+}
+
+void hdns_cache_table_decay_access(hdns_cache_t *cache) {
+    if (NULL == cache->sketch) {
+        return;
+    }
+    hdns_sketch_decay(cache->sketch, (uint32_t) apr_time_sec(hdns_clock_now()));
+}
+
+hdns_list_head_t *hdns_cache_table_get_hot_keys(hdns_cache_t *cache) {
+    if (NULL == cache->sketch) {
+        return hdns_list_new(NULL);
+    }
+    return hdns_sketch_get_hot_keys(cache->sketch);
+}
+
+static hdns_list_head_t *sorted_ips(hdns_pool_t *pool, const hdns_list_head_t *ips) {
+    hdns_list_head_t *sorted = hdns_list_new(pool);
+    hdns_list_dup(sorted, ips, NULL);
+    hdns_list_sort(sorted, hdns_string_cmp_func);
+    return sorted;
+}
+
+/*
+ * 排序后逐个比较，重复的IP同样计数
+ */
+static bool same_ips(hdns_pool_t *pool, const hdns_list_head_t *ips1, const hdns_list_head_t *ips2) {
+    if (hdns_list_size(ips1) != hdns_list_size(ips2)) {
+        return false;
+    }
+    hdns_list_head_t *sorted1 = sorted_ips(pool, ips1);
+    hdns_list_head_t *sorted2 = sorted_ips(pool, ips2);
+    for (hdns_list_node_t *cursor1 = hdns_list_first(sorted1), *cursor2 = hdns_list_first(sorted2);
+         cursor1 != sorted1;
+         cursor1 = cursor1->next, cursor2 = cursor2->next) {
+        if (strcmp(cursor1->data, cursor2->data) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * 在subscriber_lock内调用，返回true时由调用方在锁外释放订阅者
+ */
+static APR_INLINE bool release_subscriber_locked(hdns_cache_subscriber_t *subscriber) {
+    return 0 == --subscriber->ref_count;
+}
+
+typedef struct {
+    hdns_cache_subscriber_t *subscriber;
+    apr_os_thread_t thread;
+} hdns_cache_notify_record_t;
+
+/*
+ * 在subscriber_lock内调用，判断是否有其他线程正在执行订阅者的回调
+ */
+static bool is_notifying_elsewhere_locked(hdns_cache_t *cache, const hdns_cache_subscriber_t *subscriber) {
+    apr_os_thread_t current = apr_os_thread_current();
+    hdns_list_for_each_entry(cursor, cache->notifying) {
+        hdns_cache_notify_record_t *record = cursor->data;
+        if (record->subscriber == subscriber && !apr_os_thread_equal(record->thread, current)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 逐个回调订阅者，已取消的订阅者不再回调；回调期间登记到notifying，取消订阅时据此等待
+ */
+static void call_subscriber(hdns_cache_t *cache,
+                            hdns_cache_subscriber_t *subscriber,
+                            const char *host,
+                            const hdns_cache_entry_t *new_entry,
+                            const hdns_list_head_t *old_ips,
+                            const hdns_list_head_t *new_ips) {
+    hdns_cache_notify_record_t record = {subscriber, apr_os_thread_current()};
+    hdns_list_node_t node = {NULL, NULL, NULL, &record};
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    bool removed = subscriber->removed;
+    if (!removed) {
+        hdns_list_insert_tail(&node, cache->notifying);
     }
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    if (!removed) {
+        subscriber->fn(host, new_entry->type, old_ips, new_ips, subscriber->param);
+    }
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    if (!removed) {
+        hdns_list_del(&node);
+        apr_thread_cond_broadcast(cache->notify_done_cond);
+    }
+    bool destroy = release_subscriber_locked(subscriber);
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    if (destroy) {
+        hdns_pool_destroy(subscriber->pool);
+    }
+}
+
+/*
+ * 新旧条目的IP集合不同时通知订阅者，在分段锁外调用；回调中允许取消订阅，因此先持有订阅者的引用再回调
+ */
+static void notify_subscribers(hdns_cache_t *cache,
+                               const hdns_cache_entry_t *old_entry,
+                               const hdns_cache_entry_t *new_entry) {
+    if (NULL == new_entry) {
+        return;
+    }
+    hdns_pool_new(pool);
+    hdns_list_head_t *empty_ips = hdns_list_new(pool);
+    const hdns_list_head_t *old_ips = old_entry != NULL ? old_entry->ips : empty_ips;
+    const hdns_list_head_t *new_ips = new_entry->ips != NULL ? new_entry->ips : empty_ips;
+    if (same_ips(pool, old_ips, new_ips)) {
+        hdns_pool_destroy(pool);
+        return;
+    }
+    // 按子网或SDNS参数分区的条目同样按域名通知
+    const char *host = hdns_str_is_not_blank(new_entry->host) ? new_entry->host : get_cache_key(new_entry);
+    hdns_list_head_t *matched = hdns_list_new(pool);
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    hdns_list_for_each_entry(cursor, cache->subscribers) {
+        hdns_cache_subscriber_t *subscriber = cursor->data;
+        if (NULL == subscriber->host || strcmp(subscriber->host, host) == 0) {
+            subscriber->ref_count++;
+            hdns_list_add(matched, subscriber, NULL);
+        }
+    }
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    hdns_list_for_each_entry(cursor, matched) {
+        call_subscriber(cache, cursor->data, host, new_entry, old_ips, new_ips);
+    }
+    hdns_pool_destroy(pool);
+}
+
+/*
+ * 有订阅者时额外持有新条目的引用，保证锁外比较时条目仍然有效
+ */
+static APR_INLINE hdns_cache_entry_t *retain_for_notify(hdns_cache_t *cache, hdns_cache_entry_t *entry) {
+    return apr_atomic_read32(&cache->subscriber_count) > 0 ? hdns_resv_resp_retain(entry) : NULL;
+}
 
-    hdns_cache_entry_t *entry_clone = hdns_resv_resp_clone(NULL, entry);
-    cache_key = get_cache_key(entry_clone);
-    apr_hash_set(ht, cache_key, APR_HASH_KEY_STRING, entry_clone);
-    apr_thread_mutex_unlock(cache->lock);
+/*
+ * 将条目挂入本地表，接管entry的一个引用
+ */
+static void insert_entry(hdns_cache_t *cache, hdns_cache_entry_t *entry) {
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(get_cache_key(entry), &klen);
+    hdns_cache_shard_t *shard = select_shard(cache, hash);
+    hdns_cache_entry_t *notify_entry = retain_for_notify(cache, entry);
+    hdns_cache_evicted_t evicted;
+    evicted_init(&evicted);
+
+    apr_thread_mutex_lock(shard->lock);
+    hdns_cache_entry_t *old_entry = insert_entry_locked(cache, shard, entry, klen, hash, hdns_clock_now(), &evicted);
+    apr_thread_mutex_unlock(shard->lock);
+    evicted_release(&evicted);
+
+    notify_subscribers(cache, old_entry, notify_entry);
+    hdns_resv_resp_destroy(notify_entry);
+    hdns_resv_resp_destroy(old_entry);
+}
+
+/*
+ * 拷贝为缓存持有的条目，超出slab最大块的条目退化为独立pool
+ */
+static hdns_cache_entry_t *copy_entry(hdns_cache_t *cache, const hdns_cache_entry_t *entry) {
+    hdns_cache_entry_t *copied = hdns_resv_resp_clone_to_slab(cache->slab, entry);
+    return copied != NULL ? copied : hdns_resv_resp_clone(NULL, entry);
+}
+
+int32_t hdns_cache_table_add(hdns_cache_t *cache, const hdns_cache_entry_t *entry) {
+    // 拷贝放在锁外，缩短临界区
+    insert_entry(cache, copy_entry(cache, entry));
+    if (cache->shm != NULL) {
+        hdns_shm_cache_put(cache->shm, entry);
+    }
     return HDNS_OK;
 }
 
 int32_t hdns_cache_table_delete(hdns_cache_t *cache, const char *key, hdns_rr_type_t type) {
-    apr_thread_mutex_lock(cache->lock);
-    apr_hash_t *ht = select_hash_table(cache, type);
-
-    hdns_cache_entry_t *old_entry = apr_hash_get(ht, key, APR_HASH_KEY_STRING);
-    if (old_entry != NULL) {
-        apr_hash_set(ht, get_cache_key(old_entry), APR_HASH_KEY_STRING, NULL);
-        hdns_resv_resp_destroy(old_entry);
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    hdns_cache_shard_t *shard = select_shard(cache, hash);
+    hdns_cache_entry_t *old_entry = NULL;
+    apr_thread_mutex_lock(shard->lock);
+    hdns_cache_node_t *node = hdns_htable_get_with_hash(shard->table, key, klen, hash);
+    if (node != NULL) {
+        old_entry = node_remove_entry(shard, node, family_index(type));
     }
+    apr_thread_mutex_unlock(shard->lock);
 
-    apr_thread_mutex_unlock(cache->lock);
+    hdns_resv_resp_destroy(old_entry);
+    if (cache->shm != NULL) {
+        hdns_shm_cache_delete(cache->shm, key, type);
+    }
     return HDNS_OK;
 }
 
+static APR_INLINE void count_lookup(hdns_cache_counters_t *counters, const hdns_cache_entry_t *entry, bool expired) {
+    if (NULL == counters) {
+        return;
+    }
+    if (NULL == entry) {
+        counters->misses++;
+    } else if (expired) {
+        counters->stale_hits++;
+    } else {
+        counters->hits++;
+    }
+}
+
+/*
+ * 在分段锁内查找want指定的类型，同时更新命中统计
+ */
+static void lookup_entries_locked(hdns_cache_t *cache,
+                                  hdns_cache_shard_t *shard,
+                                  const char *key,
+                                  size_t klen,
+                                  uint64_t hash,
+                                  const bool want[HDNS_CACHE_FAMILY_COUNT],
+                                  hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT]) {
+    hdns_cache_node_t *node = hdns_htable_get_with_hash(shard->table, key, klen, hash);
+    hdns_cache_counters_t *host_counters = NULL;
+    if (node != NULL) {
+        lru_move_to_front(shard, node);
+        if (apr_atomic_read32(&cache->host_stats_enabled)) {
+            host_counters = &node->counters;
+        }
+    }
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        if (!want[i]) {
+            continue;
+        }
+        hdns_cache_entry_t *entry = node != NULL ? node->entries[i] : NULL;
+        bool expired = entry != NULL && hdns_cache_entry_is_expired(entry);
+        count_lookup(&shard->counters, entry, expired);
+        count_lookup(host_counters, entry, expired);
+        if (entry != NULL) {
+            // 条目写入后不再修改，直接共享给调用方，只增加引用计数
+            entries[i] = hdns_resv_resp_retain(entry);
+        }
+    }
+}
+
+/*
+ * 在本地表中查找want指定的类型
+ */
+static void get_local_entries(hdns_cache_t *cache,
+                              const char *key,
+                              const bool want[HDNS_CACHE_FAMILY_COUNT],
+                              hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT]) {
+    // 哈希在锁外计算一次，分段选择和表内探测共用
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    hdns_cache_shard_t *shard = select_shard(cache, hash);
+    apr_thread_mutex_lock(shard->lock);
+    lookup_entries_locked(cache, shard, key, klen, hash, want, entries);
+    apr_thread_mutex_unlock(shard->lock);
+}
+
+/*
+ * 本地未命中或已过期时查询共享内存，其他进程可能已经刷新
+ */
+static hdns_cache_entry_t *get_shm_entry_if_newer(hdns_cache_t *cache,
+                                                  const char *key,
+                                                  hdns_rr_type_t type,
+                                                  hdns_cache_entry_t *entry) {
+    if (NULL == cache->shm || (entry != NULL && !hdns_cache_entry_is_expired(entry))) {
+        return entry;
+    }
+    hdns_cache_entry_t *shm_entry = hdns_shm_cache_get(cache->shm, key, type);
+    if (shm_entry != NULL && (NULL == entry || shm_entry->query_time > entry->query_time)) {
+        hdns_cache_entry_t *local_entry = copy_entry(cache, shm_entry);
+        hdns_resv_resp_destroy(shm_entry);
+        insert_entry(cache, hdns_resv_resp_retain(local_entry));
+        hdns_resv_resp_destroy(entry);
+        return local_entry;
+    }
+    hdns_resv_resp_destroy(shm_entry);
+    return entry;
+}
+
 hdns_cache_entry_t *hdns_cache_table_get(hdns_cache_t *cache, const char *key, hdns_rr_type_t type) {
-    apr_thread_mutex_lock(cache->lock);
-    apr_hash_t *ht = select_hash_table(cache, type);
-    hdns_cache_entry_t *entry = apr_hash_get(ht, key, APR_HASH_KEY_STRING);
+    bool want[HDNS_CACHE_FAMILY_COUNT] = {false};
+    hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT] = {NULL};
+    int index = family_index(type);
+    want[index] = true;
+    get_local_entries(cache, key, want, entries);
+    hdns_cache_entry_t *entry = get_shm_entry_if_newer(cache, key, type, entries[index]);
     if (NULL == entry) {
         hdns_log_debug("cache table get entry failed, entry doesn't exists");
-        apr_thread_mutex_unlock(cache->lock);
+    }
+    return entry;
+}
+
+void hdns_cache_table_get_both(hdns_cache_t *cache,
+                               const char *key,
+                               hdns_cache_entry_t **ipv4_entry,
+                               hdns_cache_entry_t **ipv6_entry) {
+    bool want[HDNS_CACHE_FAMILY_COUNT] = {true, true};
+    hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT] = {NULL};
+    get_local_entries(cache, key, want, entries);
+    *ipv4_entry = get_shm_entry_if_newer(cache, key, HDNS_RR_TYPE_A, entries[0]);
+    *ipv6_entry = get_shm_entry_if_newer(cache, key, HDNS_RR_TYPE_AAAA, entries[1]);
+}
+
+static void release_local_slot(hdns_cache_local_slot_t *slot) {
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        hdns_resv_resp_destroy(slot->entries[i]);
+        slot->entries[i] = NULL;
+    }
+    slot->cache_id = 0;
+}
+
+static void release_local_cache(void *data) {
+    hdns_cache_local_t *local = data;
+    if (NULL == local) {
+        return;
+    }
+    // 条目分配在引用计数的slab上，缓存已释放时依然可以安全释放
+    for (int i = 0; i < HDNS_CACHE_LOCAL_SLOT_COUNT; i++) {
+        release_local_slot(&local->slots[i]);
+    }
+    free(local);
+}
+
+int hdns_cache_local_init(hdns_pool_t *parent_pool) {
+    if (apr_threadkey_private_create(&g_hdns_cache_local_key, release_local_cache, parent_pool) != APR_SUCCESS) {
+        g_hdns_cache_local_key = NULL;
+        return HDNS_ERROR;
+    }
+    return HDNS_OK;
+}
+
+void hdns_cache_local_cleanup() {
+    if (NULL == g_hdns_cache_local_key) {
+        return;
+    }
+    // 其他线程持有的引用随线程退出释放，键删除后不再回调，只能在进程退出时回收
+    void *local = NULL;
+    apr_threadkey_private_get(&local, g_hdns_cache_local_key);
+    apr_threadkey_private_set(NULL, g_hdns_cache_local_key);
+    release_local_cache(local);
+    apr_threadkey_private_delete(g_hdns_cache_local_key);
+    g_hdns_cache_local_key = NULL;
+}
+
+void hdns_cache_table_enable_local_cache(hdns_cache_t *cache, bool enable) {
+    apr_atomic_set32(&cache->local_cache_enabled, enable ? 1 : 0);
+}
+
+static hdns_cache_local_t *get_local_cache() {
+    void *local = NULL;
+    if (NULL == g_hdns_cache_local_key || apr_threadkey_private_get(&local, g_hdns_cache_local_key) != APR_SUCCESS) {
         return NULL;
     }
-    hdns_cache_entry_t *entry_clone = hdns_resv_resp_clone(NULL, entry);
-    apr_thread_mutex_unlock(cache->lock);
-    return entry_clone;
+    if (NULL == local) {
+        local = calloc(1, sizeof(hdns_cache_local_t));
+        if (local != NULL && apr_threadkey_private_set(local, g_hdns_cache_local_key) != APR_SUCCESS) {
+            free(local);
+            local = NULL;
+        }
+    }
+    return local;
 }
 
-static int hdns_hash_do_get_keys_and_values_callback_fn(void *rec,
-                                                        const void *key,
-                                                        apr_ssize_t klen,
-                                                        const void *value) {
-    hdns_unused_var(key);
-    hdns_unused_var(klen);
-    hdns_list_head_t *list = rec;
-    hdns_list_add(list, value, NULL);
-    return 1;
+/*
+ * 挂载共享内存时，本地条目过期后需回源，其他进程可能已经刷新；
+ * 不存在的类型不要求回源，例如只有A记录的域名，调用方需要时会请求服务端并写入，使本地缓存失效
+ */
+static APR_INLINE bool local_slot_is_valid(hdns_cache_t *cache, const hdns_cache_local_slot_t *slot) {
+    if (NULL == cache->shm) {
+        return true;
+    }
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        if (slot->entries[i] != NULL && hdns_cache_entry_is_expired(slot->entries[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hdns_cache_table_get_both_local(hdns_cache_t *cache,
+                                     const char *key,
+                                     hdns_cache_entry_t **ipv4_entry,
+                                     hdns_cache_entry_t **ipv6_entry) {
+    if (!apr_atomic_read32(&cache->local_cache_enabled)) {
+        return false;
+    }
+    hdns_cache_local_t *local = get_local_cache();
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    if (NULL == local || klen >= HDNS_CACHE_LOCAL_MAX_KEY_LENGTH) {
+        return false;
+    }
+    hdns_cache_local_slot_t *slot = &local->slots[hash & (HDNS_CACHE_LOCAL_SLOT_COUNT - 1)];
+    // 先读代数再回源，回源期间发生的写入会使下一次查找重新回源
+    apr_uint32_t generation = apr_atomic_read32(&select_shard(cache, hash)->generation);
+    bool hit = slot->cache_id == cache->id
+               && slot->generation == generation
+               && slot->hash == hash
+               && strcmp(slot->key, key) == 0
+               && local_slot_is_valid(cache, slot);
+    if (hit) {
+        if (++slot->hits % HDNS_CACHE_LOCAL_ACCESS_SAMPLE == 0 && cache->sketch != NULL) {
+            hdns_sketch_add(cache->sketch, key, hash, HDNS_CACHE_LOCAL_ACCESS_SAMPLE);
+        }
+    } else {
+        release_local_slot(slot);
+        hdns_cache_table_get_both(cache, key, &slot->entries[0], &slot->entries[1]);
+        slot->cache_id = cache->id;
+        slot->generation = generation;
+        slot->hits = 0;
+        slot->hash = hash;
+        memcpy(slot->key, key, klen + 1);
+    }
+    *ipv4_entry = slot->entries[0];
+    *ipv6_entry = slot->entries[1];
+    return true;
+}
+
+#define HDNS_CACHE_BATCH_END ((size_t) -1)
+
+/*
+ * 批量操作时在锁外计算哈希，并按分段把下标串成链表：
+ * heads[分段]为该段第一个下标，next[下标]为同段下一个下标，保持原有顺序
+ */
+typedef struct {
+    size_t *klens;
+    uint64_t *hashes;
+    size_t *next;
+    size_t *heads;
+} hdns_cache_batch_t;
+
+static hdns_cache_batch_t *group_by_shard(hdns_pool_t *pool,
+                                          hdns_cache_t *cache,
+                                          const char *const *keys,
+                                          size_t count) {
+    hdns_cache_batch_t *batch = hdns_palloc(pool, sizeof(hdns_cache_batch_t));
+    batch->klens = hdns_pcalloc(pool, count * sizeof(size_t));
+    batch->hashes = hdns_palloc(pool, count * sizeof(uint64_t));
+    batch->next = hdns_palloc(pool, count * sizeof(size_t));
+    batch->heads = hdns_palloc(pool, cache->shard_count * sizeof(size_t));
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        batch->heads[i] = HDNS_CACHE_BATCH_END;
+    }
+    for (size_t i = count; i > 0; i--) {
+        size_t index = i - 1;
+        batch->hashes[index] = hdns_htable_hash(keys[index], &batch->klens[index]);
+        size_t shard_index = select_shard(cache, batch->hashes[index]) - cache->shards;
+        batch->next[index] = batch->heads[shard_index];
+        batch->heads[shard_index] = index;
+    }
+    return batch;
+}
+
+void hdns_cache_table_get_batch(hdns_cache_t *cache,
+                                const char *const *keys,
+                                size_t count,
+                                bool ipv4,
+                                bool ipv6,
+                                hdns_cache_entry_t **entries) {
+    memset(entries, 0, count * HDNS_CACHE_FAMILY_COUNT * sizeof(hdns_cache_entry_t *));
+    if (0 == count) {
+        return;
+    }
+    const bool want[HDNS_CACHE_FAMILY_COUNT] = {ipv4, ipv6};
+    hdns_pool_new(pool);
+    hdns_cache_batch_t *batch = group_by_shard(pool, cache, keys, count);
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        size_t index = batch->heads[i];
+        if (HDNS_CACHE_BATCH_END == index) {
+            continue;
+        }
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        for (; index != HDNS_CACHE_BATCH_END; index = batch->next[index]) {
+            lookup_entries_locked(cache,
+                                  shard,
+                                  keys[index],
+                                  batch->klens[index],
+                                  batch->hashes[index],
+                                  want,
+                                  &entries[index * HDNS_CACHE_FAMILY_COUNT]);
+        }
+        apr_thread_mutex_unlock(shard->lock);
+    }
+    hdns_pool_destroy(pool);
+    if (NULL == cache->shm) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        hdns_cache_entry_t **host_entries = &entries[i * HDNS_CACHE_FAMILY_COUNT];
+        if (ipv4) {
+            host_entries[0] = get_shm_entry_if_newer(cache, keys[i], HDNS_RR_TYPE_A, host_entries[0]);
+        }
+        if (ipv6) {
+            host_entries[1] = get_shm_entry_if_newer(cache, keys[i], HDNS_RR_TYPE_AAAA, host_entries[1]);
+        }
+    }
+}
+
+int32_t hdns_cache_table_add_batch(hdns_cache_t *cache, const hdns_list_head_t *entries) {
+    size_t count = hdns_list_size(entries);
+    if (0 == count) {
+        return HDNS_OK;
+    }
+    hdns_pool_new(pool);
+    // 拷贝和哈希放在锁外，缩短临界区
+    hdns_cache_entry_t **copied = hdns_palloc(pool, count * sizeof(hdns_cache_entry_t *));
+    hdns_cache_entry_t **old_entries = hdns_pcalloc(pool, count * sizeof(hdns_cache_entry_t *));
+    hdns_cache_entry_t **notify_entries = hdns_pcalloc(pool, count * sizeof(hdns_cache_entry_t *));
+    const char **keys = hdns_palloc(pool, count * sizeof(char *));
+    size_t count_copied = 0;
+    hdns_list_for_each_entry(cursor, entries) {
+        copied[count_copied] = copy_entry(cache, cursor->data);
+        notify_entries[count_copied] = retain_for_notify(cache, copied[count_copied]);
+        keys[count_copied] = get_cache_key(copied[count_copied]);
+        count_copied++;
+    }
+    hdns_cache_batch_t *batch = group_by_shard(pool, cache, keys, count);
+    apr_time_t now = hdns_clock_now();
+    hdns_cache_evicted_t evicted;
+    evicted_init(&evicted);
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        size_t index = batch->heads[i];
+        if (HDNS_CACHE_BATCH_END == index) {
+            continue;
+        }
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        for (; index != HDNS_CACHE_BATCH_END; index = batch->next[index]) {
+            old_entries[index] = insert_entry_locked(cache,
+                                                     shard,
+                                                     copied[index],
+                                                     batch->klens[index],
+                                                     batch->hashes[index],
+                                                     now,
+                                                     &evicted);
+        }
+        apr_thread_mutex_unlock(shard->lock);
+    }
+    evicted_release(&evicted);
+    for (size_t i = 0; i < count; i++) {
+        notify_subscribers(cache, old_entries[i], notify_entries[i]);
+    }
+    release_entries(notify_entries, (int) count);
+    release_entries(old_entries, (int) count);
+    hdns_pool_destroy(pool);
+    if (cache->shm != NULL) {
+        hdns_list_for_each_entry(cursor, entries) {
+            hdns_shm_cache_put(cache->shm, cursor->data);
+        }
+    }
+    return HDNS_OK;
+}
+
+void hdns_cache_table_attach_shm(hdns_cache_t *cache, hdns_shm_cache_t *shm) {
+    cache->shm = shm;
 }
 
 void hdns_cache_table_clean(hdns_cache_t *cache_table) {
     if (NULL == cache_table) {
         return;
     }
-    apr_thread_mutex_lock(cache_table->lock);
-    hdns_list_head_t *list = hdns_list_new(NULL);
+    for (uint32_t i = 0; i < cache_table->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache_table->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        // 条目挂到临时列表上，锁外统一释放
+        hdns_list_head_t *released = hdns_list_new(NULL);
+        while (shard->lru.lru_next != &shard->lru) {
+            hdns_cache_node_t *node = shard->lru.lru_next;
+            lru_unlink(node);
+            for (int j = 0; j < HDNS_CACHE_FAMILY_COUNT; j++) {
+                hdns_timer_wheel_remove(shard->wheel, &node->timers[j]);
+                if (node->entries[j] != NULL) {
+                    hdns_list_add(released, node->entries[j], NULL);
+                }
+            }
+            shard_free_node(shard, node);
+        }
+        hdns_htable_clear(shard->table);
+        apr_atomic_inc32(&shard->generation);
+        shard->entry_count = 0;
+        shard->bytes = 0;
+        apr_thread_mutex_unlock(shard->lock);
+        hdns_list_for_each_entry(cursor, released) {
+            hdns_resv_resp_destroy(cursor->data);
+        }
+        hdns_list_free(released);
+    }
+}
+
+void hdns_cache_table_set_capacity(hdns_cache_t *cache, size_t max_entries, size_t max_bytes) {
+    cache->max_entries = max_entries;
+    cache->max_bytes = max_bytes;
+    // 按分段向上取整均分
+    size_t shard_max_entries = (max_entries + cache->shard_count - 1) / cache->shard_count;
+    size_t shard_max_bytes = (max_bytes + cache->shard_count - 1) / cache->shard_count;
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        shard->max_entries = shard_max_entries;
+        shard->max_bytes = shard_max_bytes;
+        hdns_cache_evicted_t evicted;
+        evicted_init(&evicted);
+        shard_evict_if_needed(shard, &evicted);
+        apr_thread_mutex_unlock(shard->lock);
+        evicted_release(&evicted);
+    }
+}
+
+/*
+ * 两个上限中更严格的一个，0表示不限制
+ */
+static APR_INLINE size_t tighter_capacity(size_t a, size_t b) {
+    if (0 == a || 0 == b) {
+        return a + b;
+    }
+    return hdns_min(a, b);
+}
+
+void hdns_cache_table_merge_settings(hdns_cache_t *to, hdns_cache_t *from) {
+    size_t max_entries = tighter_capacity(to->max_entries, from->max_entries);
+    size_t max_bytes = tighter_capacity(to->max_bytes, from->max_bytes);
+    if (max_entries != to->max_entries || max_bytes != to->max_bytes) {
+        if (to->max_entries != 0 || to->max_bytes != 0) {
+            hdns_log_warn("clients sharing cache set different capacity, use the tighter one");
+        }
+        hdns_cache_table_set_capacity(to, max_entries, max_bytes);
+    }
+    if (apr_atomic_read32(&from->local_cache_enabled)) {
+        apr_atomic_set32(&to->local_cache_enabled, 1);
+    }
+    if (apr_atomic_read32(&from->host_stats_enabled)) {
+        apr_atomic_set32(&to->host_stats_enabled, 1);
+    }
+    apr_uint32_t from_permille = apr_atomic_read32(&from->refresh_permille);
+    apr_uint32_t to_permille = apr_atomic_read32(&to->refresh_permille);
+    if (from_permille != 0 && from_permille != to_permille) {
+        if (0 == to_permille) {
+            apr_atomic_set32(&to->refresh_permille, from_permille);
+        } else {
+            hdns_log_warn("clients sharing cache set different prefetch ratio, shared ratio is kept");
+        }
+    }
+}
+
+static void *APR_THREAD_FUNC hdns_cache_expiry_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    hdns_cache_t *cache = data;
+    if (!apr_atomic_read32(&cache->expiry_running)) {
+        return NULL;
+    }
+    hdns_cache_table_expire(cache, hdns_clock_now());
+    hdns_cache_table_decay_access(cache);
+    apr_thread_mutex_lock(cache->expiry_lock);
+    if (apr_atomic_read32(&cache->expiry_running)) {
+        apr_thread_pool_schedule(cache->thread_pool,
+                                 hdns_cache_expiry_task,
+                                 cache,
+                                 apr_time_from_sec(HDNS_CACHE_EXPIRY_TICK_SEC),
+                                 cache);
+    }
+    apr_thread_mutex_unlock(cache->expiry_lock);
+    return NULL;
+}
+
+/*
+ * 遍历分段内的全部条目，track为true时挂到时间轮上，否则摘下并恢复为按当前时间判断
+ */
+static void track_shard_entries(hdns_cache_t *cache, hdns_cache_shard_t *shard, bool track) {
+    apr_time_t now = hdns_clock_now();
+    apr_thread_mutex_lock(shard->lock);
+    for (hdns_cache_node_t *node = shard->lru.lru_next; node != &shard->lru; node = node->lru_next) {
+        for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+            if (NULL == node->entries[i]) {
+                continue;
+            }
+            if (track) {
+                schedule_entry(cache, shard, node, i, now);
+            } else {
+                hdns_timer_wheel_remove(shard->wheel, &node->timers[i]);
+                apr_atomic_set32(&node->entries[i]->expiry_state, HDNS_CACHE_ENTRY_UNTRACKED);
+            }
+        }
+    }
+    apr_thread_mutex_unlock(shard->lock);
+}
+
+hdns_status_t hdns_cache_table_start_expiry(hdns_cache_t *cache, apr_thread_pool_t *thread_pool) {
+    if (NULL == cache->shards[0].wheel) {
+        return hdns_status_error(HDNS_INVALID_ARGUMENT, HDNS_INVALID_ARGUMENT_CODE, "Scratch cache has no timer wheel", NULL);
+    }
+    if (apr_atomic_cas32(&cache->expiry_running, 1, 0) != 0) {
+        return hdns_status_ok(NULL);
+    }
+    cache->thread_pool = thread_pool;
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        track_shard_entries(cache, &cache->shards[i], true);
+    }
+    apr_status_t status = apr_thread_pool_schedule(thread_pool,
+                                                   hdns_cache_expiry_task,
+                                                   cache,
+                                                   apr_time_from_sec(HDNS_CACHE_EXPIRY_TICK_SEC),
+                                                   cache);
+    if (status != APR_SUCCESS) {
+        hdns_cache_table_stop_expiry(cache);
+        return hdns_status_error(HDNS_SCHEDULE_FAIL, HDNS_SCHEDULE_FAIL_CODE, "Submit task failed", NULL);
+    }
+    return hdns_status_ok(NULL);
+}
+
+void hdns_cache_table_stop_expiry(hdns_cache_t *cache) {
+    if (apr_atomic_cas32(&cache->expiry_running, 0, 1) != 1) {
+        return;
+    }
+    // 正在续期的任务完成提交后再取消，之后运行中的任务看到已停止，不会再续期
+    apr_thread_mutex_lock(cache->expiry_lock);
+    apr_thread_mutex_unlock(cache->expiry_lock);
+    apr_thread_pool_tasks_cancel(cache->thread_pool, cache);
+    // 停止推进后状态不再更新，恢复为读取时判断
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        track_shard_entries(cache, &cache->shards[i], false);
+    }
+}
+
+void hdns_cache_table_expire(hdns_cache_t *cache, apr_time_t now) {
+    // 向下取整，只处理已经到达的tick
+    uint64_t to_tick = (uint64_t) (now / apr_time_from_sec(HDNS_CACHE_EXPIRY_TICK_SEC));
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        if (NULL == shard->wheel) {
+            continue;
+        }
+        hdns_cache_expire_param_t param = {cache, shard, now, NULL};
+        apr_thread_mutex_lock(shard->lock);
+        hdns_timer_wheel_advance(shard->wheel, to_tick, expire_entry_timer, &param);
+        apr_thread_mutex_unlock(shard->lock);
+        if (param.released != NULL) {
+            hdns_list_for_each_entry(cursor, param.released) {
+                hdns_resv_resp_destroy(cursor->data);
+            }
+            hdns_list_free(param.released);
+        }
+    }
+}
+
+void hdns_cache_table_set_refresh_ratio(hdns_cache_t *cache, float ratio) {
+    apr_uint32_t permille = (ratio > 0 && ratio < 1) ? (apr_uint32_t) (ratio * 1000) : 0;
+    apr_atomic_set32(&cache->refresh_permille, permille);
+}
 
-    apr_hash_do(hdns_hash_do_get_keys_and_values_callback_fn, list, cache_table->v4_table);
-    apr_hash_do(hdns_hash_do_get_keys_and_values_callback_fn, list, cache_table->v6_table);
-    apr_hash_clear(cache_table->v4_table);
-    apr_hash_clear(cache_table->v6_table);
-    hdns_list_for_each_entry_safe(cur_cursor, list) {
-        hdns_resv_resp_destroy(cur_cursor->data);
+static void add_counters(hdns_cache_stats_t *stats, const hdns_cache_counters_t *counters) {
+    stats->hits += counters->hits;
+    stats->misses += counters->misses;
+    stats->stale_hits += counters->stale_hits;
+    stats->expirations += counters->expirations;
+    stats->inserts += counters->inserts;
+}
+
+void hdns_cache_table_get_stats(hdns_cache_t *cache, hdns_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(hdns_cache_stats_t));
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        add_counters(stats, &shard->counters);
+        stats->evictions += shard->evictions;
+        stats->entries += shard->entry_count;
+        stats->bytes += shard->bytes;
+        apr_thread_mutex_unlock(shard->lock);
     }
-    apr_thread_mutex_unlock(cache_table->lock);
-    hdns_list_free(list);
+}
+
+void hdns_cache_table_enable_host_stats(hdns_cache_t *cache, bool enable) {
+    apr_atomic_set32(&cache->host_stats_enabled, enable ? 1 : 0);
+}
+
+int32_t hdns_cache_table_get_host_stats(hdns_cache_t *cache, const char *key, hdns_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(hdns_cache_stats_t));
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    hdns_cache_shard_t *shard = select_shard(cache, hash);
+    apr_thread_mutex_lock(shard->lock);
+    hdns_cache_node_t *node = hdns_htable_get_with_hash(shard->table, key, klen, hash);
+    if (node != NULL) {
+        add_counters(stats, &node->counters);
+        for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+            if (node->entries[i] != NULL) {
+                stats->entries++;
+                stats->bytes += node->entry_bytes[i];
+            }
+        }
+    }
+    apr_thread_mutex_unlock(shard->lock);
+    return node != NULL ? HDNS_OK : HDNS_ERROR;
+}
+
+uint64_t hdns_cache_table_get_evictions(hdns_cache_t *cache) {
+    uint64_t evictions = 0;
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        evictions += shard->evictions;
+        apr_thread_mutex_unlock(shard->lock);
+    }
+    return evictions;
 }
 
 void hdns_cache_table_cleanup(hdns_cache_t *cache_table) {
+    // 共享内存中的条目仍由其他进程使用，这里只解除挂载
+    hdns_cache_table_stop_expiry(cache_table);
     hdns_cache_table_clean(cache_table);
-    apr_thread_mutex_destroy(cache_table->lock);
+    hdns_shm_cache_close(cache_table->shm);
+    for (uint32_t i = 0; i < cache_table->shard_count; i++) {
+        apr_thread_mutex_destroy(cache_table->shards[i].lock);
+    }
+    apr_thread_mutex_destroy(cache_table->subscriber_lock);
+    apr_thread_mutex_destroy(cache_table->expiry_lock);
+    apr_thread_cond_destroy(cache_table->notify_done_cond);
+    // 调用方仍持有的条目释放后slab才真正销毁
+    hdns_slab_release(cache_table->slab);
+    hdns_sketch_cleanup(cache_table->sketch);
     hdns_pool_destroy(cache_table->pool);
 }
 
+static bool is_same_subscriber(const hdns_cache_subscriber_t *subscriber,
+                               const char *host,
+                               hdns_cache_update_cb_fn_t fn,
+                               void *param,
+                               const void *owner) {
+    if (subscriber->fn != fn || subscriber->param != param || subscriber->owner != owner) {
+        return false;
+    }
+    if (NULL == subscriber->host || NULL == host) {
+        return subscriber->host == host;
+    }
+    return strcmp(subscriber->host, host) == 0;
+}
+
+/*
+ * 在subscriber_lock内调用，未找到时返回NULL
+ */
+static hdns_list_node_t *find_subscriber_locked(hdns_cache_t *cache,
+                                                const char *host,
+                                                hdns_cache_update_cb_fn_t fn,
+                                                void *param,
+                                                const void *owner) {
+    hdns_list_for_each_entry(cursor, cache->subscribers) {
+        if (is_same_subscriber(cursor->data, host, fn, param, owner)) {
+            return cursor;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 在subscriber_lock内调用，订阅者及其链表节点分配在独立的子pool上，取消后可以单独释放
+ */
+static void add_subscriber_locked(hdns_cache_t *cache,
+                                  const char *host,
+                                  hdns_cache_update_cb_fn_t fn,
+                                  void *param,
+                                  const void *owner) {
+    hdns_pool_t *pool = NULL;
+    hdns_pool_create(&pool, cache->pool);
+    hdns_cache_subscriber_t *subscriber = hdns_palloc(pool, sizeof(hdns_cache_subscriber_t));
+    subscriber->host = host != NULL ? apr_pstrdup(pool, host) : NULL;
+    subscriber->fn = fn;
+    subscriber->param = param;
+    subscriber->owner = owner;
+    subscriber->pool = pool;
+    subscriber->ref_count = 1;
+    subscriber->removed = false;
+    hdns_list_node_t *node = hdns_palloc(pool, sizeof(hdns_list_node_t));
+    node->pool = pool;
+    node->data = subscriber;
+    hdns_list_insert_tail(node, cache->subscribers);
+    apr_atomic_inc32(&cache->subscriber_count);
+}
+
+/*
+ * 在subscriber_lock内调用，只摘除不等待，遍历列表时可以安全调用；列表持有的引用转交给调用方
+ */
+static hdns_cache_subscriber_t *unlink_subscriber_locked(hdns_cache_t *cache, hdns_list_node_t *node) {
+    hdns_cache_subscriber_t *subscriber = node->data;
+    hdns_list_del(node);
+    apr_atomic_dec32(&cache->subscriber_count);
+    subscriber->removed = true;
+    return subscriber;
+}
+
+/*
+ * 在subscriber_lock内调用，等待其他线程中的回调返回后释放摘除时转交的引用；
+ * 等待期间会释放锁，调用方不能持有订阅者列表中的节点
+ */
+static bool wait_and_release_subscriber_locked(hdns_cache_t *cache, hdns_cache_subscriber_t *subscriber) {
+    while (is_notifying_elsewhere_locked(cache, subscriber)) {
+        apr_thread_cond_wait(cache->notify_done_cond, cache->subscriber_lock);
+    }
+    return release_subscriber_locked(subscriber);
+}
+
+/*
+ * 在subscriber_lock内调用，逐个等待并释放unlinked中的订阅者，需要销毁的加入released由调用方在锁外销毁
+ */
+static void wait_and_release_subscribers_locked(hdns_cache_t *cache,
+                                                hdns_list_head_t *unlinked,
+                                                hdns_list_head_t *released) {
+    hdns_list_for_each_entry(cursor, unlinked) {
+        if (wait_and_release_subscriber_locked(cache, cursor->data)) {
+            hdns_list_add(released, cursor->data, NULL);
+        }
+    }
+}
+
+int32_t hdns_cache_table_subscribe(hdns_cache_t *cache,
+                                   const char *host,
+                                   hdns_cache_update_cb_fn_t fn,
+                                   void *param,
+                                   const void *owner) {
+    if (NULL == cache || NULL == fn) {
+        return HDNS_INVALID_ARGUMENT;
+    }
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    if (NULL == find_subscriber_locked(cache, host, fn, param, owner)) {
+        add_subscriber_locked(cache, host, fn, param, owner);
+    }
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    return HDNS_OK;
+}
+
+int32_t hdns_cache_table_unsubscribe(hdns_cache_t *cache,
+                                     const char *host,
+                                     hdns_cache_update_cb_fn_t fn,
+                                     void *param,
+                                     const void *owner) {
+    if (NULL == cache || NULL == fn) {
+        return HDNS_INVALID_ARGUMENT;
+    }
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    hdns_list_node_t *node = find_subscriber_locked(cache, host, fn, param, owner);
+    hdns_cache_subscriber_t *subscriber = node != NULL ? unlink_subscriber_locked(cache, node) : NULL;
+    bool destroy = subscriber != NULL && wait_and_release_subscriber_locked(cache, subscriber);
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    if (destroy) {
+        hdns_pool_destroy(subscriber->pool);
+    }
+    return node != NULL ? HDNS_OK : HDNS_ERROR;
+}
+
+/*
+ * 在锁外销毁等待释放后引用归零的订阅者
+ */
+static void destroy_subscribers(hdns_list_head_t *released) {
+    hdns_list_for_each_entry(cursor, released) {
+        hdns_pool_destroy(((hdns_cache_subscriber_t *) cursor->data)->pool);
+    }
+}
+
+void hdns_cache_table_unsubscribe_owner(hdns_cache_t *cache, const void *owner) {
+    if (NULL == cache) {
+        return;
+    }
+    hdns_pool_new(pool);
+    hdns_list_head_t *unlinked = hdns_list_new(pool);
+    hdns_list_head_t *released = hdns_list_new(pool);
+    apr_thread_mutex_lock(cache->subscriber_lock);
+    // 先全部摘除再等待，等待期间锁会被释放，不能继续遍历订阅者列表
+    hdns_list_for_each_entry_safe(cursor, cache->subscribers) {
+        if (((hdns_cache_subscriber_t *) cursor->data)->owner == owner) {
+            hdns_list_add(unlinked, unlink_subscriber_locked(cache, cursor), NULL);
+        }
+    }
+    wait_and_release_subscribers_locked(cache, unlinked, released);
+    apr_thread_mutex_unlock(cache->subscriber_lock);
+    destroy_subscribers(released);
+    hdns_pool_destroy(pool);
+}
+
+static void *subscriber_dup(hdns_pool_t *pool, const void *data) {
+    hdns_cache_subscriber_t *subscriber = hdns_palloc(pool, sizeof(hdns_cache_subscriber_t));
+    memcpy(subscriber, data, sizeof(hdns_cache_subscriber_t));
+    subscriber->host = subscriber->host != NULL ? apr_pstrdup(pool, subscriber->host) : NULL;
+    return subscriber;
+}
+
+void hdns_cache_table_move_subscribers(hdns_cache_t *from, hdns_cache_t *to) {
+    if (NULL == from || NULL == to || from == to) {
+        return;
+    }
+    // 两个缓存的订阅锁依次获取，不会同时持有
+    hdns_pool_new(pool);
+    hdns_list_head_t *moved = hdns_list_new(pool);
+    hdns_list_head_t *unlinked = hdns_list_new(pool);
+    hdns_list_head_t *released = hdns_list_new(pool);
+    apr_thread_mutex_lock(from->subscriber_lock);
+    hdns_list_for_each_entry_safe(cursor, from->subscribers) {
+        hdns_list_add(moved, cursor->data, subscriber_dup);
+        hdns_list_add(unlinked, unlink_subscriber_locked(from, cursor), NULL);
+    }
+    wait_and_release_subscribers_locked(from, unlinked, released);
+    apr_thread_mutex_unlock(from->subscriber_lock);
+    destroy_subscribers(released);
+    apr_thread_mutex_lock(to->subscriber_lock);
+    hdns_list_for_each_entry(cursor, moved) {
+        hdns_cache_subscriber_t *subscriber = cursor->data;
+        if (NULL == find_subscriber_locked(to, subscriber->host, subscriber->fn, subscriber->param, subscriber->owner)) {
+            add_subscriber_locked(to, subscriber->host, subscriber->fn, subscriber->param, subscriber->owner);
+        }
+    }
+    apr_thread_mutex_unlock(to->subscriber_lock);
+    hdns_pool_destroy(pool);
+}
+
+typedef struct {
+    hdns_list_head_t *list;
+    int index;
+    // 本批还可以追加的键数
+    size_t remain;
+} hdns_cache_get_keys_param_t;
+
 static int hdns_hash_do_get_keys_callback_fn(void *rec,
-                                             const void *key,
-                                             apr_ssize_t klen,
-                                             const void *value) {
-    hdns_unused_var(key);
+                                             const char *key,
+                                             size_t klen,
+                                             void *value) {
     hdns_unused_var(klen);
-    hdns_list_head_t *list = rec;
-    const hdns_cache_entry_t *entry = value;
+    hdns_cache_get_keys_param_t *param = rec;
+    const hdns_cache_entry_t *entry = ((hdns_cache_node_t *) value)->entries[param->index];
+    if (NULL == entry) {
+        return 1;
+    }
     // SNDS entry ignore
     if (hdns_str_is_not_blank(entry->cache_key)
         && hdns_str_is_not_blank(entry->host)
         && strcmp(entry->cache_key, entry->host)) {
         return 1;
     }
-    hdns_list_add(list, key, hdns_to_list_clone_fn_t(apr_pstrdup));
-    return 1;
+    hdns_list_add(param->list, key, hdns_to_list_clone_fn_t(apr_pstrdup));
+    return --param->remain > 0;
 }
 
 hdns_list_head_t *hdns_cache_get_keys(hdns_cache_t *cache, hdns_rr_type_t type) {
+    hdns_list_head_t *keys = hdns_list_new(NULL);
+    hdns_cache_key_cursor_t cursor;
+    hdns_cache_key_cursor_init(&cursor, type);
+    while (!cursor.finished) {
+        hdns_cache_key_cursor_next(cache, &cursor, HDNS_CACHE_KEY_CURSOR_CHUNK, keys);
+    }
+    return keys;
+}
+
+void hdns_cache_key_cursor_init(hdns_cache_key_cursor_t *cursor, hdns_rr_type_t type) {
+    cursor->shard = 0;
+    cursor->slot = 0;
+    cursor->index = family_index(type);
+    cursor->finished = false;
+}
+
+size_t hdns_cache_key_cursor_next(hdns_cache_t *cache,
+                                  hdns_cache_key_cursor_t *cursor,
+                                  size_t limit,
+                                  hdns_list_head_t *keys) {
+    if (limit == 0) {
+        return 0;
+    }
+    hdns_cache_get_keys_param_t param = {keys, cursor->index, limit};
+    // 跳过没有目标键的分段，直到取到键或遍历结束，单次只持有一个分段的锁
+    while (param.remain == limit && cursor->shard < cache->shard_count) {
+        hdns_cache_shard_t *shard = &cache->shards[cursor->shard];
+        apr_thread_mutex_lock(shard->lock);
+        int end = hdns_htable_do_from(hdns_hash_do_get_keys_callback_fn, &param, shard->table, &cursor->slot);
+        apr_thread_mutex_unlock(shard->lock);
+        if (end) {
+            cursor->shard++;
+            cursor->slot = 0;
+        }
+    }
+    cursor->finished = cursor->shard >= cache->shard_count;
+    return limit - param.remain;
+}
+
+static int hdns_hash_do_get_entries_callback_fn(void *rec,
+                                                const char *key,
+                                                size_t klen,
+                                                void *value) {
+    hdns_unused_var(key);
+    hdns_unused_var(klen);
+    hdns_list_head_t *list = rec;
+    hdns_cache_node_t *node = value;
+    for (int i = 0; i < HDNS_CACHE_FAMILY_COUNT; i++) {
+        if (node->entries[i] != NULL) {
+            hdns_list_add(list, node->entries[i], hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+        }
+    }
+    return 1;
+}
+
+hdns_list_head_t *hdns_cache_get_entries(hdns_cache_t *cache) {
     hdns_list_head_t *list = hdns_list_new(NULL);
-    apr_hash_t *ht = type == HDNS_RR_TYPE_AAAA ? cache->v6_table : cache->v4_table;
-    apr_thread_mutex_lock(cache->lock);
-    apr_hash_do(hdns_hash_do_get_keys_callback_fn, list, ht);
-    apr_thread_mutex_unlock(cache->lock);
+    for (uint32_t i = 0; i < cache->shard_count; i++) {
+        hdns_cache_shard_t *shard = &cache->shards[i];
+        apr_thread_mutex_lock(shard->lock);
+        hdns_htable_do(hdns_hash_do_get_entries_callback_fn, list, shard->table);
+        apr_thread_mutex_unlock(shard->lock);
+    }
     return list;
-}
\ No newline at end of file
+}
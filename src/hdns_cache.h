@@ -6,38 +6,430 @@
 #define HDNS_C_SDK_HDNS_CACHE_H
 
 #include "hdns_resolver.h"
+#include "hdns_htable.h"
+#include "hdns_shm_cache.h"
+#include "hdns_timer_wheel.h"
+#include "hdns_sketch.h"
+#include "hdns_clock.h"
 #include "hdns_define.h"
+#include "apr_thread_pool.h"
+#include "apr_thread_cond.h"
 
 HDNS_CPP_START
 
+// 默认分段数，必须是2的幂
+#define HDNS_CACHE_DEFAULT_SHARD_COUNT  16
+#define HDNS_CACHE_MAX_SHARD_COUNT      1024
+// 时间轮推进间隔，也是过期判断的精度
+#define HDNS_CACHE_EXPIRY_TICK_SEC      1
+// 过期条目保留时长，期间可作为过期IP使用，之后回收
+#define HDNS_CACHE_STALE_RETENTION_SEC  (24 * 60 * 60)
+// 游标每次持锁最多取出的键数
+#define HDNS_CACHE_KEY_CURSOR_CHUNK     128
+// 线程本地缓存的槽位数，按键的哈希直接映射，必须是2的幂
+#define HDNS_CACHE_LOCAL_SLOT_COUNT     32
+// 超出长度的键不进入线程本地缓存
+#define HDNS_CACHE_LOCAL_MAX_KEY_LENGTH 128
+// 线程本地缓存命中时每隔多少次记录一次访问频次
+#define HDNS_CACHE_LOCAL_ACCESS_SAMPLE  16
+
+/*
+ * 条目的过期状态，由时间轮推进时更新；未被跟踪的条目读取时按当前时间判断
+ */
+typedef enum {
+    HDNS_CACHE_ENTRY_UNTRACKED = 0,
+    HDNS_CACHE_ENTRY_FRESH,
+    HDNS_CACHE_ENTRY_REFRESH_DUE,
+    HDNS_CACHE_ENTRY_EXPIRED
+} hdns_cache_entry_state_e;
+
+typedef hdns_resv_resp_t hdns_cache_entry_t;
+
+/*
+ * 缓存IP集合变化的回调，old_ips为空列表表示此前没有条目，在写入线程中执行，不能阻塞
+ */
+typedef void (*hdns_cache_update_cb_fn_t)(const char *host,
+                                          hdns_rr_type_t type,
+                                          const hdns_list_head_t *old_ips,
+                                          const hdns_list_head_t *new_ips,
+                                          void *param);
+
+typedef struct {
+    // NULL表示订阅全部域名
+    char *host;
+    hdns_cache_update_cb_fn_t fn;
+    void *param;
+    // 登记订阅的客户端，共享缓存时按客户端取消订阅
+    const void *owner;
+    // 每个订阅者独占的子pool，取消订阅且没有通知引用时释放
+    hdns_pool_t *pool;
+    // 列表持有一个引用，正在通知的线程各持有一个引用，在subscriber_lock内修改
+    uint32_t ref_count;
+    bool removed;
+} hdns_cache_subscriber_t;
+
+/*
+ * 缓存计数，分段和域名节点各持有一份，均在分段锁内更新，不额外加锁
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    // 命中已过期的条目
+    uint64_t stale_hits;
+    // 时间轮将条目标记为过期的次数
+    uint64_t expirations;
+    uint64_t inserts;
+} hdns_cache_counters_t;
+
+/*
+ * 缓存统计快照
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale_hits;
+    uint64_t expirations;
+    uint64_t evictions;
+    uint64_t inserts;
+    // 当前条目数，A和AAAA分别计数
+    uint64_t entries;
+    // 当前条目估算占用的内存字节数
+    uint64_t bytes;
+} hdns_cache_stats_t;
+
+typedef struct hdns_cache_node_s hdns_cache_node_t;
+
+// 每个域名一个节点，A和AAAA记录按下标存放
+#define HDNS_CACHE_FAMILY_COUNT  2
+
+/*
+ * 哈希表中存放的域名节点，同时持有A和AAAA两个条目，两者TTL互相独立；
+ * 节点分配在分段的pool上并通过空闲链表复用，key指向任一现存条目的cache_key，
+ * 通过侵入式双向链表维护LRU顺序
+ */
+struct hdns_cache_node_s {
+    hdns_cache_entry_t *entries[HDNS_CACHE_FAMILY_COUNT];
+    size_t entry_bytes[HDNS_CACHE_FAMILY_COUNT];
+    const char *key;
+    size_t klen;
+    uint64_t hash;
+    hdns_cache_node_t *lru_prev;
+    hdns_cache_node_t *lru_next;
+    // 每个条目下一次状态变化的定时节点，tag为条目下标
+    hdns_timer_wheel_node_t timers[HDNS_CACHE_FAMILY_COUNT];
+    // 开启按域名统计时才更新，节点移除后清零
+    hdns_cache_counters_t counters;
+};
+
+/*
+ * 缓存分段，每段独立加锁，不同域名按哈希落到不同分段，互不阻塞
+ */
 typedef struct {
     hdns_pool_t *pool;
-    hdns_hash_t *v4_table;
-    hdns_hash_t *v6_table;
+    hdns_htable_t *table;
     apr_thread_mutex_t *lock;
-} hdns_cache_t;
+    // LRU哨兵节点，lru_next为最近访问，lru_prev为最久未访问
+    hdns_cache_node_t lru;
+    // 已释放节点的空闲链表，通过lru_next串联
+    hdns_cache_node_t *free_nodes;
+    hdns_timer_wheel_t *wheel;
+    // 条目数按A和AAAA分别计数
+    size_t entry_count;
+    size_t bytes;
+    // 0表示不限制
+    size_t max_entries;
+    size_t max_bytes;
+    uint64_t evictions;
+    hdns_cache_counters_t counters;
+    // 分段内任一条目变化时递增，使线程本地缓存中属于该分段的键失效
+    volatile apr_uint32_t generation;
+} hdns_cache_shard_t;
 
-typedef hdns_resv_resp_t hdns_cache_entry_t;
+/*
+ * 分批遍历缓存键的游标，记录下一次开始的分段和槽位
+ */
+typedef struct {
+    uint32_t shard;
+    size_t slot;
+    int index;
+    bool finished;
+} hdns_cache_key_cursor_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    hdns_cache_shard_t *shards;
+    uint32_t shard_count;
+    // 设置的总容量上限，0表示不限制，分段上限按其均分
+    size_t max_entries;
+    size_t max_bytes;
+    // 条目按大小分级分配在slab上，避免每个条目独占一个pool
+    hdns_slab_t *slab;
+    // 可选的跨进程共享层，写入时同步写入，本地未命中或过期时回源读取
+    hdns_shm_cache_t *shm;
+    // 驱动时间轮的线程池，未启动时条目不被跟踪
+    apr_thread_pool_t *thread_pool;
+    volatile apr_uint32_t expiry_running;
+    // 串行化过期任务的续期和停止，停止后不会再有新的任务提交
+    apr_thread_mutex_t *expiry_lock;
+    // 预取比例的千分值，时间轮据此标记需要刷新的条目
+    volatile apr_uint32_t refresh_permille;
+    int64_t stale_retention_sec;
+    volatile apr_uint32_t host_stats_enabled;
+    // 订阅者列表，写入时先读计数，没有订阅者时不比较IP集合
+    apr_thread_mutex_t *subscriber_lock;
+    hdns_list_head_t *subscribers;
+    volatile apr_uint32_t subscriber_count;
+    // 正在执行的回调，取消订阅时等待其他线程中的回调返回
+    hdns_list_head_t *notifying;
+    apr_thread_cond_t *notify_done_cond;
+    // 按缓存键统计的访问频次，由解析入口记录，用于热点刷新和刷新排序
+    hdns_sketch_t *sketch;
+    // 进程内唯一的编号，线程本地缓存据此区分不同的缓存实例
+    apr_uint32_t id;
+    volatile apr_uint32_t local_cache_enabled;
+} hdns_cache_t;
 
 static APR_INLINE bool hdns_cache_entry_is_expired(hdns_cache_entry_t *entry) {
+    apr_uint32_t state = apr_atomic_read32(&entry->expiry_state);
+    if (state != HDNS_CACHE_ENTRY_UNTRACKED) {
+        return state == HDNS_CACHE_ENTRY_EXPIRED;
+    }
     int64_t ttl = entry->origin_ttl > 0 ? entry->origin_ttl : entry->ttl;
-    return entry->query_time + ttl * APR_USEC_PER_SEC <= apr_time_now();
+    return entry->query_time + ttl * APR_USEC_PER_SEC <= hdns_clock_now();
+}
+
+/*
+ * 服务端确认没有记录的负缓存条目
+ */
+static APR_INLINE bool hdns_cache_entry_is_negative(const hdns_cache_entry_t *entry) {
+    return !entry->from_localdns && hdns_list_is_empty(entry->ips);
+}
+
+/*
+ * 条目未过期，但已过去的TTL比例达到ratio，需要提前刷新；负缓存到期后按需重新请求，不预取
+ */
+static APR_INLINE bool hdns_cache_entry_need_prefetch(hdns_cache_entry_t *entry, float ratio) {
+    if (ratio <= 0 || ratio >= 1 || hdns_cache_entry_is_negative(entry)) {
+        return false;
+    }
+    apr_uint32_t state = apr_atomic_read32(&entry->expiry_state);
+    if (state != HDNS_CACHE_ENTRY_UNTRACKED) {
+        return state == HDNS_CACHE_ENTRY_REFRESH_DUE;
+    }
+    int64_t ttl = entry->origin_ttl > 0 ? entry->origin_ttl : entry->ttl;
+    apr_time_t now = hdns_clock_now();
+    return entry->query_time + (apr_time_t) (ttl * ratio * APR_USEC_PER_SEC) <= now
+           && entry->query_time + ttl * APR_USEC_PER_SEC > now;
+}
+
+/*
+ * 标记条目正在预取，只有第一个标记成功的调用方负责提交刷新任务
+ */
+static APR_INLINE bool hdns_cache_entry_try_mark_prefetch(hdns_cache_entry_t *entry) {
+    return apr_atomic_cas32(&entry->prefetching, 1, 0) == 0;
+}
+
+static APR_INLINE void hdns_cache_entry_unmark_prefetch(hdns_cache_entry_t *entry) {
+    apr_atomic_set32(&entry->prefetching, 0);
 }
 
 hdns_cache_t *hdns_cache_table_create();
 
+/*
+ * 指定分段数创建缓存，分段数会向上取整到2的幂
+ */
+hdns_cache_t *hdns_cache_table_create_with_shards(uint32_t shard_count);
+
+/*
+ * 创建只用于收集一次解析结果的临时缓存：单分段，不带时间轮、slab和访问频次统计，不能启动过期推进
+ */
+hdns_cache_t *hdns_cache_table_create_scratch();
+
 int32_t hdns_cache_table_add(hdns_cache_t *cache, const hdns_cache_entry_t *entry);
 
 int32_t hdns_cache_table_delete(hdns_cache_t *cache, const char *key, hdns_rr_type_t type);
 
+/*
+ * 返回缓存条目的只读共享视图，调用方不可修改，使用完毕后通过hdns_resv_resp_destroy释放引用
+ */
 hdns_cache_entry_t *hdns_cache_table_get(hdns_cache_t *cache, const char *key, hdns_rr_type_t type);
 
+/*
+ * 一次查找同时获取A和AAAA条目，只探测一次哈希表、加一次锁，不存在的类型返回NULL；
+ * 返回的条目同样需要通过hdns_resv_resp_destroy释放
+ */
+void hdns_cache_table_get_both(hdns_cache_t *cache,
+                               const char *key,
+                               hdns_cache_entry_t **ipv4_entry,
+                               hdns_cache_entry_t **ipv6_entry);
+
+/*
+ * 批量查找，keys按分段归并，每个分段只加一次锁；
+ * 第i个key的A和AAAA条目分别存放在entries[2*i]和entries[2*i+1]，未查找的类型为NULL，
+ * entries至少容纳2*count个元素，非NULL的条目需要调用方逐个hdns_resv_resp_destroy
+ */
+void hdns_cache_table_get_batch(hdns_cache_t *cache,
+                                const char *const *keys,
+                                size_t count,
+                                bool ipv4,
+                                bool ipv6,
+                                hdns_cache_entry_t **entries);
+
+/*
+ * 批量写入hdns_cache_entry_t列表，每个分段只加一次锁
+ */
+int32_t hdns_cache_table_add_batch(hdns_cache_t *cache, const hdns_list_head_t *entries);
+
+/*
+ * 清空本进程的缓存，挂载的共享内存由其他进程共用，其中的条目保留，按TTL过期
+ */
 void hdns_cache_table_clean(hdns_cache_t *cache_table);
 
+/*
+ * 挂载共享内存缓存，需在缓存开始使用前调用，cleanup时解除挂载
+ */
+void hdns_cache_table_attach_shm(hdns_cache_t *cache, hdns_shm_cache_t *shm);
+
+/*
+ * 设置缓存容量上限，max_entries为条目数（A和AAAA分别计数），max_bytes为估算的内存字节数，0表示不限制；
+ * 容量按分段均分，超出时淘汰分段内最久未访问的域名
+ */
+void hdns_cache_table_set_capacity(hdns_cache_t *cache, size_t max_entries, size_t max_bytes);
+
+/*
+ * 将from上设置的容量上限、线程本地缓存、按域名统计和预取比例合并到to，用于客户端加入共享缓存；
+ * 容量取更严格的上限，开关任一方开启即开启，预取比例冲突时保留to的设置
+ */
+void hdns_cache_table_merge_settings(hdns_cache_t *to, hdns_cache_t *from);
+
+/*
+ * 启动后台任务定期推进时间轮，之后写入的条目由时间轮标记待刷新、过期，过期超过保留时长后回收，
+ * 读取时不再逐条比较当前时间
+ */
+hdns_status_t hdns_cache_table_start_expiry(hdns_cache_t *cache, apr_thread_pool_t *thread_pool);
+
+/*
+ * 停止推进时间轮，等待正在执行的推进任务完成
+ */
+void hdns_cache_table_stop_expiry(hdns_cache_t *cache);
+
+/*
+ * 将时间轮推进到now，由后台任务调用
+ */
+void hdns_cache_table_expire(hdns_cache_t *cache, apr_time_t now);
+
+/*
+ * 设置时间轮标记待刷新条目使用的TTL比例，只影响之后写入的条目
+ */
+void hdns_cache_table_set_refresh_ratio(hdns_cache_t *cache, float ratio);
+
+/*
+ * 累计因容量限制被淘汰的条目数
+ */
+uint64_t hdns_cache_table_get_evictions(hdns_cache_t *cache);
+
+/*
+ * 汇总各分段的统计；只有查询到本地节点的请求计入域名维度
+ */
+void hdns_cache_table_get_stats(hdns_cache_t *cache, hdns_cache_stats_t *stats);
+
+void hdns_cache_table_enable_host_stats(hdns_cache_t *cache, bool enable);
+
+/*
+ * 获取单个域名的统计，域名不在缓存中时返回HDNS_ERROR；evictions恒为0
+ */
+int32_t hdns_cache_table_get_host_stats(hdns_cache_t *cache, const char *key, hdns_cache_stats_t *stats);
+
+/*
+ * 订阅IP集合变化，host为NULL时订阅全部域名；同一个owner的同一个(host, fn, param)只登记一次
+ */
+int32_t hdns_cache_table_subscribe(hdns_cache_t *cache,
+                                   const char *host,
+                                   hdns_cache_update_cb_fn_t fn,
+                                   void *param,
+                                   const void *owner);
+
+/*
+ * 取消订阅，返回后不再触发回调，其他线程中正在执行的回调也已返回；
+ * 回调中可以取消自身的订阅，但不能取消其他订阅，否则两个回调互相等待
+ */
+int32_t hdns_cache_table_unsubscribe(hdns_cache_t *cache,
+                                     const char *host,
+                                     hdns_cache_update_cb_fn_t fn,
+                                     void *param,
+                                     const void *owner);
+
+/*
+ * 取消owner登记的全部订阅，等待语义与hdns_cache_table_unsubscribe相同
+ */
+void hdns_cache_table_unsubscribe_owner(hdns_cache_t *cache, const void *owner);
+
+/*
+ * 将from上的全部订阅转移到to，用于客户端的缓存被共享缓存替换时保留启动前的订阅
+ */
+void hdns_cache_table_move_subscribers(hdns_cache_t *from, hdns_cache_t *to);
+
+/*
+ * 记录一次对缓存键的访问，后台刷新本身不应调用
+ */
+void hdns_cache_table_record_access(hdns_cache_t *cache, const char *key);
+
+uint32_t hdns_cache_table_get_access_frequency(hdns_cache_t *cache, const char *key);
+
+/*
+ * 访问频次按固定间隔衰减，由缓存过期和热点刷新的后台任务调用
+ */
+void hdns_cache_table_decay_access(hdns_cache_t *cache);
+
+/*
+ * 访问频次最高的缓存键，元素为hdns_sketch_hot_item_t，按频次从高到低排列，通过hdns_list_free释放
+ */
+hdns_list_head_t *hdns_cache_table_get_hot_keys(hdns_cache_t *cache);
+
+/*
+ * 线程本地缓存：每个线程保留最近查找的少量缓存键及其条目引用，键所在分段的代数未变化时直接返回，不加锁；
+ * 分段写入、删除、淘汰或回收条目时递增该分段的代数，只使落在该分段的键失效；命中时按采样记录访问频次。
+ * 在SDK初始化和清理时调用，清理时只释放当前线程持有的引用
+ */
+int hdns_cache_local_init(hdns_pool_t *parent_pool);
+
+void hdns_cache_local_cleanup();
+
+/*
+ * 开启后hdns_cache_table_get_both_local才会使用线程本地缓存；本地缓存命中不计入命中统计，也不更新LRU顺序
+ */
+void hdns_cache_table_enable_local_cache(hdns_cache_t *cache, bool enable);
+
+/*
+ * 经线程本地缓存查找A和AAAA条目，未命中时回源hdns_cache_table_get_both并填充本地缓存；
+ * 返回的条目由当前线程的本地缓存持有，调用方不能释放，只在当前线程下一次查找前有效，需要继续持有时通过hdns_resv_resp_share增加引用；
+ * 未开启本地缓存时返回false，不做查找
+ */
+bool hdns_cache_table_get_both_local(hdns_cache_t *cache,
+                                     const char *key,
+                                     hdns_cache_entry_t **ipv4_entry,
+                                     hdns_cache_entry_t **ipv6_entry);
+
 void hdns_cache_table_cleanup(hdns_cache_t *cache_table);
 
 hdns_list_head_t *hdns_cache_get_keys(hdns_cache_t *cache, hdns_rr_type_t type);
 
+void hdns_cache_key_cursor_init(hdns_cache_key_cursor_t *cursor, hdns_rr_type_t type);
+
+/*
+ * 从游标位置起取出最多limit个存在type条目的键追加到keys，每批只持有一个分段的锁，批次之间释放；
+ * 返回追加的键数，返回0且cursor->finished为true时遍历结束；遍历期间写入或扩容的键可能重复或遗漏
+ */
+size_t hdns_cache_key_cursor_next(hdns_cache_t *cache,
+                                  hdns_cache_key_cursor_t *cursor,
+                                  size_t limit,
+                                  hdns_list_head_t *keys);
+
+/*
+ * 获取全部缓存条目的只读共享引用，通过hdns_list_free释放
+ */
+hdns_list_head_t *hdns_cache_get_entries(hdns_cache_t *cache);
+
 HDNS_CPP_END
 
 #endif
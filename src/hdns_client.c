@@ -6,11 +6,16 @@
 #include "hdns_ip.h"
 #include "hdns_buf.h"
 #include "hdns_localdns.h"
+#include "hdns_utils.h"
 #include "hdns_log.h"
 
 #include "hdns_client.h"
 
 #define HDNS_MULTI_RESOLVE_SIZE 5
+// 线程池积压超过该值时放弃预取，避免挤占用户的异步解析任务
+#define HDNS_PREFETCH_MAX_TASK_COUNT 100
+// 热点域名的后台刷新间隔，剩余TTL不足两个间隔的热点条目会被刷新
+#define HDNS_HOT_HOST_REFRESH_INTERVAL_SEC 5
 
 hdns_status_t hdns_fetch_resv_results(hdns_client_t *client, hdns_resv_req_t *resv_req, hdns_cache_t *cache);
 
@@ -22,14 +27,13 @@ hdns_status_t hdns_batch_fetch_resv_results(hdns_client_t *client,
 
 static hdns_query_type_t unwrap_auto_query_type(hdns_net_detector_t *detector);
 
-static int collect_resv_resp_in_cache_or_localdns(hdns_cache_t *cache,
-                                                  const char *host,
-                                                  const char *cache_key,
-                                                  bool enable_expired_ip,
-                                                  bool enable_failover_localdns,
-                                                  hdns_list_head_t *results,
-                                                  hdns_query_type_t query_type,
-                                                  hdns_rr_type_t rr_type);
+static int collect_resv_resps_in_cache_or_localdns(hdns_cache_t *cache,
+                                                   const char *host,
+                                                   const char *cache_key,
+                                                   bool enable_expired_ip,
+                                                   bool enable_failover_localdns,
+                                                   hdns_list_head_t *results,
+                                                   hdns_query_type_t query_type);
 
 hdns_status_t hdns_do_single_resolve_with_req(hdns_client_t *client,
                                               hdns_resv_req_t *resv_req,
@@ -52,38 +56,366 @@ static APR_INLINE bool is_query_match(hdns_query_type_t query_type, hdns_rr_type
     }
 }
 
-static int collect_resv_resp_in_cache_or_localdns(hdns_cache_t *cache,
-                                                  const char *host,
-                                                  const char *cache_key,
-                                                  bool enable_expired_ip,
-                                                  bool enable_failover_localdns,
-                                                  hdns_list_head_t *results,
-                                                  hdns_query_type_t query_type,
-                                                  hdns_rr_type_t rr_type) {
+static APR_INLINE int32_t merge_query_type(bool ipv4, bool ipv6) {
+    if (ipv4 && ipv6) {
+        return HDNS_QUERY_BOTH;
+    }
+    if (ipv4) {
+        return HDNS_QUERY_IPV4;
+    }
+    if (ipv6) {
+        return HDNS_QUERY_IPV6;
+    }
+    return -1;
+}
+
+typedef struct {
+    hdns_pool_t *pool;
+    hdns_client_t *client;
+    // 单域名预取使用resv_req，批量预取使用hosts
+    hdns_resv_req_t *resv_req;
+    hdns_list_head_t *hosts;
+    hdns_query_type_t query_type;
+    const char *client_ip;
+    // 触发预取的条目（共享引用），刷新失败时清除标记以便下次命中重新触发
+    hdns_list_head_t *entries;
+} hdns_prefetch_task_param_t;
+
+/*
+ * 开启按子网分区缓存且指定了client_ip时，返回附加在缓存键后的子网后缀，如"@1.2.3.0/24"
+ */
+static char *get_client_subnet_suffix(hdns_pool_t *pool, hdns_client_t *client, const char *client_ip) {
+    if (hdns_str_is_blank(client_ip)) {
+        return NULL;
+    }
+    int32_t ipv4_prefix_len;
+    int32_t ipv6_prefix_len;
+    hdns_config_get_client_subnet_prefix(client->config, &ipv4_prefix_len, &ipv6_prefix_len);
+    if (ipv4_prefix_len <= 0 || ipv6_prefix_len <= 0) {
+        return NULL;
+    }
+    char *subnet = hdns_ip_to_subnet(pool, client_ip, ipv4_prefix_len, ipv6_prefix_len);
+    return subnet != NULL ? apr_pstrcat(pool, HDNS_CLIENT_SUBNET_SEPARATOR, subnet, NULL) : NULL;
+}
+
+static APR_INLINE char *append_subnet_suffix(hdns_pool_t *pool, const char *key, const char *subnet_suffix) {
+    return subnet_suffix != NULL ? apr_pstrcat(pool, key, subnet_suffix, NULL) : (char *) key;
+}
+
+static float get_prefetch_ratio(hdns_client_t *client) {
+    if (client->thread_pool == NULL || client->state != HDNS_STATE_RUNNING) {
+        return 0;
+    }
+    return hdns_config_get_prefetch_ratio(client->config);
+}
+
+static APR_INLINE bool mark_prefetch_entry(hdns_resv_resp_t *resp, float ratio) {
+    return resp != NULL
+           && hdns_cache_entry_need_prefetch(resp, ratio)
+           && hdns_cache_entry_try_mark_prefetch(resp);
+}
+
+static void unmark_prefetch_entries(hdns_prefetch_task_param_t *param) {
+    hdns_list_for_each_entry(cursor, param->entries) {
+        hdns_cache_entry_unmark_prefetch(cursor->data);
+    }
+}
+
+static hdns_prefetch_task_param_t *create_prefetch_task_param(hdns_client_t *client) {
+    hdns_pool_new(pool);
+    hdns_prefetch_task_param_t *param = hdns_pcalloc(pool, sizeof(hdns_prefetch_task_param_t));
+    param->pool = pool;
+    param->client = client;
+    param->entries = hdns_list_new(pool);
+    return param;
+}
+
+static void *APR_THREAD_FUNC hdns_prefetch_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    hdns_prefetch_task_param_t *param = data;
+    hdns_client_t *client = param->client;
+    hdns_status_t status = hdns_status_error(HDNS_RESOLVE_FAIL,
+                                             HDNS_RESOLVE_FAIL_CODE,
+                                             "client is not running",
+                                             NULL);
+    if (client->state == HDNS_STATE_RUNNING) {
+        status = param->resv_req != NULL
+                 ? hdns_fetch_resv_results(client, param->resv_req, client->cache)
+                 : hdns_batch_fetch_resv_results(client,
+                                                 param->hosts,
+                                                 param->query_type,
+                                                 param->client_ip,
+                                                 client->cache);
+    }
+    if (!hdns_status_is_ok(&status)) {
+        hdns_log_info("prefetch failed, error_msg:%s", status.error_msg);
+        unmark_prefetch_entries(param);
+    }
+    // 条目引用随pool一起释放
+    hdns_pool_destroy(param->pool);
+    return NULL;
+}
+
+static void submit_prefetch_task(hdns_prefetch_task_param_t *param) {
+    hdns_client_t *client = param->client;
+    bool submitted = apr_thread_pool_tasks_count(client->thread_pool) <= HDNS_PREFETCH_MAX_TASK_COUNT
+                     && apr_thread_pool_push(client->thread_pool, hdns_prefetch_task, param, 0, client) == APR_SUCCESS;
+    if (!submitted) {
+        hdns_log_debug("submit prefetch task failed, too many tasks or thread pool unavailable");
+        unmark_prefetch_entries(param);
+        hdns_pool_destroy(param->pool);
+    }
+}
+
+/*
+ * 命中的缓存条目即将过期时，向线程池提交一次后台刷新，当前请求直接使用缓存结果
+ */
+static void try_prefetch(hdns_client_t *client,
+                         const hdns_resv_req_t *resv_req,
+                         hdns_resv_resp_t *ipv4_resp,
+                         hdns_resv_resp_t *ipv6_resp) {
+    float ratio = get_prefetch_ratio(client);
+    if (ratio <= 0) {
+        return;
+    }
+    bool ipv4_prefetch = mark_prefetch_entry(ipv4_resp, ratio);
+    bool ipv6_prefetch = mark_prefetch_entry(ipv6_resp, ratio);
+    int32_t query_type = merge_query_type(ipv4_prefetch, ipv6_prefetch);
+    if (query_type < 0) {
+        return;
+    }
+    hdns_prefetch_task_param_t *param = create_prefetch_task_param(client);
+    if (ipv4_prefetch) {
+        hdns_list_add(param->entries, ipv4_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+    if (ipv6_prefetch) {
+        hdns_list_add(param->entries, ipv6_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+    param->resv_req = hdns_resv_req_clone(param->pool, resv_req);
+    param->resv_req->query_type = query_type;
+    submit_prefetch_task(param);
+}
+
+/*
+ * 批量解析时按查询类型归并需要预取的域名，解析结束后每种类型只提交一个批量刷新任务
+ */
+static void collect_batch_prefetch(hdns_client_t *client,
+                                   hdns_prefetch_task_param_t **params,
+                                   float ratio,
+                                   const char *host,
+                                   const char *client_ip,
+                                   hdns_resv_resp_t *ipv4_resp,
+                                   hdns_resv_resp_t *ipv6_resp) {
+    if (ratio <= 0) {
+        return;
+    }
+    bool ipv4_prefetch = mark_prefetch_entry(ipv4_resp, ratio);
+    bool ipv6_prefetch = mark_prefetch_entry(ipv6_resp, ratio);
+    int32_t query_type = merge_query_type(ipv4_prefetch, ipv6_prefetch);
+    if (query_type < 0) {
+        return;
+    }
+    hdns_prefetch_task_param_t *param = params[query_type];
+    if (NULL == param) {
+        param = create_prefetch_task_param(client);
+        param->hosts = hdns_list_new(param->pool);
+        param->query_type = query_type;
+        param->client_ip = hdns_str_is_not_blank(client_ip) ? apr_pstrdup(param->pool, client_ip) : NULL;
+        params[query_type] = param;
+    }
+    hdns_list_add(param->hosts, host, hdns_to_list_clone_fn_t(apr_pstrdup));
+    if (ipv4_prefetch) {
+        hdns_list_add(param->entries, ipv4_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+    if (ipv6_prefetch) {
+        hdns_list_add(param->entries, ipv6_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+}
+
+/*
+ * 按查询类型查找缓存，HDNS_QUERY_BOTH时一次查找同时取出A和AAAA；
+ * 开启线程本地缓存时条目由本地缓存持有，返回true，此时不能释放，统一通过release_cache_entries处理
+ */
+static bool lookup_cache_entries(hdns_cache_t *cache,
+                                 const char *cache_key,
+                                 hdns_query_type_t query_type,
+                                 hdns_resv_resp_t **ipv4_resp,
+                                 hdns_resv_resp_t **ipv6_resp) {
+    *ipv4_resp = NULL;
+    *ipv6_resp = NULL;
+    if (hdns_cache_table_get_both_local(cache, cache_key, ipv4_resp, ipv6_resp)) {
+        if (!is_query_match(query_type, HDNS_RR_TYPE_A)) {
+            *ipv4_resp = NULL;
+        }
+        if (!is_query_match(query_type, HDNS_RR_TYPE_AAAA)) {
+            *ipv6_resp = NULL;
+        }
+        return true;
+    }
+    switch (query_type) {
+        case HDNS_QUERY_BOTH:
+            hdns_cache_table_get_both(cache, cache_key, ipv4_resp, ipv6_resp);
+            break;
+        case HDNS_QUERY_IPV4:
+            *ipv4_resp = hdns_cache_table_get(cache, cache_key, HDNS_RR_TYPE_A);
+            break;
+        case HDNS_QUERY_IPV6:
+            *ipv6_resp = hdns_cache_table_get(cache, cache_key, HDNS_RR_TYPE_AAAA);
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+static void release_cache_entries(hdns_resv_resp_t *ipv4_resp, hdns_resv_resp_t *ipv6_resp, bool borrowed) {
+    if (!borrowed) {
+        hdns_resv_resp_destroy(ipv4_resp);
+        hdns_resv_resp_destroy(ipv6_resp);
+    }
+}
+
+/*
+ * 批量解析时一次取出所有域名的缓存条目，每个分段只加一次锁；
+ * 第i个域名的A和AAAA条目分别位于下标2*i和2*i+1，通过release_cache_entries_batch释放；
+ * record_access为true时计入访问频次，同一次调用中重复查找时只需记录一次
+ */
+static hdns_resv_resp_t **lookup_cache_entries_batch(hdns_pool_t *pool,
+                                                     hdns_cache_t *cache,
+                                                     const hdns_list_head_t *hosts,
+                                                     hdns_query_type_t query_type,
+                                                     const char *subnet_suffix,
+                                                     bool record_access,
+                                                     size_t *count) {
+    *count = hdns_list_size(hosts);
+    const char **keys = hdns_palloc(pool, (*count + 1) * sizeof(char *));
+    hdns_resv_resp_t **entries = hdns_palloc(pool, (*count + 1) * HDNS_CACHE_FAMILY_COUNT * sizeof(hdns_resv_resp_t *));
+    size_t index = 0;
+    hdns_list_for_each_entry(cursor, hosts) {
+        keys[index] = append_subnet_suffix(pool, cursor->data, subnet_suffix);
+        if (record_access) {
+            hdns_cache_table_record_access(cache, keys[index]);
+        }
+        index++;
+    }
+    hdns_cache_table_get_batch(cache,
+                               keys,
+                               *count,
+                               is_query_match(query_type, HDNS_RR_TYPE_A),
+                               is_query_match(query_type, HDNS_RR_TYPE_AAAA),
+                               entries);
+    return entries;
+}
+
+static void release_cache_entries_batch(hdns_resv_resp_t **entries, size_t count) {
+    for (size_t i = 0; i < count * HDNS_CACHE_FAMILY_COUNT; i++) {
+        hdns_resv_resp_destroy(entries[i]);
+    }
+}
+
+static int collect_resv_resp_or_localdns(hdns_resv_resp_t *cache_resp,
+                                         const char *host,
+                                         bool enable_expired_ip,
+                                         bool enable_failover_localdns,
+                                         hdns_list_head_t *results,
+                                         hdns_query_type_t query_type,
+                                         hdns_rr_type_t rr_type) {
     if (!is_query_match(query_type, rr_type)) {
         return HDNS_OK;
     }
     /*
-     *  注意：结果统一在results->pool上
+     *  注意：结果统一在results->pool上，命中的缓存条目以共享引用挂在results->pool上，随results一起释放
      */
-    int ret = HDNS_ERROR;
-    hdns_resv_resp_t *cache_resp = hdns_cache_table_get(cache, cache_key, rr_type);
-    if (cache_resp != NULL && (!hdns_cache_entry_is_expired(cache_resp) || enable_expired_ip)) {
-        hdns_list_add(results, cache_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_clone));
-        ret = HDNS_OK;
-        goto cleanup;
+    // 负缓存命中时，开启了降级则仍然尝试localdns
+    bool negative_hit = cache_resp != NULL && hdns_cache_entry_is_negative(cache_resp);
+    if (cache_resp != NULL
+        && (!hdns_cache_entry_is_expired(cache_resp) || enable_expired_ip)
+        && !(negative_hit && enable_failover_localdns)) {
+        hdns_list_add(results, cache_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+        return HDNS_OK;
     }
     if (enable_failover_localdns) {
         hdns_resv_resp_t *localdns_resp = hdns_localdns_resolve(results->pool, host, rr_type);
         hdns_list_add(results, localdns_resp, NULL);
-        ret = HDNS_OK;
-        goto cleanup;
+        return HDNS_OK;
     }
     hdns_resv_resp_t *empty_resp = hdns_resv_resp_create_empty(results->pool, host, rr_type);
     hdns_list_add(results, empty_resp, NULL);
-    cleanup:
-    hdns_resv_resp_destroy(cache_resp);
-    return ret;
+    return HDNS_ERROR;
+}
+
+static int collect_resv_resps_in_cache_or_localdns(hdns_cache_t *cache,
+                                                   const char *host,
+                                                   const char *cache_key,
+                                                   bool enable_expired_ip,
+                                                   bool enable_failover_localdns,
+                                                   hdns_list_head_t *results,
+                                                   hdns_query_type_t query_type) {
+    hdns_resv_resp_t *ipv4_resp = NULL;
+    hdns_resv_resp_t *ipv6_resp = NULL;
+    bool borrowed = lookup_cache_entries(cache, cache_key, query_type, &ipv4_resp, &ipv6_resp);
+    int ipv4_collect_status = collect_resv_resp_or_localdns(ipv4_resp,
+                                                            host,
+                                                            enable_expired_ip,
+                                                            enable_failover_localdns,
+                                                            results,
+                                                            query_type,
+                                                            HDNS_RR_TYPE_A);
+    int ipv6_collect_status = collect_resv_resp_or_localdns(ipv6_resp,
+                                                            host,
+                                                            enable_expired_ip,
+                                                            enable_failover_localdns,
+                                                            results,
+                                                            query_type,
+                                                            HDNS_RR_TYPE_AAAA);
+    release_cache_entries(ipv4_resp, ipv6_resp, borrowed);
+    return (ipv4_collect_status == HDNS_OK && ipv6_collect_status == HDNS_OK) ? HDNS_OK : HDNS_ERROR;
+}
+
+/*
+ * IP字面量无需解析，直接按查询类型构造结果，类型不匹配时为空结果
+ */
+static void collect_ip_literal(const char *host, hdns_query_type_t query_type, hdns_list_head_t *results) {
+    hdns_rr_type_t literal_type = hdns_is_valid_ipv4(host) ? HDNS_RR_TYPE_A : HDNS_RR_TYPE_AAAA;
+    const hdns_rr_type_t rr_types[] = {HDNS_RR_TYPE_A, HDNS_RR_TYPE_AAAA};
+    for (int i = 0; i < 2; i++) {
+        if (!is_query_match(query_type, rr_types[i])) {
+            continue;
+        }
+        hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(results->pool, host, rr_types[i]);
+        if (rr_types[i] == literal_type) {
+            hdns_list_add(resp->ips, host, hdns_to_list_clone_fn_t(apr_pstrdup));
+        }
+        hdns_list_add(results, resp, NULL);
+    }
+}
+
+/*
+ * 过滤掉IP字面量，只有域名需要查询缓存或请求服务端
+ */
+static hdns_list_head_t *filter_domain_hosts(hdns_pool_t *pool, const hdns_list_head_t *hosts) {
+    hdns_list_head_t *domain_hosts = hdns_list_new(pool);
+    hdns_list_for_each_entry(cursor, hosts) {
+        if (!hdns_is_ip_literal(cursor->data)) {
+            hdns_list_add(domain_hosts, cursor->data, NULL);
+        }
+    }
+    return domain_hosts;
+}
+
+static hdns_resv_req_t *create_single_resv_req(hdns_client_t *client,
+                                              const char *host,
+                                              hdns_query_type_t query_type,
+                                              bool using_cache,
+                                              const char *client_ip) {
+    hdns_resv_req_t *resv_req = hdns_resv_req_new(NULL, client->config);
+    resv_req->host = apr_pstrdup(resv_req->pool, host);
+    resv_req->query_type = query_type;
+    if (hdns_str_is_not_blank(client_ip)) {
+        resv_req->client_ip = apr_pstrdup(resv_req->pool, client_ip);
+    }
+    resv_req->using_cache = using_cache;
+    return resv_req;
 }
 
 hdns_status_t hdns_do_single_resolve(hdns_client_t *client,
@@ -92,136 +424,489 @@ hdns_status_t hdns_do_single_resolve(hdns_client_t *client,
                                      const bool using_cache,
                                      const char *client_ip,
                                      hdns_list_head_t *results) {
-    hdns_pool_new(req_pool);
-    hdns_resv_req_t *resv_req = hdns_resv_req_new(NULL, client->config);
-    resv_req->query_type = query_type;
-    resv_req->host = apr_pstrdup(req_pool, host);
-    resv_req->query_type = query_type;
-    if (hdns_str_is_not_blank(client_ip)) {
-        resv_req->client_ip = apr_pstrdup(req_pool, client_ip);
-    }
-    resv_req->using_cache = using_cache;
+    hdns_resv_req_t *resv_req = create_single_resv_req(client, host, query_type, using_cache, client_ip);
     hdns_status_t status = hdns_do_single_resolve_with_req(client, resv_req, results);
     hdns_resv_req_free(resv_req);
-    hdns_pool_destroy(req_pool);
     return status;
 }
 
-hdns_status_t hdns_do_single_resolve_with_req(hdns_client_t *client,
-                                              hdns_resv_req_t *resv_req,
-                                              hdns_list_head_t *results) {
-    hdns_status_t status = hdns_resv_req_valid(resv_req);
-    if (!hdns_status_is_ok(&status)) {
-        return status;
+/*
+ * 单域名解析的上下文；异步解析在等待合并的请求时，请求完成后以客户端为属主提交到线程池继续执行
+ */
+typedef struct {
+    hdns_pool_t *pool;
+    hdns_client_t *client;
+    hdns_resv_req_t *resv_req;
+    hdns_cache_t *cache;
+    char *cache_key;
+    bool enable_expired_ip;
+    bool enable_failover_localdns;
+    hdns_single_resv_done_fn_t done_fn;
+    void *done_param;
+} hdns_single_resv_ctx_t;
+
+/*
+ * 校验请求并处理无需查询的情况，返回false表示已得到最终结果
+ */
+static bool prepare_single_resolve(hdns_client_t *client,
+                                   hdns_resv_req_t *resv_req,
+                                   hdns_list_head_t *results,
+                                   hdns_status_t *status) {
+    *status = hdns_resv_req_valid(resv_req);
+    if (!hdns_status_is_ok(status)) {
+        return false;
     }
-    hdns_cache_t *cache = NULL;
-    hdns_pool_new(req_pool);
     if (resv_req->query_type == HDNS_QUERY_AUTO) {
         resv_req->query_type = unwrap_auto_query_type(client->net_detector);
     }
-    char *cache_key = hdns_str_is_not_blank(resv_req->cache_key) ? resv_req->cache_key : resv_req->host;
-    apr_thread_mutex_lock(client->config->lock);
-    bool enable_failover_localdns = client->config->enable_failover_localdns;
-    bool enable_expired_ip = client->config->enable_expired_ip;
-    apr_thread_mutex_unlock(client->config->lock);
-    if (resv_req->using_cache) {
-        cache = client->cache;
-        int32_t query_type_for_server = -1;
-        switch (resv_req->query_type) {
-            case HDNS_QUERY_BOTH: {
-                hdns_resv_resp_t *ipv4_resp = hdns_cache_table_get(client->cache, cache_key, HDNS_RR_TYPE_A);
-                hdns_resv_resp_t *ipv6_resp = hdns_cache_table_get(client->cache, cache_key, HDNS_RR_TYPE_AAAA);
-                bool v4Invalid = ipv4_resp == NULL || hdns_cache_entry_is_expired(ipv4_resp);
-                bool v6Invalid = ipv6_resp == NULL || hdns_cache_entry_is_expired(ipv6_resp);
-                if (v4Invalid && v6Invalid) {
-                    query_type_for_server = HDNS_QUERY_BOTH;
-                } else if (v6Invalid) {
-                    query_type_for_server = HDNS_QUERY_IPV6;
-                } else if (v4Invalid) {
-                    query_type_for_server = HDNS_QUERY_IPV4;
-                }
-                hdns_resv_resp_destroy(ipv4_resp);
-                hdns_resv_resp_destroy(ipv6_resp);
-                break;
-            }
-            case HDNS_QUERY_IPV4: {
-                hdns_resv_resp_t *resp = hdns_cache_table_get(client->cache, cache_key, HDNS_RR_TYPE_A);
-                bool invalid = resp == NULL || hdns_cache_entry_is_expired(resp);
-                if (invalid) {
-                    query_type_for_server = HDNS_QUERY_IPV4;
-                }
-                hdns_resv_resp_destroy(resp);
-                break;
+    if (hdns_is_ip_literal(resv_req->host)) {
+        collect_ip_literal(resv_req->host, resv_req->query_type, results);
+        *status = hdns_status_ok(client->config->session_id);
+        return false;
+    }
+    if (hdns_str_is_blank(resv_req->cache_key)) {
+        // SDNS参数会改变解析结果，未指定cache_key时按参数派生，避免与普通解析共用条目
+        resv_req->cache_key = hdns_resv_req_sdns_cache_key(resv_req->pool, resv_req);
+    }
+    return true;
+}
+
+static void init_single_resv_ctx(hdns_single_resv_ctx_t *ctx,
+                                 hdns_pool_t *pool,
+                                 hdns_client_t *client,
+                                 hdns_resv_req_t *resv_req) {
+    ctx->pool = pool;
+    ctx->client = client;
+    ctx->resv_req = resv_req;
+    ctx->cache = NULL;
+    ctx->cache_key = append_subnet_suffix(pool,
+                                          hdns_str_is_not_blank(resv_req->cache_key) ? resv_req->cache_key : resv_req->host,
+                                          get_client_subnet_suffix(pool, client, resv_req->client_ip));
+    apr_uint32_t options = hdns_config_get_resolve_options(client->config);
+    ctx->enable_failover_localdns = (options & HDNS_CONFIG_OPT_FAILOVER_LOCALDNS) != 0;
+    ctx->enable_expired_ip = (options & HDNS_CONFIG_OPT_EXPIRED_IP) != 0;
+}
+
+static APR_INLINE bool is_local_hit(hdns_resv_resp_t *resp, bool wanted, bool enable_failover_localdns) {
+    return !wanted
+           || (resp != NULL
+               && !hdns_cache_entry_is_expired(resp)
+               && !(enable_failover_localdns && hdns_cache_entry_is_negative(resp)));
+}
+
+/*
+ * 线程本地缓存命中且所需条目均未过期时直接收集结果，不加锁、不创建pool，访问频次由本地缓存按采样记录；
+ * 未命中时返回false，走完整流程
+ */
+static bool resolve_from_local_cache(hdns_client_t *client, hdns_resv_req_t *resv_req, hdns_list_head_t *results) {
+    if (!resv_req->using_cache) {
+        return false;
+    }
+    apr_uint32_t options = hdns_config_get_resolve_options(client->config);
+    // 按子网分区时缓存键需要拼接子网后缀
+    if ((options & HDNS_CONFIG_OPT_CLIENT_SUBNET) && hdns_str_is_not_blank(resv_req->client_ip)) {
+        return false;
+    }
+    const char *cache_key = hdns_str_is_not_blank(resv_req->cache_key) ? resv_req->cache_key : resv_req->host;
+    hdns_resv_resp_t *ipv4_resp = NULL;
+    hdns_resv_resp_t *ipv6_resp = NULL;
+    if (!hdns_cache_table_get_both_local(client->cache, cache_key, &ipv4_resp, &ipv6_resp)) {
+        return false;
+    }
+    bool enable_failover_localdns = (options & HDNS_CONFIG_OPT_FAILOVER_LOCALDNS) != 0;
+    bool want_ipv4 = is_query_match(resv_req->query_type, HDNS_RR_TYPE_A);
+    bool want_ipv6 = is_query_match(resv_req->query_type, HDNS_RR_TYPE_AAAA);
+    if (!is_local_hit(ipv4_resp, want_ipv4, enable_failover_localdns)
+        || !is_local_hit(ipv6_resp, want_ipv6, enable_failover_localdns)) {
+        return false;
+    }
+    ipv4_resp = want_ipv4 ? ipv4_resp : NULL;
+    ipv6_resp = want_ipv6 ? ipv6_resp : NULL;
+    if (ipv4_resp != NULL) {
+        hdns_list_add(results, ipv4_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+    if (ipv6_resp != NULL) {
+        hdns_list_add(results, ipv6_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+    }
+    try_prefetch(client, resv_req, ipv4_resp, ipv6_resp);
+    return true;
+}
+
+/*
+ * 查询缓存，确定需要向服务端请求的类型，缓存有效时返回-1
+ */
+static int32_t lookup_single_resolve_cache(hdns_single_resv_ctx_t *ctx) {
+    hdns_client_t *client = ctx->client;
+    hdns_resv_req_t *resv_req = ctx->resv_req;
+    int32_t query_type_for_server = -1;
+    hdns_resv_resp_t *ipv4_resp = NULL;
+    hdns_resv_resp_t *ipv6_resp = NULL;
+    bool borrowed = lookup_cache_entries(ctx->cache, ctx->cache_key, resv_req->query_type, &ipv4_resp, &ipv6_resp);
+    switch (resv_req->query_type) {
+        case HDNS_QUERY_BOTH: {
+            bool v4Invalid = ipv4_resp == NULL || hdns_cache_entry_is_expired(ipv4_resp);
+            bool v6Invalid = ipv6_resp == NULL || hdns_cache_entry_is_expired(ipv6_resp);
+            if (v4Invalid && v6Invalid) {
+                query_type_for_server = HDNS_QUERY_BOTH;
+            } else if (v6Invalid) {
+                query_type_for_server = HDNS_QUERY_IPV6;
+            } else if (v4Invalid) {
+                query_type_for_server = HDNS_QUERY_IPV4;
             }
-            case HDNS_QUERY_IPV6: {
-                hdns_resv_resp_t *resp = hdns_cache_table_get(client->cache, cache_key, HDNS_RR_TYPE_AAAA);
-                bool invalid = resp == NULL || hdns_cache_entry_is_expired(resp);
-                if (invalid) {
-                    query_type_for_server = HDNS_QUERY_IPV6;
-                }
-                hdns_resv_resp_destroy(resp);
-                break;
+            try_prefetch(client, resv_req, v4Invalid ? NULL : ipv4_resp, v6Invalid ? NULL : ipv6_resp);
+            break;
+        }
+        case HDNS_QUERY_IPV4: {
+            bool invalid = ipv4_resp == NULL || hdns_cache_entry_is_expired(ipv4_resp);
+            if (invalid) {
+                query_type_for_server = HDNS_QUERY_IPV4;
+            } else {
+                try_prefetch(client, resv_req, ipv4_resp, NULL);
             }
-            default:
-                break;
+            break;
         }
-        if (query_type_for_server > 0) {
-            resv_req->query_type = query_type_for_server;
-            status = hdns_fetch_resv_results(client, resv_req, cache);
+        case HDNS_QUERY_IPV6: {
+            bool invalid = ipv6_resp == NULL || hdns_cache_entry_is_expired(ipv6_resp);
+            if (invalid) {
+                query_type_for_server = HDNS_QUERY_IPV6;
+            } else {
+                try_prefetch(client, resv_req, NULL, ipv6_resp);
+            }
+            break;
         }
-    } else {
-        cache = hdns_cache_table_create();
-        status = hdns_fetch_resv_results(client, resv_req, cache);
+        default:
+            break;
     }
+    release_cache_entries(ipv4_resp, ipv6_resp, borrowed);
+    return query_type_for_server;
+}
 
-    if (!hdns_status_is_ok(&status) && !enable_failover_localdns && !enable_expired_ip) {
-        goto cleanup;
+/*
+ * 查询缓存并在未命中时请求服务端，相同缓存键和查询类型的并发请求只由第一个调用方发起；
+ * 其余调用方通过flight返回，由调用方等待或挂载回调
+ */
+static hdns_status_t fetch_single_resolve(hdns_single_resv_ctx_t *ctx, hdns_flight_t **flight) {
+    hdns_client_t *client = ctx->client;
+    hdns_resv_req_t *resv_req = ctx->resv_req;
+    *flight = NULL;
+    if (!resv_req->using_cache) {
+        ctx->cache = hdns_cache_table_create_scratch();
+        return hdns_fetch_resv_results(client, resv_req, ctx->cache);
     }
-    int ipv4_collect_status = collect_resv_resp_in_cache_or_localdns(cache,
-                                                                     resv_req->host,
-                                                                     cache_key,
-                                                                     enable_expired_ip,
-                                                                     enable_failover_localdns,
-                                                                     results,
-                                                                     resv_req->query_type,
-                                                                     HDNS_RR_TYPE_A);
-    int ipv6_collect_status = collect_resv_resp_in_cache_or_localdns(cache,
+    ctx->cache = client->cache;
+    hdns_cache_table_record_access(ctx->cache, ctx->cache_key);
+    int32_t query_type_for_server = lookup_single_resolve_cache(ctx);
+    if (query_type_for_server < 0) {
+        return hdns_status_ok(client->config->session_id);
+    }
+    resv_req->query_type = query_type_for_server;
+    char *flight_key = apr_psprintf(ctx->pool, "%s|%d", ctx->cache_key, query_type_for_server);
+    if (!hdns_flight_join(client->flights, flight_key, flight)) {
+        return hdns_status_ok(client->config->session_id);
+    }
+    hdns_status_t status = hdns_fetch_resv_results(client, resv_req, ctx->cache);
+    hdns_flight_finish(client->flights, *flight, &status);
+    *flight = NULL;
+    return status;
+}
+
+static hdns_status_t collect_single_resolve(hdns_single_resv_ctx_t *ctx, hdns_status_t status, hdns_list_head_t *results) {
+    hdns_resv_req_t *resv_req = ctx->resv_req;
+    if (hdns_status_is_ok(&status) || ctx->enable_failover_localdns || ctx->enable_expired_ip) {
+        int collect_status = collect_resv_resps_in_cache_or_localdns(ctx->cache,
                                                                      resv_req->host,
-                                                                     cache_key,
-                                                                     enable_expired_ip,
-                                                                     enable_failover_localdns,
+                                                                     ctx->cache_key,
+                                                                     ctx->enable_expired_ip,
+                                                                     ctx->enable_failover_localdns,
                                                                      results,
-                                                                     resv_req->query_type,
-                                                                     HDNS_RR_TYPE_AAAA);
-
-    if (ipv4_collect_status == HDNS_OK && ipv6_collect_status == HDNS_OK) {
-        status = hdns_status_ok(client->config->session_id);
+                                                                     resv_req->query_type);
+        if (collect_status == HDNS_OK) {
+            status = hdns_status_ok(ctx->client->config->session_id);
+        }
     }
-    cleanup:
     if (!resv_req->using_cache) {
-        hdns_cache_table_cleanup(cache);
+        hdns_cache_table_cleanup(ctx->cache);
     }
+    return status;
+}
+
+/*
+ * 等待方的超时时间与单次请求一致
+ */
+static APR_INLINE apr_interval_time_t get_flight_wait_timeout(const hdns_resv_req_t *resv_req) {
+    return (apr_interval_time_t) resv_req->timeout_ms * 1000 * (resv_req->retry_times + 1);
+}
+
+hdns_status_t hdns_do_single_resolve_with_req(hdns_client_t *client,
+                                              hdns_resv_req_t *resv_req,
+                                              hdns_list_head_t *results) {
+    hdns_status_t status;
+    if (!prepare_single_resolve(client, resv_req, results, &status)) {
+        return status;
+    }
+    if (resolve_from_local_cache(client, resv_req, results)) {
+        return hdns_status_ok(client->config->session_id);
+    }
+    hdns_pool_new(req_pool);
+    hdns_single_resv_ctx_t ctx;
+    init_single_resv_ctx(&ctx, req_pool, client, resv_req);
+    hdns_flight_t *flight = NULL;
+    status = fetch_single_resolve(&ctx, &flight);
+    if (flight != NULL) {
+        status = hdns_flight_wait(client->flights, flight, get_flight_wait_timeout(resv_req));
+    }
+    status = collect_single_resolve(&ctx, status, results);
     hdns_pool_destroy(req_pool);
     return status;
 }
 
-static hdns_status_t hdns_update_cache_on_net_change_with_type(hdns_net_chg_cb_task_t *task, hdns_rr_type_t rr_type) {
-    hdns_client_t *client = task->param;
+static void complete_single_resolve_async(hdns_single_resv_ctx_t *ctx, hdns_status_t status) {
+    hdns_list_head_t *results = hdns_list_new(NULL);
+    status = collect_single_resolve(ctx, status, results);
+    ctx->done_fn(&status, results, ctx->done_param);
+    hdns_list_free(results);
+    hdns_resv_req_free(ctx->resv_req);
+    hdns_pool_destroy(ctx->pool);
+}
+
+static void on_single_resolve_flight_done(hdns_status_t *status, void *param) {
+    complete_single_resolve_async(param, *status);
+}
+
+hdns_status_t hdns_do_single_resolve_with_req_async(hdns_client_t *client,
+                                                    const hdns_resv_req_t *req,
+                                                    hdns_single_resv_done_fn_t done_fn,
+                                                    void *done_param) {
+    hdns_pool_new(pool);
+    hdns_single_resv_ctx_t *ctx = hdns_palloc(pool, sizeof(hdns_single_resv_ctx_t));
+    hdns_resv_req_t *resv_req = hdns_resv_req_clone(NULL, req);
     hdns_status_t status;
-    apr_time_t start = apr_time_now();
+    hdns_list_head_t *results = hdns_list_new(pool);
+    bool resolved = !prepare_single_resolve(client, resv_req, results, &status);
+    if (!resolved && resolve_from_local_cache(client, resv_req, results)) {
+        status = hdns_status_ok(client->config->session_id);
+        resolved = true;
+    }
+    if (resolved) {
+        done_fn(&status, results, done_param);
+        hdns_resv_req_free(resv_req);
+        hdns_pool_destroy(pool);
+        return status;
+    }
+    init_single_resv_ctx(ctx, pool, client, resv_req);
+    ctx->done_fn = done_fn;
+    ctx->done_param = done_param;
+    hdns_flight_t *flight = NULL;
+    status = fetch_single_resolve(ctx, &flight);
+    // 挂载成功时当前线程直接返回，不占用线程等待
+    if (flight != NULL && hdns_flight_attach(client->flights, flight, on_single_resolve_flight_done, ctx, client, &status)) {
+        return hdns_status_ok(client->config->session_id);
+    }
+    complete_single_resolve_async(ctx, status);
+    return hdns_status_ok(client->config->session_id);
+}
+
+hdns_status_t hdns_do_single_resolve_async(hdns_client_t *client,
+                                           const char *host,
+                                           hdns_query_type_t query_type,
+                                           bool using_cache,
+                                           const char *client_ip,
+                                           hdns_single_resv_done_fn_t done_fn,
+                                           void *done_param) {
+    hdns_resv_req_t *resv_req = create_single_resv_req(client, host, query_type, using_cache, client_ip);
+    hdns_status_t status = hdns_do_single_resolve_with_req_async(client, resv_req, done_fn, done_param);
+    hdns_resv_req_free(resv_req);
+    return status;
+}
+
+/*
+ * 按子网分区的条目与本机网络无关，SDNS条目的键不是域名，都不参与热点刷新和网络切换刷新
+ */
+static APR_INLINE bool is_plain_host_key(const char *key) {
+    return strstr(key, HDNS_CLIENT_SUBNET_SEPARATOR) == NULL
+           && strstr(key, HDNS_SDNS_CACHE_KEY_SEPARATOR) == NULL;
+}
+
+/*
+ * 取访问频次最高的limit个域名，元素为缓存键
+ */
+static hdns_list_head_t *get_hot_hosts(hdns_pool_t *pool, hdns_cache_t *cache, int32_t limit) {
+    hdns_list_head_t *hosts = hdns_list_new(pool);
+    hdns_list_head_t *hot_keys = hdns_cache_table_get_hot_keys(cache);
+    hdns_list_for_each_entry(cursor, hot_keys) {
+        if (hdns_list_size(hosts) >= (size_t) limit) {
+            break;
+        }
+        hdns_sketch_hot_item_t *item = cursor->data;
+        if (is_plain_host_key(item->key)) {
+            hdns_list_add(hosts, item->key, hdns_to_list_clone_fn_t(apr_pstrdup));
+        }
+    }
+    hdns_list_free(hot_keys);
+    return hosts;
+}
+
+/*
+ * 热点条目已过期或剩余TTL不足两个刷新间隔时需要刷新，与命中预取共用标记，避免重复请求
+ */
+static bool mark_hot_entry(hdns_resv_resp_t *entry) {
+    if (NULL == entry || hdns_cache_entry_is_negative(entry)) {
+        return false;
+    }
+    int64_t ttl = entry->origin_ttl > 0 ? entry->origin_ttl : entry->ttl;
+    apr_time_t refresh_time = entry->query_time
+                              + (ttl - 2 * HDNS_HOT_HOST_REFRESH_INTERVAL_SEC) * APR_USEC_PER_SEC;
+    return refresh_time <= hdns_clock_now() && hdns_cache_entry_try_mark_prefetch(entry);
+}
+
+static void refresh_hot_hosts(hdns_client_t *client, int32_t limit) {
+    hdns_pool_new(pool);
+    hdns_list_head_t *hosts[HDNS_QUERY_BOTH + 1] = {NULL};
+    hdns_list_head_t *entries = hdns_list_new(pool);
+    hdns_list_head_t *hot_hosts = get_hot_hosts(pool, client->cache, limit);
+    hdns_list_for_each_entry(cursor, hot_hosts) {
+        hdns_resv_resp_t *ipv4_resp = NULL;
+        hdns_resv_resp_t *ipv6_resp = NULL;
+        hdns_cache_table_get_both(client->cache, cursor->data, &ipv4_resp, &ipv6_resp);
+        bool ipv4_refresh = mark_hot_entry(ipv4_resp);
+        bool ipv6_refresh = mark_hot_entry(ipv6_resp);
+        int32_t query_type = merge_query_type(ipv4_refresh, ipv6_refresh);
+        if (query_type > 0) {
+            if (NULL == hosts[query_type]) {
+                hosts[query_type] = hdns_list_new(pool);
+            }
+            hdns_list_add(hosts[query_type], cursor->data, NULL);
+        }
+        if (ipv4_refresh) {
+            hdns_list_add(entries, ipv4_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+        }
+        if (ipv6_refresh) {
+            hdns_list_add(entries, ipv6_resp, hdns_to_list_clone_fn_t(hdns_resv_resp_share));
+        }
+        hdns_resv_resp_destroy(ipv4_resp);
+        hdns_resv_resp_destroy(ipv6_resp);
+    }
+    for (int32_t query_type = HDNS_QUERY_IPV4; query_type <= HDNS_QUERY_BOTH; query_type++) {
+        if (hosts[query_type] != NULL && client->state == HDNS_STATE_RUNNING) {
+            hdns_status_t status = hdns_batch_fetch_resv_results(client, hosts[query_type], query_type, NULL, client->cache);
+            if (!hdns_status_is_ok(&status)) {
+                hdns_log_info("refresh hot hosts failed, error_msg:%s", status.error_msg);
+            }
+        }
+    }
+    // 刷新成功的条目已被替换，失败的条目清除标记以便下次重试
+    hdns_list_for_each_entry(cursor, entries) {
+        hdns_cache_entry_unmark_prefetch(cursor->data);
+    }
+    hdns_pool_destroy(pool);
+}
+
+static void *APR_THREAD_FUNC hdns_hot_host_refresh_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    hdns_client_t *client = data;
+    if (client->state != HDNS_STATE_RUNNING) {
+        return NULL;
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    int32_t hot_host_count = client->config->hot_host_refresh_count;
+    apr_thread_mutex_unlock(client->config->lock);
+    hdns_cache_table_decay_access(client->cache);
+    if (hot_host_count > 0) {
+        refresh_hot_hosts(client, hot_host_count);
+    }
+    if (client->state == HDNS_STATE_RUNNING) {
+        apr_thread_pool_schedule(client->thread_pool,
+                                 hdns_hot_host_refresh_task,
+                                 client,
+                                 apr_time_from_sec(HDNS_HOT_HOST_REFRESH_INTERVAL_SEC),
+                                 client);
+    }
+    return NULL;
+}
+
+hdns_status_t hdns_client_start_hot_host_refresh(hdns_client_t *client) {
+    apr_status_t status = apr_thread_pool_schedule(client->thread_pool,
+                                                   hdns_hot_host_refresh_task,
+                                                   client,
+                                                   apr_time_from_sec(HDNS_HOT_HOST_REFRESH_INTERVAL_SEC),
+                                                   client);
+    if (status != APR_SUCCESS) {
+        return hdns_status_error(HDNS_RESOLVE_FAIL, HDNS_RESOLVE_FAIL_CODE, "Submit task failed",
+                                 client->config->session_id);
+    }
+    return hdns_status_ok(client->config->session_id);
+}
+
+/*
+ * 网络切换后优先刷新存在rr_type条目的热点域名，刷新过的域名记录在refreshed中，后续分批刷新时跳过
+ */
+static hdns_status_t refresh_hot_hosts_on_net_change(hdns_net_chg_cb_task_t *task,
+                                                     hdns_rr_type_t rr_type,
+                                                     apr_time_t start,
+                                                     hdns_htable_t *refreshed) {
+    hdns_client_t *client = task->param;
+    hdns_status_t status = hdns_status_ok(client->config->session_id);
     hdns_query_type_t query_type = (rr_type == HDNS_RR_TYPE_A) ? HDNS_QUERY_IPV4 : HDNS_QUERY_IPV6;
-    hdns_list_head_t *hosts = hdns_cache_get_keys(client->cache, rr_type);
-    do {
+    hdns_list_head_t *hosts = get_hot_hosts(NULL, client->cache, HDNS_SKETCH_HOT_KEY_CAPACITY);
+    hdns_list_for_each_entry_safe(host_cursor, hosts) {
+        hdns_resv_resp_t *entry = hdns_cache_table_get(client->cache, host_cursor->data, rr_type);
+        if (NULL == entry) {
+            hdns_list_del(host_cursor);
+        } else {
+            hdns_htable_set(refreshed, apr_pstrdup(refreshed->pool, host_cursor->data), refreshed);
+        }
+        hdns_resv_resp_destroy(entry);
+    }
+    while (!hdns_list_is_empty(hosts)) {
         status = hdns_batch_fetch_resv_results(client, hosts, query_type, NULL, client->cache);
-        hdns_log_debug("status:%d %s %s", status.code, status.error_code, status.error_msg);
-    } while (!hdns_status_is_ok(&status)
-             // 网络切换之后，存在一段时间网络不可用，需要等待重试
-             && apr_time_sec(apr_time_now() - start) < 30
-             && !task->stop_signal);
+        if (hdns_status_is_ok(&status)
+            || apr_time_sec(hdns_clock_now() - start) >= 30
+            || task->stop_signal) {
+            break;
+        }
+    }
     hdns_list_free(hosts);
     return status;
 }
 
+static hdns_status_t hdns_update_cache_on_net_change_with_type(hdns_net_chg_cb_task_t *task, hdns_rr_type_t rr_type) {
+    hdns_client_t *client = task->param;
+    hdns_status_t status = hdns_status_ok(client->config->session_id);
+    apr_time_t start = hdns_clock_now();
+    hdns_query_type_t query_type = (rr_type == HDNS_RR_TYPE_A) ? HDNS_QUERY_IPV4 : HDNS_QUERY_IPV6;
+    hdns_pool_new(pool);
+    hdns_htable_t *refreshed = hdns_htable_make(pool);
+    status = refresh_hot_hosts_on_net_change(task, rr_type, start, refreshed);
+    hdns_cache_key_cursor_t cursor;
+    hdns_cache_key_cursor_init(&cursor, rr_type);
+    // 分批取键并刷新，避免一次性复制全部键时长时间持有缓存锁
+    while (hdns_status_is_ok(&status) && !cursor.finished && !task->stop_signal) {
+        hdns_list_head_t *hosts = hdns_list_new(NULL);
+        hdns_cache_key_cursor_next(client->cache, &cursor, HDNS_CACHE_KEY_CURSOR_CHUNK, hosts);
+        hdns_list_for_each_entry_safe(host_cursor, hosts) {
+            if (!is_plain_host_key(host_cursor->data) || hdns_htable_get(refreshed, host_cursor->data) != NULL) {
+                hdns_list_del(host_cursor);
+            }
+        }
+        while (!hdns_list_is_empty(hosts)) {
+            status = hdns_batch_fetch_resv_results(client, hosts, query_type, NULL, client->cache);
+            hdns_log_debug("status:%d %s %s", status.code, status.error_code, status.error_msg);
+            if (hdns_status_is_ok(&status)
+                // 网络切换之后，存在一段时间网络不可用，需要等待重试
+                || apr_time_sec(hdns_clock_now() - start) >= 30
+                || task->stop_signal) {
+                break;
+            }
+        }
+        hdns_list_free(hosts);
+        if (!hdns_status_is_ok(&status)) {
+            break;
+        }
+    }
+    hdns_pool_destroy(pool);
+    return status;
+}
+
 
 void hdns_update_cache_on_net_change(hdns_net_chg_cb_task_t *task) {
     hdns_status_t status = hdns_update_cache_on_net_change_with_type(task, HDNS_RR_TYPE_A);
@@ -248,55 +933,53 @@ hdns_status_t hdns_do_batch_resolve(hdns_client_t *client,
     bool enable_failover_localdns = client->config->enable_failover_localdns;
     bool enable_expired_ip = client->config->enable_expired_ip;
     apr_thread_mutex_unlock(client->config->lock);
+    const hdns_list_head_t *domain_hosts = filter_domain_hosts(session_pool, hosts);
+    char *subnet_suffix = get_client_subnet_suffix(session_pool, client, client_ip);
 
     if (using_cache) {
         cache = client->cache;
         hdns_list_head_t *ipv4_hosts = hdns_list_new(session_pool);
         hdns_list_head_t *ipv6_hosts = hdns_list_new(session_pool);
         hdns_list_head_t *ipv46_hosts = hdns_list_new(session_pool);
+        float prefetch_ratio = get_prefetch_ratio(client);
+        hdns_prefetch_task_param_t *prefetch_params[HDNS_QUERY_BOTH + 1] = {NULL};
 
-        hdns_list_for_each_entry(host_cursor, hosts) {
-            switch (query_type) {
-                case HDNS_QUERY_BOTH: {
-                    hdns_resv_resp_t *ipv4_resp = hdns_cache_table_get(client->cache,
-                                                                       host_cursor->data,
-                                                                       HDNS_RR_TYPE_A);
-                    hdns_resv_resp_t *ipv6_resp = hdns_cache_table_get(client->cache,
-                                                                       host_cursor->data,
-                                                                       HDNS_RR_TYPE_AAAA);
-                    bool v4Invalid = ipv4_resp == NULL || hdns_cache_entry_is_expired(ipv4_resp);
-                    bool v6Invalid = ipv6_resp == NULL || hdns_cache_entry_is_expired(ipv6_resp);
-                    if (v4Invalid && v6Invalid) {
-                        hdns_list_add(ipv46_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
-                    } else if (v4Invalid) {
-                        hdns_list_add(ipv4_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
-                    } else if (v6Invalid) {
-                        hdns_list_add(ipv6_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
-                    }
-                    hdns_resv_resp_destroy(ipv4_resp);
-                    hdns_resv_resp_destroy(ipv6_resp);
-                    break;
-                }
-                case HDNS_QUERY_IPV4: {
-                    hdns_resv_resp_t *resp = hdns_cache_table_get(client->cache, host_cursor->data, HDNS_RR_TYPE_A);
-                    bool invalid = resp == NULL || hdns_cache_entry_is_expired(resp);
-                    if (invalid) {
-                        hdns_list_add(ipv4_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
-                    }
-                    hdns_resv_resp_destroy(resp);
-                    break;
-                }
-                case HDNS_QUERY_IPV6: {
-                    hdns_resv_resp_t *resp = hdns_cache_table_get(client->cache, host_cursor->data, HDNS_RR_TYPE_AAAA);
-                    bool invalid = resp == NULL || hdns_cache_entry_is_expired(resp);
-                    if (invalid) {
-                        hdns_list_add(ipv6_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
-                    }
-                    hdns_resv_resp_destroy(resp);
-                    break;
-                }
-                default:
-                    break;
+        size_t host_count = 0;
+        hdns_resv_resp_t **cache_resps = lookup_cache_entries_batch(session_pool,
+                                                                    cache,
+                                                                    domain_hosts,
+                                                                    query_type,
+                                                                    subnet_suffix,
+                                                                    true,
+                                                                    &host_count);
+        size_t index = 0;
+        hdns_list_for_each_entry(host_cursor, domain_hosts) {
+            hdns_resv_resp_t *ipv4_resp = cache_resps[index * HDNS_CACHE_FAMILY_COUNT];
+            hdns_resv_resp_t *ipv6_resp = cache_resps[index * HDNS_CACHE_FAMILY_COUNT + 1];
+            index++;
+            bool v4Invalid = is_query_match(query_type, HDNS_RR_TYPE_A)
+                             && (ipv4_resp == NULL || hdns_cache_entry_is_expired(ipv4_resp));
+            bool v6Invalid = is_query_match(query_type, HDNS_RR_TYPE_AAAA)
+                             && (ipv6_resp == NULL || hdns_cache_entry_is_expired(ipv6_resp));
+            if (v4Invalid && v6Invalid) {
+                hdns_list_add(ipv46_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
+            } else if (v4Invalid) {
+                hdns_list_add(ipv4_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
+            } else if (v6Invalid) {
+                hdns_list_add(ipv6_hosts, host_cursor->data, hdns_to_list_clone_fn_t(apr_pstrdup));
+            }
+            collect_batch_prefetch(client,
+                                   prefetch_params,
+                                   prefetch_ratio,
+                                   host_cursor->data,
+                                   client_ip,
+                                   v4Invalid ? NULL : ipv4_resp,
+                                   v6Invalid ? NULL : ipv6_resp);
+        }
+        release_cache_entries_batch(cache_resps, host_count);
+        for (int i = 0; i <= HDNS_QUERY_BOTH; i++) {
+            if (prefetch_params[i] != NULL) {
+                submit_prefetch_task(prefetch_params[i]);
             }
         }
         status = hdns_batch_fetch_resv_results(client,
@@ -324,37 +1007,49 @@ hdns_status_t hdns_do_batch_resolve(hdns_client_t *client,
             goto cleanup;
         }
     } else {
-        cache = hdns_cache_table_create();
-        status = hdns_batch_fetch_resv_results(client, hosts, query_type, client_ip, cache);
+        cache = hdns_cache_table_create_scratch();
+        status = hdns_batch_fetch_resv_results(client, domain_hosts, query_type, client_ip, cache);
         if (!hdns_status_is_ok(&status) && !enable_failover_localdns && !enable_expired_ip) {
             goto cleanup;
         }
     }
 
     bool success = true;
+    size_t host_count = 0;
+    hdns_resv_resp_t **cache_resps = lookup_cache_entries_batch(session_pool,
+                                                                cache,
+                                                                domain_hosts,
+                                                                query_type,
+                                                                subnet_suffix,
+                                                                false,
+                                                                &host_count);
+    size_t index = 0;
     hdns_list_for_each_entry(host_cursor, hosts) {
-        int ipv4_collect_status = collect_resv_resp_in_cache_or_localdns(cache,
-                                                                         host_cursor->data,
-                                                                         host_cursor->data,
-                                                                         enable_expired_ip,
-                                                                         enable_failover_localdns,
-                                                                         results,
-                                                                         query_type,
-                                                                         HDNS_RR_TYPE_A);
-        int ipv6_collect_status = collect_resv_resp_in_cache_or_localdns(cache,
-                                                                         host_cursor->data,
-                                                                         host_cursor->data,
-                                                                         enable_expired_ip,
-                                                                         enable_failover_localdns,
-                                                                         results,
-                                                                         query_type,
-                                                                         HDNS_RR_TYPE_AAAA);
-        success = success && (ipv4_collect_status == HDNS_OK);
-        success = success && (ipv6_collect_status == HDNS_OK);
+        if (hdns_is_ip_literal(host_cursor->data)) {
+            collect_ip_literal(host_cursor->data, query_type, results);
+            continue;
+        }
+        int ipv4_collect_status = collect_resv_resp_or_localdns(cache_resps[index * HDNS_CACHE_FAMILY_COUNT],
+                                                                host_cursor->data,
+                                                                enable_expired_ip,
+                                                                enable_failover_localdns,
+                                                                results,
+                                                                query_type,
+                                                                HDNS_RR_TYPE_A);
+        int ipv6_collect_status = collect_resv_resp_or_localdns(cache_resps[index * HDNS_CACHE_FAMILY_COUNT + 1],
+                                                                host_cursor->data,
+                                                                enable_expired_ip,
+                                                                enable_failover_localdns,
+                                                                results,
+                                                                query_type,
+                                                                HDNS_RR_TYPE_AAAA);
+        index++;
+        success = success && ipv4_collect_status == HDNS_OK && ipv6_collect_status == HDNS_OK;
         if (!success) {
             break;
         }
     }
+    release_cache_entries_batch(cache_resps, host_count);
     if (success) {
         status = hdns_status_ok(client->config->session_id);
     }
@@ -367,6 +1062,62 @@ hdns_status_t hdns_do_batch_resolve(hdns_client_t *client,
 }
 
 
+hdns_status_t hdns_do_batch_lookup_cache(hdns_client_t *client,
+                                         const hdns_list_head_t *hosts,
+                                         hdns_query_type_t query_type,
+                                         hdns_list_head_t *results) {
+    if (query_type == HDNS_QUERY_AUTO) {
+        query_type = unwrap_auto_query_type(client->net_detector);
+    }
+    apr_thread_mutex_lock(client->config->lock);
+    bool enable_expired_ip = client->config->enable_expired_ip;
+    apr_thread_mutex_unlock(client->config->lock);
+
+    hdns_pool_new(session_pool);
+    bool success = true;
+    size_t host_count = 0;
+    hdns_resv_resp_t **cache_resps = lookup_cache_entries_batch(session_pool,
+                                                                client->cache,
+                                                                filter_domain_hosts(session_pool, hosts),
+                                                                query_type,
+                                                                NULL,
+                                                                true,
+                                                                &host_count);
+    size_t index = 0;
+    hdns_list_for_each_entry(host_cursor, hosts) {
+        if (hdns_is_ip_literal(host_cursor->data)) {
+            collect_ip_literal(host_cursor->data, query_type, results);
+            continue;
+        }
+        // 只读缓存，未命中的域名返回空结果，不降级localdns
+        int ipv4_collect_status = collect_resv_resp_or_localdns(cache_resps[index * HDNS_CACHE_FAMILY_COUNT],
+                                                                host_cursor->data,
+                                                                enable_expired_ip,
+                                                                false,
+                                                                results,
+                                                                query_type,
+                                                                HDNS_RR_TYPE_A);
+        int ipv6_collect_status = collect_resv_resp_or_localdns(cache_resps[index * HDNS_CACHE_FAMILY_COUNT + 1],
+                                                                host_cursor->data,
+                                                                enable_expired_ip,
+                                                                false,
+                                                                results,
+                                                                query_type,
+                                                                HDNS_RR_TYPE_AAAA);
+        index++;
+        success = success && ipv4_collect_status == HDNS_OK && ipv6_collect_status == HDNS_OK;
+    }
+    release_cache_entries_batch(cache_resps, host_count);
+    hdns_pool_destroy(session_pool);
+    if (!success) {
+        return hdns_status_error(HDNS_RESOLVE_FAIL,
+                                 HDNS_RESOLVE_FAIL_CODE,
+                                 "some hosts are not in cache",
+                                 client->config->session_id);
+    }
+    return hdns_status_ok(client->config->session_id);
+}
+
 hdns_status_t hdns_batch_fetch_resv_results(hdns_client_t *client,
                                             const hdns_list_head_t *hosts,
                                             hdns_query_type_t query_type,
@@ -451,24 +1202,16 @@ void hdns_net_speed_cache_cb_fn(hdns_list_head_t *sorted_ips, void *user_params)
 
 
 static void hdns_apply_custom_ttl(hdns_client_t *client, hdns_resv_resp_t *resp) {
-    apr_thread_mutex_lock(client->config->lock);
-    int *ttl = apr_hash_get(client->config->custom_ttl_items,
-                            resp->host,
-                            APR_HASH_KEY_STRING);
-    apr_thread_mutex_unlock(client->config->lock);
-    if (ttl != NULL) {
-        resp->ttl = (*ttl);
-        resp->origin_ttl = (*ttl);
+    int32_t ttl;
+    if (hdns_host_rules_match(hdns_config_get_custom_ttl_rules(client->config), resp->host, &ttl)) {
+        resp->ttl = ttl;
+        resp->origin_ttl = ttl;
     }
 }
 
 static void hdns_probe_resv_resp_ips(hdns_client_t *client, hdns_resv_resp_t *resp) {
-    apr_thread_mutex_lock(client->config->lock);
-    int *port = apr_hash_get(client->config->ip_probe_items,
-                             resp->cache_key,
-                             APR_HASH_KEY_STRING);
-    apr_thread_mutex_unlock(client->config->lock);
-    if (port != NULL) {
+    int32_t port;
+    if (hdns_host_rules_match(hdns_config_get_ip_probe_rules(client->config), resp->host, &port)) {
         hdns_pool_new(pool);
         hdns_net_speed_cache_cb_fn_param_t *param = hdns_palloc(pool, sizeof(hdns_net_speed_cache_cb_fn_param_t));
         param->pool = pool;
@@ -478,12 +1221,82 @@ static void hdns_probe_resv_resp_ips(hdns_client_t *client, hdns_resv_resp_t *re
                                        hdns_net_speed_cache_cb_fn,
                                        param,
                                        resp->ips,
-                                       (*port),
+                                       port,
                                        client,
                                        &(client->state));
     }
 }
 
+static int32_t get_negative_ttl(hdns_client_t *client) {
+    apr_thread_mutex_lock(client->config->lock);
+    int32_t negative_ttl = client->config->negative_ttl;
+    apr_thread_mutex_unlock(client->config->lock);
+    return negative_ttl;
+}
+
+static bool contains_resv_resp(const hdns_list_head_t *resv_resps, const char *cache_key, hdns_rr_type_t type) {
+    hdns_list_for_each_entry(cursor, resv_resps) {
+        hdns_resv_resp_t *resp = cursor->data;
+        if (resp->type == type && hdns_str_is_not_blank(resp->cache_key) && strcmp(resp->cache_key, cache_key) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void add_negative_entry(hdns_pool_t *pool,
+                               const hdns_list_head_t *resv_resps,
+                               hdns_list_head_t *negative_resps,
+                               const char *host,
+                               const char *cache_key,
+                               hdns_rr_type_t type,
+                               int32_t negative_ttl) {
+    if (contains_resv_resp(resv_resps, cache_key, type)) {
+        return;
+    }
+    hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(pool, host, type);
+    resp->cache_key = apr_pstrdup(pool, cache_key);
+    resp->ttl = negative_ttl;
+    resp->origin_ttl = negative_ttl;
+    hdns_list_add(negative_resps, resp, NULL);
+}
+
+/*
+ * 服务端正常响应但未返回某个域名某种类型的记录时，写入空结果，避免在负缓存有效期内重复请求
+ */
+static void add_negative_entries(hdns_pool_t *pool,
+                                 const hdns_resv_req_t *resv_req,
+                                 const hdns_list_head_t *resv_resps,
+                                 hdns_cache_t *cache,
+                                 int32_t negative_ttl,
+                                 const char *subnet_suffix) {
+    if (negative_ttl <= 0) {
+        return;
+    }
+    bool ipv4 = is_query_match(resv_req->query_type, HDNS_RR_TYPE_A);
+    bool ipv6 = is_query_match(resv_req->query_type, HDNS_RR_TYPE_AAAA);
+    char *last = NULL;
+    // 批量解析的host为逗号分隔的域名列表，cache_key即域名本身
+    char *hosts = apr_pstrdup(pool, resv_req->host);
+    char *host = resv_req->using_multi ? apr_strtok(hosts, ",", &last) : hosts;
+    hdns_list_head_t *negative_resps = hdns_list_new(pool);
+    while (host != NULL) {
+        const char *cache_key = host;
+        if (!resv_req->using_multi && hdns_str_is_not_blank(resv_req->cache_key)) {
+            cache_key = resv_req->cache_key;
+        }
+        cache_key = append_subnet_suffix(pool, cache_key, subnet_suffix);
+        if (ipv4) {
+            add_negative_entry(pool, resv_resps, negative_resps, host, cache_key, HDNS_RR_TYPE_A, negative_ttl);
+        }
+        if (ipv6) {
+            add_negative_entry(pool, resv_resps, negative_resps, host, cache_key, HDNS_RR_TYPE_AAAA, negative_ttl);
+        }
+        host = resv_req->using_multi ? apr_strtok(NULL, ",", &last) : NULL;
+    }
+    hdns_cache_table_add_batch(cache, negative_resps);
+}
+
 hdns_status_t hdns_fetch_resv_results(hdns_client_t *client, hdns_resv_req_t *resv_req, hdns_cache_t *cache) {
     hdns_pool_new(req_pool);
     hdns_list_head_t *resv_resps = hdns_list_new(req_pool);
@@ -514,12 +1327,28 @@ hdns_status_t hdns_fetch_resv_results(hdns_client_t *client, hdns_resv_req_t *re
             continue;
         } else if (http_resp->status == HDNS_HTTP_STATUS_OK) {
             // 服务端正常响应
-            hdns_parse_resv_resp(resv_req, http_resp, req_pool, resv_resps);
+            int32_t parse_status = hdns_parse_resv_resp(resv_req, http_resp, req_pool, resv_resps);
+            int32_t negative_ttl = get_negative_ttl(client);
+            char *subnet_suffix = get_client_subnet_suffix(req_pool, client, resv_req->client_ip);
+            hdns_list_for_each_entry(entry_cursor, resv_resps) {
+                hdns_resv_resp_t *resp = entry_cursor->data;
+                // 指定了client_ip的结果按子网分区缓存，与本机解析结果互不覆盖
+                resp->cache_key = append_subnet_suffix(resp->pool, resp->cache_key, subnet_suffix);
+                hdns_apply_custom_ttl(client, resp);
+                if (negative_ttl > 0 && hdns_list_is_empty(resp->ips)) {
+                    resp->ttl = negative_ttl;
+                    resp->origin_ttl = negative_ttl;
+                }
+            }
+            // 一次响应的所有结果批量写入，每个分段只加一次锁
+            hdns_cache_table_add_batch(cache, resv_resps);
             hdns_list_for_each_entry(entry_cursor, resv_resps) {
-                hdns_apply_custom_ttl(client, entry_cursor->data);
-                hdns_cache_table_add(cache, entry_cursor->data);
                 hdns_probe_resv_resp_ips(client, entry_cursor->data);
             }
+            // 响应体无法解析时不能确认域名没有记录
+            if (parse_status == HDNS_OK) {
+                add_negative_entries(req_pool, resv_req, resv_resps, cache, negative_ttl, subnet_suffix);
+            }
             status = hdns_status_ok(client->config->session_id);
             break;
         } else {
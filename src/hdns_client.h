@@ -10,22 +10,53 @@
 
 
 #include "hdns_cache.h"
+#include "hdns_persist.h"
 #include "hdns_resolver.h"
 #include "hdns_scheduler.h"
+#include "hdns_flight.h"
 #include "hdns_define.h"
 #include "apr_thread_pool.h"
 
 HDNS_CPP_START
 
+typedef struct hdns_client_group_s hdns_client_group_t;
+
 typedef struct {
     hdns_pool_t *pool;
     hdns_scheduler_t *scheduler;
     hdns_net_detector_t *net_detector;
     hdns_config_t *config;
     hdns_cache_t *cache;
+    // 后台任务（如缓存预取）使用的线程池，与API层共享
+    apr_thread_pool_t *thread_pool;
+    // 未开启缓存持久化时为NULL
+    hdns_persist_t *persist;
     hdns_state_e state;
+    // 按账号共享缓存和调度器时所在的分组，未共享时为NULL
+    hdns_client_group_t *group;
+    // 是否随网络切换刷新缓存，共享时由分组内任一开启的客户端负责刷新
+    bool update_cache_on_net_change;
+    // 合并同一缓存键的并发解析请求，共享时指向分组的合并组
+    hdns_flight_group_t *flights;
 } hdns_client_t;
 
+/*
+ * 同一账号、同一region的客户端共享的缓存、调度器和请求合并组，最后一个成员退出时释放；
+ * 调度器使用分组独立的配置，不随任一成员的配置释放
+ */
+struct hdns_client_group_s {
+    hdns_pool_t *pool;
+    char *key;
+    hdns_config_t *config;
+    hdns_scheduler_t *scheduler;
+    hdns_cache_t *cache;
+    // 成员共用共享缓存，同一缓存键的并发请求在分组内合并
+    hdns_flight_group_t *flights;
+    // 任一成员开启缓存持久化时创建，成员共用一个快照文件，未开启时为NULL
+    hdns_persist_t *persist;
+    hdns_list_head_t *clients;
+};
+
 
 hdns_status_t hdns_do_single_resolve(hdns_client_t *client,
                                      const char *host,
@@ -41,12 +72,48 @@ hdns_status_t hdns_do_batch_resolve(hdns_client_t *client,
                                     const char *client_ip,
                                     hdns_list_head_t *results);
 
+/*
+ * 批量只读查询缓存，不发起网络请求，未命中的域名在results中为空结果，此时返回失败状态
+ */
+hdns_status_t hdns_do_batch_lookup_cache(hdns_client_t *client,
+                                         const hdns_list_head_t *hosts,
+                                         hdns_query_type_t query_type,
+                                         hdns_list_head_t *results);
+
 hdns_status_t hdns_do_single_resolve_with_req(hdns_client_t *client,
                                               hdns_resv_req_t *req,
                                               hdns_list_head_t *results);
 
+/*
+ * 异步解析完成的回调，失败时results可能为空列表，回调返回后results被释放
+ */
+typedef void (*hdns_single_resv_done_fn_t)(hdns_status_t *status, hdns_list_head_t *results, void *param);
+
+/*
+ * 与hdns_do_single_resolve_with_req相同，但相同请求正在进行时不阻塞当前线程，
+ * 而是挂载回调，请求完成后提交到线程池执行done_fn，客户端释放时仍未执行的回调以失败状态执行或被取消；
+ * 未合并时在当前线程执行done_fn。req不会被修改
+ */
+hdns_status_t hdns_do_single_resolve_with_req_async(hdns_client_t *client,
+                                                    const hdns_resv_req_t *req,
+                                                    hdns_single_resv_done_fn_t done_fn,
+                                                    void *done_param);
+
+hdns_status_t hdns_do_single_resolve_async(hdns_client_t *client,
+                                           const char *host,
+                                           hdns_query_type_t query_type,
+                                           bool using_cache,
+                                           const char *client_ip,
+                                           hdns_single_resv_done_fn_t done_fn,
+                                           void *done_param);
+
 void hdns_update_cache_on_net_change(hdns_net_chg_cb_task_t * task);
 
+/*
+ * 启动热点域名的定时刷新，客户端运行期间每隔几秒刷新一次访问频次最高且即将过期的域名
+ */
+hdns_status_t hdns_client_start_hot_host_refresh(hdns_client_t *client);
+
 HDNS_CPP_END
 
 #endif
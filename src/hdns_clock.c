@@ -0,0 +1,98 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include <apr_atomic.h>
+#include <apr_thread_mutex.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "hdns_clock.h"
+
+static volatile apr_uint32_t g_hdns_clock_virtual = 0;
+// 虚拟时间只在测试中使用，用锁保护，避免依赖APR 1.7才提供的64位原子操作
+static apr_thread_mutex_t *g_hdns_clock_lock = NULL;
+static apr_time_t g_hdns_clock_virtual_now = 0;
+
+#if !defined(_WIN32)
+static apr_time_t read_clock(clockid_t clock_id) {
+    struct timespec ts;
+    if (clock_gettime(clock_id, &ts) != 0) {
+        return apr_time_now();
+    }
+    return (apr_time_t) ts.tv_sec * APR_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+#endif
+
+static apr_time_t real_monotonic_now() {
+#if defined(_WIN32)
+    return (apr_time_t) GetTickCount64() * 1000;
+#elif defined(CLOCK_MONOTONIC_COARSE)
+    return read_clock(CLOCK_MONOTONIC_COARSE);
+#else
+    return read_clock(CLOCK_MONOTONIC);
+#endif
+}
+
+int hdns_clock_init(hdns_pool_t *pool) {
+    return apr_thread_mutex_create(&g_hdns_clock_lock, APR_THREAD_MUTEX_DEFAULT, pool) == APR_SUCCESS
+           ? HDNS_OK : HDNS_ERROR;
+}
+
+void hdns_clock_cleanup() {
+    apr_atomic_set32(&g_hdns_clock_virtual, 0);
+    if (g_hdns_clock_lock != NULL) {
+        apr_thread_mutex_destroy(g_hdns_clock_lock);
+        g_hdns_clock_lock = NULL;
+    }
+}
+
+apr_time_t hdns_clock_now() {
+    if (apr_atomic_read32(&g_hdns_clock_virtual)) {
+        apr_thread_mutex_lock(g_hdns_clock_lock);
+        apr_time_t now = g_hdns_clock_virtual_now;
+        apr_thread_mutex_unlock(g_hdns_clock_lock);
+        return now;
+    }
+    return real_monotonic_now();
+}
+
+apr_time_t hdns_clock_precise_now() {
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (apr_time_t) (counter.QuadPart / frequency.QuadPart * APR_USEC_PER_SEC
+                         + counter.QuadPart % frequency.QuadPart * APR_USEC_PER_SEC / frequency.QuadPart);
+#else
+    return read_clock(CLOCK_MONOTONIC);
+#endif
+}
+
+void hdns_clock_use_virtual(apr_time_t now) {
+    apr_thread_mutex_lock(g_hdns_clock_lock);
+    g_hdns_clock_virtual_now = now;
+    apr_thread_mutex_unlock(g_hdns_clock_lock);
+    apr_atomic_set32(&g_hdns_clock_virtual, 1);
+}
+
+void hdns_clock_advance(apr_interval_time_t interval) {
+    apr_thread_mutex_lock(g_hdns_clock_lock);
+    g_hdns_clock_virtual_now += interval;
+    apr_thread_mutex_unlock(g_hdns_clock_lock);
+}
+
+void hdns_clock_use_real() {
+    apr_atomic_set32(&g_hdns_clock_virtual, 0);
+}
+
+apr_time_t hdns_clock_to_wall_time(apr_time_t monotonic_time) {
+    return apr_time_now() - (hdns_clock_now() - monotonic_time);
+}
+
+apr_time_t hdns_clock_from_wall_time(apr_time_t wall_time) {
+    return hdns_clock_now() - (apr_time_now() - wall_time);
+}
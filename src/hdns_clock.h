@@ -0,0 +1,58 @@
+//
+// 单调时钟：TTL、过期和耗时计算都基于该时钟，不受NTP校时等系统时间调整影响；
+// Linux上使用CLOCK_MONOTONIC_COARSE，直接读取内核每个时钟节拍更新的时间，精度为毫秒级，开销远低于gettimeofday；
+// 建连、请求耗时等需要亚毫秒精度的测量使用hdns_clock_precise_now；
+// 测试可切换为虚拟时钟，由测试代码手动推进
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_CLOCK_H
+#define HDNS_C_SDK_HDNS_CLOCK_H
+
+#include <apr_time.h>
+
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+/*
+ * 创建虚拟时钟使用的锁，在hdns_sdk_init中调用
+ */
+int hdns_clock_init(hdns_pool_t *pool);
+
+void hdns_clock_cleanup();
+
+/*
+ * 当前单调时间，单位微秒，只能用于相互比较和计算间隔，与日历时间无关
+ */
+apr_time_t hdns_clock_now();
+
+/*
+ * 精确的单调时间（CLOCK_MONOTONIC），用于测量建连和请求耗时，不受虚拟时钟影响；
+ * 粗粒度时钟按节拍更新，亚毫秒的耗时会全部相同，无法用于排序
+ */
+apr_time_t hdns_clock_precise_now();
+
+/*
+ * 切换为虚拟时钟，时间固定为now，直到调用hdns_clock_advance推进
+ */
+void hdns_clock_use_virtual(apr_time_t now);
+
+void hdns_clock_advance(apr_interval_time_t interval);
+
+/*
+ * 恢复为系统单调时钟
+ */
+void hdns_clock_use_real();
+
+/*
+ * 单调时间与日历时间互相换算，用于写入和加载磁盘快照等需要跨进程重启保存的时间
+ */
+apr_time_t hdns_clock_to_wall_time(apr_time_t monotonic_time);
+
+apr_time_t hdns_clock_from_wall_time(apr_time_t wall_time);
+
+HDNS_CPP_END
+
+#endif
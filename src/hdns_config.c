@@ -5,6 +5,8 @@
 #include "hdns_define.h"
 #include "hdns_status.h"
 
+#include <apr_atomic.h>
+
 #include "hdns_config.h"
 
 #define HTTPDNS_REGION_CHINA_MAINLAND      "cn"
@@ -121,6 +123,14 @@ static void set_default_hdns_config(hdns_pool_t *pool, hdns_config_t *config) {
     config->using_sign = false;
     config->enable_expired_ip = false;
     config->enable_failover_localdns = false;
+    config->prefetch_ratio = 0;
+    config->enable_persistent_cache = false;
+    config->negative_ttl = HDNS_DEFAULT_NEGATIVE_TTL;
+    config->client_subnet_ipv4_prefix = 0;
+    config->client_subnet_ipv6_prefix = 0;
+    config->share_account_cache = false;
+    config->hot_host_refresh_count = 0;
+    hdns_config_sync_resolve_options(config);
 
     char session_id[HDNS_SID_STRING_LEN + 1];
     generate_session_id(session_id, HDNS_SID_STRING_LEN);
@@ -129,6 +139,9 @@ static void set_default_hdns_config(hdns_pool_t *pool, hdns_config_t *config) {
     config->pre_resolve_hosts = hdns_list_new(pool);
     config->ip_probe_items = apr_hash_make(pool);
     config->custom_ttl_items = apr_hash_make(pool);
+    config->ip_probe_rules = NULL;
+    config->custom_ttl_rules = NULL;
+    config->retired_rules = hdns_list_new(pool);
 
     init_boot_servers(pool, config);
 #ifdef HTTPDNS_REGION
@@ -139,6 +152,46 @@ static void set_default_hdns_config(hdns_pool_t *pool, hdns_config_t *config) {
     config->boot_server_region = apr_pstrdup(pool, HTTPDNS_REGION_CHINA_MAINLAND);
 }
 
+void hdns_config_sync_resolve_options(hdns_config_t *config) {
+    apr_uint32_t options = 0;
+    if (config->enable_expired_ip) {
+        options |= HDNS_CONFIG_OPT_EXPIRED_IP;
+    }
+    if (config->enable_failover_localdns) {
+        options |= HDNS_CONFIG_OPT_FAILOVER_LOCALDNS;
+    }
+    if (config->client_subnet_ipv4_prefix > 0 && config->client_subnet_ipv6_prefix > 0) {
+        options |= HDNS_CONFIG_OPT_CLIENT_SUBNET;
+    }
+    apr_atomic_set32(&config->resolve_options, options);
+    apr_uint32_t ratio_bits;
+    memcpy(&ratio_bits, &config->prefetch_ratio, sizeof(ratio_bits));
+    apr_atomic_set32(&config->prefetch_ratio_bits, ratio_bits);
+    apr_uint32_t prefix_bits = 0;
+    if (options & HDNS_CONFIG_OPT_CLIENT_SUBNET) {
+        prefix_bits = ((apr_uint32_t) config->client_subnet_ipv4_prefix & 0xFF) << 8
+                      | ((apr_uint32_t) config->client_subnet_ipv6_prefix & 0xFF);
+    }
+    apr_atomic_set32(&config->client_subnet_prefix_bits, prefix_bits);
+}
+
+apr_uint32_t hdns_config_get_resolve_options(hdns_config_t *config) {
+    return apr_atomic_read32(&config->resolve_options);
+}
+
+float hdns_config_get_prefetch_ratio(hdns_config_t *config) {
+    apr_uint32_t ratio_bits = apr_atomic_read32(&config->prefetch_ratio_bits);
+    float ratio;
+    memcpy(&ratio, &ratio_bits, sizeof(ratio));
+    return ratio;
+}
+
+void hdns_config_get_client_subnet_prefix(hdns_config_t *config, int32_t *ipv4_prefix_len, int32_t *ipv6_prefix_len) {
+    apr_uint32_t prefix_bits = apr_atomic_read32(&config->client_subnet_prefix_bits);
+    *ipv4_prefix_len = (int32_t) ((prefix_bits >> 8) & 0xFF);
+    *ipv6_prefix_len = (int32_t) (prefix_bits & 0xFF);
+}
+
 hdns_config_t *hdns_config_create() {
     hdns_pool_new(pool);
     hdns_config_t *config = hdns_palloc(pool, sizeof(hdns_config_t));
@@ -158,6 +211,65 @@ hdns_list_head_t *hdns_config_get_boot_servers(hdns_config_t *config, bool ipv4)
            : boot_servers;
 }
 
+/*
+ * 在config->lock内调用，读取方无锁持有规则树且不计引用，旧规则树保留到hdns_config_cleanup随配置的pool释放；
+ * 链表节点分配在规则树自己的pool上
+ */
+static void retire_rules_locked(hdns_config_t *config, hdns_host_rules_t *rules) {
+    if (NULL == rules) {
+        return;
+    }
+    hdns_list_node_t *node = hdns_palloc(rules->pool, sizeof(hdns_list_node_t));
+    node->pool = rules->pool;
+    node->data = rules;
+    hdns_list_insert_tail(node, config->retired_rules);
+}
+
+static void add_host_rule(hdns_config_t *config, hdns_hash_t *items, volatile void **rules, const char *host, int32_t value) {
+    apr_thread_mutex_lock(config->lock);
+    int32_t *value_pr = hdns_palloc(config->pool, sizeof(int32_t));
+    *value_pr = value;
+    apr_hash_set(items, apr_pstrdup(config->pool, host), APR_HASH_KEY_STRING, value_pr);
+    // 多次变更之间不编译，下一次读取时统一重建
+    retire_rules_locked(config, apr_atomic_xchgptr(rules, NULL));
+    apr_thread_mutex_unlock(config->lock);
+}
+
+/*
+ * 已编译时无锁返回，否则在配置锁内编译并发布
+ */
+static const hdns_host_rules_t *get_host_rules(hdns_config_t *config, hdns_hash_t *items, volatile void **rules) {
+    const hdns_host_rules_t *compiled = apr_atomic_casptr(rules, NULL, NULL);
+    if (compiled != NULL) {
+        return compiled;
+    }
+    apr_thread_mutex_lock(config->lock);
+    compiled = apr_atomic_casptr(rules, NULL, NULL);
+    if (NULL == compiled) {
+        hdns_host_rules_t *new_rules = hdns_host_rules_compile(config->pool, items);
+        apr_atomic_xchgptr(rules, new_rules);
+        compiled = new_rules;
+    }
+    apr_thread_mutex_unlock(config->lock);
+    return compiled;
+}
+
+void hdns_config_add_custom_ttl_rule(hdns_config_t *config, const char *host, int32_t ttl) {
+    add_host_rule(config, config->custom_ttl_items, &config->custom_ttl_rules, host, ttl);
+}
+
+void hdns_config_add_ip_probe_rule(hdns_config_t *config, const char *host, int32_t port) {
+    add_host_rule(config, config->ip_probe_items, &config->ip_probe_rules, host, port);
+}
+
+const hdns_host_rules_t *hdns_config_get_custom_ttl_rules(hdns_config_t *config) {
+    return get_host_rules(config, config->custom_ttl_items, &config->custom_ttl_rules);
+}
+
+const hdns_host_rules_t *hdns_config_get_ip_probe_rules(hdns_config_t *config) {
+    return get_host_rules(config, config->ip_probe_items, &config->ip_probe_rules);
+}
+
 hdns_status_t hdns_config_valid(hdns_config_t *config) {
     if (NULL == config) {
         return hdns_status_error(HDNS_FAILED_VERIFICATION,
@@ -6,10 +6,15 @@
 #define HDNS_C_SDK_HDNS_CONFIG_H
 
 #include "hdns_list.h"
+#include "hdns_host_rule.h"
 #include "hdns_status.h"
 
 HDNS_CPP_START
 
+#define HDNS_CONFIG_OPT_EXPIRED_IP         0x1
+#define HDNS_CONFIG_OPT_FAILOVER_LOCALDNS  0x2
+#define HDNS_CONFIG_OPT_CLIENT_SUBNET      0x4
+
 typedef struct {
     hdns_pool_t *pool;
     char *account_id;
@@ -22,6 +27,23 @@ typedef struct {
     bool using_sign;
     bool enable_expired_ip;
     bool enable_failover_localdns;
+    // 缓存命中时已过去的TTL比例超过该值则后台预取，0表示关闭
+    float prefetch_ratio;
+    bool enable_persistent_cache;
+    // 负缓存TTL（秒），0表示关闭负缓存
+    int32_t negative_ttl;
+    // 按client_ip所在子网分区缓存时的前缀长度，0表示不分区
+    int32_t client_subnet_ipv4_prefix;
+    int32_t client_subnet_ipv6_prefix;
+    // 启动时与同一账号、同一region的其他客户端共享缓存和调度器
+    bool share_account_cache;
+    // 后台定时刷新的热点域名个数，0表示关闭
+    int32_t hot_host_refresh_count;
+    // 解析路径上读取的开关和预取比例的无锁快照，取值见HDNS_CONFIG_OPT_*，由设置接口在锁内同步
+    volatile apr_uint32_t resolve_options;
+    volatile apr_uint32_t prefetch_ratio_bits;
+    // 子网前缀长度打包为(ipv4 << 8) | ipv6，保证两者一致读取
+    volatile apr_uint32_t client_subnet_prefix_bits;
     char *session_id;
     hdns_list_head_t *pre_resolve_hosts;
     hdns_hash_t *ipv4_boot_servers;
@@ -29,18 +51,48 @@ typedef struct {
     char *boot_server_region;
     hdns_hash_t *ip_probe_items;
     hdns_hash_t *custom_ttl_items;
+    // 由上面两个表编译的规则树，读取时无锁；规则变化时置空，下一次读取时重新编译
+    volatile void *ip_probe_rules;
+    volatile void *custom_ttl_rules;
+    // 被替换的旧规则树，读取方可能仍在使用，保留到配置释放；只在编译后规则再次变化时产生
+    hdns_list_head_t *retired_rules;
     apr_thread_mutex_t *lock;
 } hdns_config_t;
 
 
 hdns_config_t *hdns_config_create();
 
+/*
+ * 按当前配置更新无锁快照，修改相关配置项后在config->lock内调用
+ */
+void hdns_config_sync_resolve_options(hdns_config_t *config);
+
+apr_uint32_t hdns_config_get_resolve_options(hdns_config_t *config);
+
+float hdns_config_get_prefetch_ratio(hdns_config_t *config);
+
+/*
+ * 无锁读取按子网分区缓存的前缀长度，未开启时均为0
+ */
+void hdns_config_get_client_subnet_prefix(hdns_config_t *config, int32_t *ipv4_prefix_len, int32_t *ipv6_prefix_len);
+
 hdns_status_t hdns_config_valid(hdns_config_t *config);
 
 void hdns_config_cleanup(hdns_config_t *config);
 
 hdns_list_head_t *hdns_config_get_boot_servers(hdns_config_t *config, bool ipv4);
 
+/*
+ * 添加自定义TTL或IP探测规则，host为规范化后的域名或*.开头的通配域名
+ */
+void hdns_config_add_custom_ttl_rule(hdns_config_t *config, const char *host, int32_t ttl);
+
+void hdns_config_add_ip_probe_rule(hdns_config_t *config, const char *host, int32_t port);
+
+const hdns_host_rules_t *hdns_config_get_custom_ttl_rules(hdns_config_t *config);
+
+const hdns_host_rules_t *hdns_config_get_ip_probe_rules(hdns_config_t *config);
+
 HDNS_CPP_END
 
 #endif
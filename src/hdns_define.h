@@ -149,6 +149,13 @@ typedef apr_array_header_t hdns_array_header_t;
 
 #define HDNS_MULTI_RESOLVE_SIZE 5
 #define HDNS_MAX_DOMAIN_LENGTH  255
+#define HDNS_DEFAULT_NEGATIVE_TTL 30
+#define HDNS_DEFAULT_CLIENT_SUBNET_IPV4_PREFIX 24
+#define HDNS_DEFAULT_CLIENT_SUBNET_IPV6_PREFIX 56
+// 缓存键与客户端子网之间的分隔符，域名中不会出现
+#define HDNS_CLIENT_SUBNET_SEPARATOR "@"
+// 缓存键与SDNS参数哈希之间的分隔符
+#define HDNS_SDNS_CACHE_KEY_SEPARATOR "#"
 
 #define HDNS_HTTP_PREFIX    "http://"
 #define HDNS_HTTPS_PREFIX   "https://"
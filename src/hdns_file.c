@@ -25,25 +25,31 @@ int32_t hdns_file_create_dir(const char *dir_path) {
     return rv == APR_SUCCESS ? HDNS_OK : HDNS_ERROR;
 }
 
+static apr_status_t write_content(apr_file_t *file, const char *file_path, const char *content) {
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t len = strlen(content);
+    apr_size_t written = 0;
+    while (len > written) {
+        apr_size_t bytes_written = len - written;
+        rv = apr_file_write(file, content + written, &bytes_written);
+        if (rv != APR_SUCCESS) {
+            char err_msg[128];
+            apr_strerror(rv, err_msg, sizeof(err_msg));
+            hdns_log_info("Error write content '%s' into file %s : %s", content, file_path, err_msg);
+            break;
+        }
+        written += bytes_written;
+    }
+    return rv;
+}
+
 int32_t hdns_file_write(const char *file_path, const char *content) {
     apr_file_t *file;
     apr_status_t rv;
     hdns_pool_new(mp);
     rv = apr_file_open(&file, file_path, APR_CREATE | APR_TRUNCATE | APR_WRITE, APR_OS_DEFAULT, mp);
     if (rv == APR_SUCCESS) {
-        apr_size_t len = strlen(content);
-        apr_size_t written = 0;
-        while (len > written) {
-            apr_size_t bytes_written = len - written;
-            rv = apr_file_write(file, content + written, &bytes_written);
-            if (rv != APR_SUCCESS) {
-                char err_msg[128];
-                apr_strerror(rv, err_msg, sizeof(err_msg));
-                hdns_log_info("Error write content '%s' into file %s : %s", content, file_path, err_msg);
-                break;
-            }
-            written += bytes_written;
-        }
+        rv = write_content(file, file_path, content);
         apr_file_close(file);
     } else {
         char err_msg[128];
@@ -54,6 +60,30 @@ int32_t hdns_file_write(const char *file_path, const char *content) {
     return (rv == APR_SUCCESS) ? HDNS_OK : HDNS_ERROR;
 }
 
+int32_t hdns_file_write_atomic(const char *file_path, const char *content) {
+    apr_file_t *file;
+    hdns_pool_new(mp);
+    // 临时文件名由apr_file_mktemp生成，多个进程、线程同时写同一文件时互不覆盖
+    char *tmp_file_path = apr_pstrcat(mp, file_path, ".XXXXXX", NULL);
+    apr_status_t rv = apr_file_mktemp(&file, tmp_file_path, APR_CREATE | APR_READ | APR_WRITE | APR_EXCL, mp);
+    if (rv == APR_SUCCESS) {
+        rv = write_content(file, tmp_file_path, content);
+        apr_file_close(file);
+        if (rv == APR_SUCCESS) {
+            rv = apr_file_rename(tmp_file_path, file_path, mp);
+        }
+        if (rv != APR_SUCCESS) {
+            apr_file_remove(tmp_file_path, mp);
+        }
+    } else {
+        char err_msg[128];
+        apr_strerror(rv, err_msg, sizeof(err_msg));
+        hdns_log_info("Error create temp file for %s : %s", file_path, err_msg);
+    }
+    apr_pool_destroy(mp);
+    return (rv == APR_SUCCESS) ? HDNS_OK : HDNS_ERROR;
+}
+
 char *hdns_file_read(const char *file_path, apr_pool_t *pool) {
     apr_file_t *file;
     apr_status_t rv;
@@ -13,6 +13,11 @@ int32_t hdns_file_create_dir(const char *dir_path);
 
 int32_t hdns_file_write(const char *file_path, const char *content);
 
+/*
+ * 先写入同目录下唯一命名的临时文件再重命名，读取方不会读到写了一半的文件
+ */
+int32_t hdns_file_write_atomic(const char *file_path, const char *content);
+
 char *hdns_file_read(const char *file_path, apr_pool_t *pool);
 
 #endif
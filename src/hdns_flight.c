@@ -0,0 +1,222 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include <apr_atomic.h>
+
+#include "hdns_clock.h"
+#include "hdns_flight.h"
+#include "hdns_log.h"
+
+hdns_flight_group_t *hdns_flight_group_create(apr_thread_pool_t *thread_pool) {
+    hdns_pool_new(pool);
+    hdns_flight_group_t *group = hdns_palloc(pool, sizeof(hdns_flight_group_t));
+    group->pool = pool;
+    apr_thread_mutex_create(&group->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    group->flights = hdns_htable_make(pool);
+    group->thread_pool = thread_pool;
+    group->active_count = 0;
+    apr_thread_cond_create(&group->idle_cond, pool);
+    return group;
+}
+
+void hdns_flight_group_cleanup(hdns_flight_group_t *group) {
+    if (NULL == group) {
+        return;
+    }
+    // 发起方完成前仍会访问group，等待全部离开后再释放
+    apr_thread_mutex_lock(group->lock);
+    while (group->active_count > 0) {
+        apr_thread_cond_wait(group->idle_cond, group->lock);
+    }
+    apr_thread_mutex_unlock(group->lock);
+    apr_thread_cond_destroy(group->idle_cond);
+    apr_thread_mutex_destroy(group->lock);
+    hdns_pool_destroy(group->pool);
+}
+
+/*
+ * 在group->lock内调用，发起方或等待方不再访问group
+ */
+static void leave_group_locked(hdns_flight_group_t *group) {
+    if (--group->active_count == 0) {
+        apr_thread_cond_broadcast(group->idle_cond);
+    }
+}
+
+static void destroy_flight(hdns_flight_t *flight) {
+    apr_thread_cond_destroy(flight->done_cond);
+    hdns_pool_destroy(flight->pool);
+}
+
+/*
+ * 可在group->lock内调用，返回true时由调用方在锁外销毁
+ */
+static APR_INLINE bool release_flight(hdns_flight_t *flight) {
+    return 0 == apr_atomic_dec32(&flight->ref_count);
+}
+
+static void run_callback_with_status(hdns_flight_callback_t *callback, hdns_status_t status) {
+    hdns_flight_t *flight = callback->flight;
+    callback->fn(&status, callback->param);
+    if (release_flight(flight)) {
+        destroy_flight(flight);
+    }
+}
+
+static void run_callback(hdns_flight_callback_t *callback) {
+    run_callback_with_status(callback, callback->flight->status);
+}
+
+static void *APR_THREAD_FUNC hdns_flight_callback_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    run_callback(data);
+    return NULL;
+}
+
+bool hdns_flight_join(hdns_flight_group_t *group, const char *key, hdns_flight_t **flight) {
+    apr_thread_mutex_lock(group->lock);
+    hdns_flight_t *existing = hdns_htable_get(group->flights, key);
+    group->active_count++;
+    if (existing != NULL) {
+        apr_atomic_inc32(&existing->ref_count);
+        apr_thread_mutex_unlock(group->lock);
+        *flight = existing;
+        return false;
+    }
+    hdns_pool_new(pool);
+    hdns_flight_t *created = hdns_pcalloc(pool, sizeof(hdns_flight_t));
+    created->pool = pool;
+    created->key = apr_pstrdup(pool, key);
+    apr_thread_cond_create(&created->done_cond, pool);
+    created->done = false;
+    apr_atomic_set32(&created->ref_count, 1);
+    created->callbacks = hdns_list_new(pool);
+    hdns_htable_set(group->flights, created->key, created);
+    apr_thread_mutex_unlock(group->lock);
+    *flight = created;
+    return true;
+}
+
+void hdns_flight_finish(hdns_flight_group_t *group, hdns_flight_t *flight, const hdns_status_t *status) {
+    apr_thread_mutex_lock(group->lock);
+    hdns_htable_remove(group->flights, flight->key);
+    flight->status = *status;
+    flight->done = true;
+    apr_thread_cond_broadcast(flight->done_cond);
+    apr_thread_pool_t *thread_pool = group->thread_pool;
+    leave_group_locked(group);
+    apr_thread_mutex_unlock(group->lock);
+
+    // 完成后不再挂载新的回调，每个回调持有一个引用，提交到线程池后发起方立即返回
+    hdns_list_for_each_entry(cursor, flight->callbacks) {
+        hdns_flight_callback_t *callback = cursor->data;
+        bool submitted = thread_pool != NULL
+                         && apr_thread_pool_push(thread_pool,
+                                                 hdns_flight_callback_task,
+                                                 callback,
+                                                 0,
+                                                 callback->owner) == APR_SUCCESS;
+        if (!submitted) {
+            hdns_log_debug("submit flight callback task failed, run it on the leader thread");
+            run_callback(callback);
+        }
+    }
+
+    if (release_flight(flight)) {
+        destroy_flight(flight);
+    }
+}
+
+hdns_status_t hdns_flight_wait(hdns_flight_group_t *group, hdns_flight_t *flight, apr_interval_time_t timeout) {
+    apr_time_t deadline = hdns_clock_now() + timeout;
+    apr_thread_mutex_lock(group->lock);
+    while (!flight->done) {
+        apr_interval_time_t remain = deadline - hdns_clock_now();
+        if (remain <= 0) {
+            break;
+        }
+        apr_thread_cond_timedwait(flight->done_cond, group->lock, remain);
+    }
+    hdns_status_t status = flight->done
+                           ? flight->status
+                           : hdns_status_error(HDNS_RESOLVE_FAIL,
+                                               HDNS_RESOLVE_FAIL_CODE,
+                                               "wait for in-flight request timeout",
+                                               NULL);
+    leave_group_locked(group);
+    apr_thread_mutex_unlock(group->lock);
+    if (release_flight(flight)) {
+        destroy_flight(flight);
+    }
+    return status;
+}
+
+bool hdns_flight_attach(hdns_flight_group_t *group,
+                        hdns_flight_t *flight,
+                        hdns_flight_cb_fn_t fn,
+                        void *param,
+                        void *owner,
+                        hdns_status_t *status) {
+    apr_thread_mutex_lock(group->lock);
+    if (!flight->done) {
+        // 引用转交给回调，回调执行完后释放
+        hdns_flight_callback_t *callback = hdns_palloc(flight->pool, sizeof(hdns_flight_callback_t));
+        callback->flight = flight;
+        callback->fn = fn;
+        callback->param = param;
+        callback->owner = owner;
+        hdns_list_add(flight->callbacks, callback, NULL);
+        leave_group_locked(group);
+        apr_thread_mutex_unlock(group->lock);
+        return true;
+    }
+    *status = flight->status;
+    leave_group_locked(group);
+    apr_thread_mutex_unlock(group->lock);
+    if (release_flight(flight)) {
+        destroy_flight(flight);
+    }
+    return false;
+}
+
+typedef struct {
+    const void *owner;
+    hdns_list_head_t *cancelled;
+} cancel_callbacks_rec_t;
+
+/*
+ * 在group->lock内调用，表中的请求均未完成，发起方不会同时遍历回调列表
+ */
+static int collect_owner_callbacks(void *rec, const char *key, size_t klen, void *value) {
+    hdns_unused_var(key);
+    hdns_unused_var(klen);
+    cancel_callbacks_rec_t *cancel_rec = rec;
+    hdns_flight_t *flight = value;
+    hdns_list_for_each_entry_safe(cursor, flight->callbacks) {
+        hdns_flight_callback_t *callback = cursor->data;
+        if (callback->owner == cancel_rec->owner) {
+            hdns_list_del(cursor);
+            hdns_list_add(cancel_rec->cancelled, callback, NULL);
+        }
+    }
+    return 1;
+}
+
+void hdns_flight_group_cancel(hdns_flight_group_t *group, const void *owner) {
+    if (NULL == group) {
+        return;
+    }
+    hdns_pool_new(pool);
+    cancel_callbacks_rec_t rec = {owner, hdns_list_new(pool)};
+    apr_thread_mutex_lock(group->lock);
+    hdns_htable_do(collect_owner_callbacks, &rec, group->flights);
+    apr_thread_mutex_unlock(group->lock);
+    hdns_list_for_each_entry(cursor, rec.cancelled) {
+        run_callback_with_status(cursor->data,
+                                 hdns_status_error(HDNS_RESOLVE_FAIL,
+                                                   HDNS_RESOLVE_FAIL_CODE,
+                                                   "in-flight request cancelled",
+                                                   NULL));
+    }
+    hdns_pool_destroy(pool);
+}
@@ -0,0 +1,100 @@
+//
+// 合并并发的相同请求：同一键的第一个调用方发起请求，其余调用方阻塞等待结果或挂载回调，
+// 避免热点域名过期时大量线程同时请求解析服务
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_FLIGHT_H
+#define HDNS_C_SDK_HDNS_FLIGHT_H
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_pool.h>
+
+#include "hdns_htable.h"
+#include "hdns_list.h"
+#include "hdns_status.h"
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+typedef void (*hdns_flight_cb_fn_t)(hdns_status_t *status, void *param);
+
+/*
+ * 进行中的请求，发起方和每个等待方各持有一个引用，最后一个引用释放时销毁
+ */
+typedef struct {
+    hdns_pool_t *pool;
+    char *key;
+    apr_thread_cond_t *done_cond;
+    bool done;
+    hdns_status_t status;
+    // 原子计数，回调任务释放引用时不再依赖group
+    volatile apr_uint32_t ref_count;
+    // 异步等待方挂载的回调，请求完成后提交到线程池执行
+    hdns_list_head_t *callbacks;
+} hdns_flight_t;
+
+typedef struct {
+    hdns_flight_t *flight;
+    hdns_flight_cb_fn_t fn;
+    void *param;
+    // 提交回调任务时的属主，通过apr_thread_pool_tasks_cancel取消
+    void *owner;
+} hdns_flight_callback_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    // 保护flights及其中每个请求的状态
+    apr_thread_mutex_t *lock;
+    hdns_htable_t *flights;
+    // 执行挂载回调的线程池，为NULL或提交失败时在发起方线程执行
+    apr_thread_pool_t *thread_pool;
+    // 仍在使用group的发起方和等待方数量，归零时唤醒idle_cond
+    apr_uint32_t active_count;
+    apr_thread_cond_t *idle_cond;
+} hdns_flight_group_t;
+
+hdns_flight_group_t *hdns_flight_group_create(apr_thread_pool_t *thread_pool);
+
+/*
+ * 等待进行中的请求全部完成后释放，调用方需保证不再有新的调用方加入
+ */
+void hdns_flight_group_cleanup(hdns_flight_group_t *group);
+
+/*
+ * 摘除属主为owner且尚未提交的回调，并在当前线程以失败状态执行；
+ * 已提交的回调任务由调用方通过apr_thread_pool_tasks_cancel取消
+ */
+void hdns_flight_group_cancel(hdns_flight_group_t *group, const void *owner);
+
+/*
+ * 加入key对应的请求，不存在时创建并返回true，调用方作为发起方执行请求，完成后必须调用hdns_flight_finish；
+ * 返回false时调用方为等待方，需通过hdns_flight_wait或hdns_flight_attach等待结果
+ */
+bool hdns_flight_join(hdns_flight_group_t *group, const char *key, hdns_flight_t **flight);
+
+/*
+ * 发起方记录结果，唤醒阻塞的等待方，并将挂载的回调提交到线程池执行
+ */
+void hdns_flight_finish(hdns_flight_group_t *group, hdns_flight_t *flight, const hdns_status_t *status);
+
+/*
+ * 阻塞等待请求完成，最长等待timeout，超时返回失败状态；返回后不能再使用flight
+ */
+hdns_status_t hdns_flight_wait(hdns_flight_group_t *group, hdns_flight_t *flight, apr_interval_time_t timeout);
+
+/*
+ * 挂载回调，请求完成后以owner为属主提交到线程池执行；请求已经完成时不挂载，返回false并写入结果。返回后不能再使用flight
+ */
+bool hdns_flight_attach(hdns_flight_group_t *group,
+                        hdns_flight_t *flight,
+                        hdns_flight_cb_fn_t fn,
+                        void *param,
+                        void *owner,
+                        hdns_status_t *status);
+
+HDNS_CPP_END
+
+#endif
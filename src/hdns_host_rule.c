@@ -0,0 +1,189 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_host_rule.h"
+
+/*
+ * 编译期使用的临时节点，子节点通过单链表串联
+ */
+typedef struct hdns_host_rule_build_node_s hdns_host_rule_build_node_t;
+
+struct hdns_host_rule_build_node_s {
+    const char *label;
+    size_t label_len;
+    uint32_t flags;
+    int32_t exact_value;
+    int32_t wildcard_value;
+    size_t child_count;
+    hdns_host_rule_build_node_t *first_child;
+    hdns_host_rule_build_node_t *next_sibling;
+};
+
+static int compare_label(const char *label1, size_t len1, const char *label2, size_t len2) {
+    if (len1 != len2) {
+        return len1 < len2 ? -1 : 1;
+    }
+    return memcmp(label1, label2, len1);
+}
+
+static int compare_build_node(const void *node1, const void *node2) {
+    const hdns_host_rule_build_node_t *n1 = *(hdns_host_rule_build_node_t *const *) node1;
+    const hdns_host_rule_build_node_t *n2 = *(hdns_host_rule_build_node_t *const *) node2;
+    return compare_label(n1->label, n1->label_len, n2->label, n2->label_len);
+}
+
+static hdns_host_rule_build_node_t *get_or_add_child(hdns_pool_t *pool,
+                                                     hdns_host_rule_build_node_t *parent,
+                                                     const char *label,
+                                                     size_t label_len,
+                                                     size_t *node_count) {
+    for (hdns_host_rule_build_node_t *child = parent->first_child; child != NULL; child = child->next_sibling) {
+        if (compare_label(child->label, child->label_len, label, label_len) == 0) {
+            return child;
+        }
+    }
+    hdns_host_rule_build_node_t *child = hdns_pcalloc(pool, sizeof(hdns_host_rule_build_node_t));
+    child->label = label;
+    child->label_len = label_len;
+    child->next_sibling = parent->first_child;
+    parent->first_child = child;
+    parent->child_count++;
+    (*node_count)++;
+    return child;
+}
+
+/*
+ * 按标签倒序插入，host需在规则树的pool上，编译后的节点直接引用其中的标签
+ */
+static void insert_rule(hdns_pool_t *pool,
+                        hdns_host_rule_build_node_t *root,
+                        const char *host,
+                        int32_t value,
+                        size_t *node_count) {
+    bool wildcard = strncmp(host, HDNS_HOST_RULE_WILDCARD_PREFIX, strlen(HDNS_HOST_RULE_WILDCARD_PREFIX)) == 0;
+    if (wildcard) {
+        host += strlen(HDNS_HOST_RULE_WILDCARD_PREFIX);
+    }
+    hdns_host_rule_build_node_t *node = root;
+    size_t end = strlen(host);
+    while (end > 0) {
+        size_t start = end;
+        while (start > 0 && host[start - 1] != '.') {
+            start--;
+        }
+        node = get_or_add_child(pool, node, host + start, end - start, node_count);
+        end = start > 0 ? start - 1 : 0;
+    }
+    if (node == root) {
+        return;
+    }
+    if (wildcard) {
+        node->flags |= HDNS_HOST_RULE_WILDCARD;
+        node->wildcard_value = value;
+    } else {
+        node->flags |= HDNS_HOST_RULE_EXACT;
+        node->exact_value = value;
+    }
+}
+
+hdns_host_rules_t *hdns_host_rules_compile(hdns_pool_t *parent, hdns_hash_t *items) {
+    hdns_pool_t *pool = NULL;
+    hdns_pool_create(&pool, parent);
+    hdns_host_rules_t *rules = hdns_palloc(pool, sizeof(hdns_host_rules_t));
+    rules->pool = pool;
+    hdns_pool_new(build_pool);
+    hdns_host_rule_build_node_t *root = hdns_pcalloc(build_pool, sizeof(hdns_host_rule_build_node_t));
+    size_t node_count = 1;
+    for (apr_hash_index_t *hi = apr_hash_first(build_pool, items); hi != NULL; hi = apr_hash_next(hi)) {
+        const void *key;
+        void *value;
+        apr_hash_this(hi, &key, NULL, &value);
+        insert_rule(build_pool, root, apr_pstrdup(pool, key), *(int32_t *) value, &node_count);
+    }
+
+    // 按层序展开，同一节点的子节点排序后连续存放
+    hdns_host_rule_build_node_t **order = hdns_palloc(build_pool, node_count * sizeof(hdns_host_rule_build_node_t *));
+    rules->nodes = hdns_pcalloc(pool, node_count * sizeof(hdns_host_rule_node_t));
+    rules->node_count = node_count;
+    order[0] = root;
+    size_t tail = 1;
+    for (size_t head = 0; head < tail; head++) {
+        hdns_host_rule_build_node_t *build_node = order[head];
+        size_t child_start = tail;
+        for (hdns_host_rule_build_node_t *child = build_node->first_child; child != NULL; child = child->next_sibling) {
+            order[tail++] = child;
+        }
+        qsort(&order[child_start], build_node->child_count, sizeof(hdns_host_rule_build_node_t *), compare_build_node);
+        hdns_host_rule_node_t *node = &rules->nodes[head];
+        node->label = build_node->label;
+        node->label_len = (uint32_t) build_node->label_len;
+        node->child_start = (uint32_t) child_start;
+        node->child_count = (uint32_t) build_node->child_count;
+        node->flags = build_node->flags;
+        node->exact_value = build_node->exact_value;
+        node->wildcard_value = build_node->wildcard_value;
+    }
+    hdns_pool_destroy(build_pool);
+    return rules;
+}
+
+void hdns_host_rules_destroy(hdns_host_rules_t *rules) {
+    if (rules != NULL) {
+        hdns_pool_destroy(rules->pool);
+    }
+}
+
+static const hdns_host_rule_node_t *find_child(const hdns_host_rules_t *rules,
+                                               const hdns_host_rule_node_t *parent,
+                                               const char *label,
+                                               size_t label_len) {
+    size_t low = parent->child_start;
+    size_t high = parent->child_start + parent->child_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const hdns_host_rule_node_t *node = &rules->nodes[mid];
+        int cmp = compare_label(node->label, node->label_len, label, label_len);
+        if (0 == cmp) {
+            return node;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+bool hdns_host_rules_match(const hdns_host_rules_t *rules, const char *host, int32_t *value) {
+    if (NULL == rules || hdns_str_is_blank(host) || rules->nodes[0].child_count == 0) {
+        return false;
+    }
+    const hdns_host_rule_node_t *node = &rules->nodes[0];
+    bool matched = false;
+    size_t end = strlen(host);
+    while (true) {
+        size_t start = end;
+        while (start > 0 && host[start - 1] != '.') {
+            start--;
+        }
+        // 还有剩余标签，当前节点的通配规则覆盖该域名，继续查找更长的后缀
+        if (node->flags & HDNS_HOST_RULE_WILDCARD) {
+            *value = node->wildcard_value;
+            matched = true;
+        }
+        node = find_child(rules, node, host + start, end - start);
+        if (NULL == node) {
+            return matched;
+        }
+        if (0 == start) {
+            break;
+        }
+        end = start - 1;
+    }
+    if (node->flags & HDNS_HOST_RULE_EXACT) {
+        *value = node->exact_value;
+        return true;
+    }
+    return matched;
+}
@@ -0,0 +1,60 @@
+//
+// 按域名后缀匹配的规则树：域名按标签倒序插入，如*.cdn.example.com依次为com、example、cdn，
+// 编译后为只读的扁平数组，同一节点的子节点连续存放并按标签排序，匹配时逐级二分查找
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_HOST_RULE_H
+#define HDNS_C_SDK_HDNS_HOST_RULE_H
+
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+// 通配规则前缀，只支持出现在最左侧
+#define HDNS_HOST_RULE_WILDCARD_PREFIX  "*."
+
+#define HDNS_HOST_RULE_EXACT     0x01
+#define HDNS_HOST_RULE_WILDCARD  0x02
+
+typedef struct {
+    const char *label;
+    uint32_t label_len;
+    uint32_t child_start;
+    uint32_t child_count;
+    uint32_t flags;
+    // 完全匹配该节点对应域名时的取值
+    int32_t exact_value;
+    // 匹配该节点下任意子域名时的取值
+    int32_t wildcard_value;
+} hdns_host_rule_node_t;
+
+/*
+ * 编译后不再修改，可在多线程间无锁读取，内存分配在独立的子pool上
+ */
+typedef struct {
+    hdns_pool_t *pool;
+    // nodes[0]为根节点
+    hdns_host_rule_node_t *nodes;
+    size_t node_count;
+} hdns_host_rules_t;
+
+/*
+ * @brief 由规则表编译规则树，键为域名或*.开头的通配域名，值为int32_t指针
+ * @note 规则树分配在parent的子pool上，随parent释放，也可通过hdns_host_rules_destroy提前释放；
+ *       规则表中的域名需已规范化
+ */
+hdns_host_rules_t *hdns_host_rules_compile(hdns_pool_t *parent, hdns_hash_t *items);
+
+void hdns_host_rules_destroy(hdns_host_rules_t *rules);
+
+/*
+ * @brief 匹配规范化后的域名，完全匹配优先，其次是最长的通配后缀
+ * @return 匹配成功返回true，并写入value
+ */
+bool hdns_host_rules_match(const hdns_host_rules_t *rules, const char *host, int32_t *value);
+
+HDNS_CPP_END
+
+#endif
@@ -0,0 +1,284 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include "hdns_htable.h"
+
+#define HDNS_HTABLE_CTRL_EMPTY     ((int8_t) -128)
+#define HDNS_HTABLE_CTRL_DELETED   ((int8_t) -2)
+#define HDNS_HTABLE_INIT_CAPACITY  16
+
+#define HDNS_HTABLE_LSBS  UINT64_C(0x0101010101010101)
+#define HDNS_HTABLE_MSBS  UINT64_C(0x8080808080808080)
+
+#define hdns_htable_h1(hash)  ((hash) >> 7)
+#define hdns_htable_h2(hash)  ((int8_t) ((hash) & 0x7f))
+#define hdns_htable_is_full(ctrl) ((ctrl) >= 0)
+// 最大负载因子7/8
+#define hdns_htable_max_load(capacity) ((capacity) - (capacity) / 8)
+
+
+static APR_INLINE uint64_t load_group(const int8_t *ctrl) {
+    // 按小端序拼装，编译器会优化成一次8字节读取
+    uint64_t group = 0;
+    for (int i = 0; i < HDNS_HTABLE_GROUP_WIDTH; i++) {
+        group |= ((uint64_t) (uint8_t) ctrl[i]) << (i * 8);
+    }
+    return group;
+}
+
+static APR_INLINE uint64_t group_match_h2(uint64_t group, int8_t h2) {
+    // 可能存在误报，调用方需要再比较完整哈希
+    uint64_t x = group ^ (HDNS_HTABLE_LSBS * (uint8_t) h2);
+    return (x - HDNS_HTABLE_LSBS) & ~x & HDNS_HTABLE_MSBS;
+}
+
+static APR_INLINE uint64_t group_match_empty(uint64_t group) {
+    // EMPTY(0x80)最高位为1且第1位为0，DELETED(0xFE)第1位为1
+    return group & (~group << 6) & HDNS_HTABLE_MSBS;
+}
+
+static APR_INLINE uint64_t group_match_empty_or_deleted(uint64_t group) {
+    return group & HDNS_HTABLE_MSBS;
+}
+
+static APR_INLINE size_t lowest_matched_byte(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t) __builtin_ctzll(mask) >> 3;
+#else
+    size_t i = 0;
+    while (!(mask & 0x80)) {
+        mask >>= 8;
+        i++;
+    }
+    return i;
+#endif
+}
+
+uint64_t hdns_htable_hash(const char *key, size_t *klen) {
+    size_t len = (klen != NULL && *klen > 0) ? *klen : strlen(key);
+    // FNV-1a，再用murmur3的fmix64打散，保证高低位都可用
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) key[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    if (klen != NULL) {
+        *klen = len;
+    }
+    return hash;
+}
+
+hdns_htable_t *hdns_htable_make(hdns_pool_t *pool) {
+    hdns_htable_t *ht = hdns_pcalloc(pool, sizeof(hdns_htable_t));
+    ht->pool = pool;
+    ht->array_pool = NULL;
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->capacity = 0;
+    ht->size = 0;
+    ht->tombstones = 0;
+    return ht;
+}
+
+static int64_t find_slot(const hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash) {
+    if (ht->capacity == 0) {
+        return -1;
+    }
+    size_t group_mask = ht->capacity / HDNS_HTABLE_GROUP_WIDTH - 1;
+    size_t group_index = hdns_htable_h1(hash) & group_mask;
+    int8_t h2 = hdns_htable_h2(hash);
+    for (size_t step = 0; step <= group_mask; step++) {
+        const int8_t *ctrl = ht->ctrl + group_index * HDNS_HTABLE_GROUP_WIDTH;
+        uint64_t group = load_group(ctrl);
+        for (uint64_t match = group_match_h2(group, h2); match != 0; match &= match - 1) {
+            size_t offset = lowest_matched_byte(match);
+            const hdns_htable_slot_t *slot = &ht->slots[group_index * HDNS_HTABLE_GROUP_WIDTH + offset];
+            if (hdns_htable_is_full(ctrl[offset])
+                && slot->hash == hash
+                && slot->klen == klen
+                && memcmp(slot->key, key, klen) == 0) {
+                return (int64_t) (group_index * HDNS_HTABLE_GROUP_WIDTH + offset);
+            }
+        }
+        // 组内存在空槽说明探测链在此终止
+        if (group_match_empty(group)) {
+            return -1;
+        }
+        // 三角数探测，容量为2的幂时可以遍历所有组
+        group_index = (group_index + step + 1) & group_mask;
+    }
+    return -1;
+}
+
+static size_t find_insert_slot(const hdns_htable_t *ht, uint64_t hash) {
+    size_t group_mask = ht->capacity / HDNS_HTABLE_GROUP_WIDTH - 1;
+    size_t group_index = hdns_htable_h1(hash) & group_mask;
+    for (size_t step = 0;; step++) {
+        uint64_t group = load_group(ht->ctrl + group_index * HDNS_HTABLE_GROUP_WIDTH);
+        uint64_t match = group_match_empty_or_deleted(group);
+        if (match != 0) {
+            return group_index * HDNS_HTABLE_GROUP_WIDTH + lowest_matched_byte(match);
+        }
+        group_index = (group_index + step + 1) & group_mask;
+    }
+}
+
+static void rehash(hdns_htable_t *ht, size_t new_capacity) {
+    hdns_pool_new_with_pp(array_pool, ht->pool);
+    int8_t *old_ctrl = ht->ctrl;
+    hdns_htable_slot_t *old_slots = ht->slots;
+    size_t old_capacity = ht->capacity;
+    hdns_pool_t *old_array_pool = ht->array_pool;
+
+    ht->array_pool = array_pool;
+    ht->ctrl = hdns_palloc(array_pool, new_capacity);
+    memset(ht->ctrl, (uint8_t) HDNS_HTABLE_CTRL_EMPTY, new_capacity);
+    ht->slots = hdns_pcalloc(array_pool, new_capacity * sizeof(hdns_htable_slot_t));
+    ht->capacity = new_capacity;
+    ht->tombstones = 0;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!hdns_htable_is_full(old_ctrl[i])) {
+            continue;
+        }
+        size_t index = find_insert_slot(ht, old_slots[i].hash);
+        ht->ctrl[index] = hdns_htable_h2(old_slots[i].hash);
+        ht->slots[index] = old_slots[i];
+    }
+    if (old_array_pool != NULL) {
+        hdns_pool_destroy(old_array_pool);
+    }
+}
+
+static void reserve_for_insert(hdns_htable_t *ht) {
+    if (ht->capacity == 0) {
+        rehash(ht, HDNS_HTABLE_INIT_CAPACITY);
+        return;
+    }
+    if (ht->size + ht->tombstones + 1 <= hdns_htable_max_load(ht->capacity)) {
+        return;
+    }
+    // 墓碑较多时原地重建即可，否则扩容一倍
+    if (ht->size + 1 <= hdns_htable_max_load(ht->capacity) / 2) {
+        rehash(ht, ht->capacity);
+    } else {
+        rehash(ht, ht->capacity * 2);
+    }
+}
+
+void *hdns_htable_set_with_hash(hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash, void *value) {
+    if (NULL == value) {
+        return hdns_htable_remove_with_hash(ht, key, klen, hash);
+    }
+    int64_t found = find_slot(ht, key, klen, hash);
+    if (found >= 0) {
+        hdns_htable_slot_t *slot = &ht->slots[found];
+        void *old_value = slot->value;
+        // 键随值一起替换，旧值释放后键不会悬空
+        slot->key = key;
+        slot->value = value;
+        return old_value;
+    }
+    reserve_for_insert(ht);
+    size_t index = find_insert_slot(ht, hash);
+    if (ht->ctrl[index] == HDNS_HTABLE_CTRL_DELETED) {
+        ht->tombstones--;
+    }
+    ht->ctrl[index] = hdns_htable_h2(hash);
+    hdns_htable_slot_t *slot = &ht->slots[index];
+    slot->hash = hash;
+    slot->key = key;
+    slot->klen = klen;
+    slot->value = value;
+    ht->size++;
+    return NULL;
+}
+
+void *hdns_htable_set(hdns_htable_t *ht, const char *key, void *value) {
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    return hdns_htable_set_with_hash(ht, key, klen, hash, value);
+}
+
+void *hdns_htable_get_with_hash(const hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash) {
+    int64_t found = find_slot(ht, key, klen, hash);
+    return found >= 0 ? ht->slots[found].value : NULL;
+}
+
+void *hdns_htable_get(const hdns_htable_t *ht, const char *key) {
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    return hdns_htable_get_with_hash(ht, key, klen, hash);
+}
+
+void *hdns_htable_remove_with_hash(hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash) {
+    int64_t found = find_slot(ht, key, klen, hash);
+    if (found < 0) {
+        return NULL;
+    }
+    void *old_value = ht->slots[found].value;
+    size_t group_start = (size_t) found & ~((size_t) HDNS_HTABLE_GROUP_WIDTH - 1);
+    // 组内已有空槽时没有探测链经过此组，可以直接置空而不留墓碑
+    if (group_match_empty(load_group(ht->ctrl + group_start))) {
+        ht->ctrl[found] = HDNS_HTABLE_CTRL_EMPTY;
+    } else {
+        ht->ctrl[found] = HDNS_HTABLE_CTRL_DELETED;
+        ht->tombstones++;
+    }
+    ht->slots[found].key = NULL;
+    ht->slots[found].value = NULL;
+    ht->size--;
+    return old_value;
+}
+
+void *hdns_htable_remove(hdns_htable_t *ht, const char *key) {
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    return hdns_htable_remove_with_hash(ht, key, klen, hash);
+}
+
+size_t hdns_htable_count(const hdns_htable_t *ht) {
+    return ht->size;
+}
+
+void hdns_htable_clear(hdns_htable_t *ht) {
+    if (ht->capacity > 0) {
+        memset(ht->ctrl, (uint8_t) HDNS_HTABLE_CTRL_EMPTY, ht->capacity);
+    }
+    ht->size = 0;
+    ht->tombstones = 0;
+}
+
+int hdns_htable_do(hdns_htable_do_fn_t fn, void *rec, const hdns_htable_t *ht) {
+    for (size_t i = 0; i < ht->capacity; i++) {
+        if (!hdns_htable_is_full(ht->ctrl[i])) {
+            continue;
+        }
+        const hdns_htable_slot_t *slot = &ht->slots[i];
+        if (!fn(rec, slot->key, slot->klen, slot->value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int hdns_htable_do_from(hdns_htable_do_fn_t fn, void *rec, const hdns_htable_t *ht, size_t *pos) {
+    for (size_t i = *pos; i < ht->capacity; i++) {
+        if (!hdns_htable_is_full(ht->ctrl[i])) {
+            continue;
+        }
+        const hdns_htable_slot_t *slot = &ht->slots[i];
+        if (!fn(rec, slot->key, slot->klen, slot->value)) {
+            *pos = i + 1;
+            return 0;
+        }
+    }
+    *pos = ht->capacity;
+    return 1;
+}
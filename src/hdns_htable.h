@@ -0,0 +1,83 @@
+//
+// 开放寻址哈希表，参考Swiss Table：每个槽位对应一个控制字节，8个控制字节组成一组，
+// 探测时先按组比较哈希的低7位，再比较槽位内缓存的完整哈希和键长，最后才比较字符串
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_HTABLE_H
+#define HDNS_C_SDK_HDNS_HTABLE_H
+
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+#define HDNS_HTABLE_GROUP_WIDTH  8
+
+typedef struct {
+    uint64_t hash;
+    const char *key;
+    size_t klen;
+    void *value;
+} hdns_htable_slot_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    // 控制字节和槽位数组所在的子pool，扩容时整体替换
+    hdns_pool_t *array_pool;
+    int8_t *ctrl;
+    hdns_htable_slot_t *slots;
+    size_t capacity;
+    size_t size;
+    size_t tombstones;
+} hdns_htable_t;
+
+/*
+ * 返回0表示停止遍历
+ */
+typedef int (*hdns_htable_do_fn_t)(void *rec, const char *key, size_t klen, void *value);
+
+/*
+ * 计算键的哈希，klen为NULL或*klen为0时按字符串计算长度并回写
+ */
+uint64_t hdns_htable_hash(const char *key, size_t *klen);
+
+hdns_htable_t *hdns_htable_make(hdns_pool_t *pool);
+
+/*
+ * 写入键值并返回被替换的旧值，value为NULL时等同于删除；
+ * 键的内存由调用方保证在条目存续期间有效，已存在时键和值一并替换
+ */
+void *hdns_htable_set(hdns_htable_t *ht, const char *key, void *value);
+
+void *hdns_htable_set_with_hash(hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash, void *value);
+
+void *hdns_htable_get(const hdns_htable_t *ht, const char *key);
+
+void *hdns_htable_get_with_hash(const hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash);
+
+/*
+ * 删除并返回原有的值，不存在时返回NULL
+ */
+void *hdns_htable_remove(hdns_htable_t *ht, const char *key);
+
+void *hdns_htable_remove_with_hash(hdns_htable_t *ht, const char *key, size_t klen, uint64_t hash);
+
+size_t hdns_htable_count(const hdns_htable_t *ht);
+
+void hdns_htable_clear(hdns_htable_t *ht);
+
+/*
+ * 遍历期间不能修改哈希表
+ */
+int hdns_htable_do(hdns_htable_do_fn_t fn, void *rec, const hdns_htable_t *ht);
+
+/*
+ * 从槽位*pos开始遍历，fn返回0时在当前槽位之后暂停，*pos更新为下一个待访问的槽位，
+ * 遍历到末尾返回1，暂停返回0；两次调用之间允许修改哈希表，扩容后键可能重复或遗漏
+ */
+int hdns_htable_do_from(hdns_htable_do_fn_t fn, void *rec, const hdns_htable_t *ht, size_t *pos);
+
+HDNS_CPP_END
+
+#endif
@@ -6,6 +6,7 @@
 #include "hdns_net.h"
 #include "hdns_ip.h"
 #include "hdns_utils.h"
+#include "hdns_clock.h"
 
 
 #if defined(__APPLE__) || defined(__linux__)
@@ -131,7 +132,7 @@ static void *APR_THREAD_FUNC hdns_net_speed_detect_runner(apr_thread_t *thread,
             hdns_list_add(sorted_ips, ip, NULL);
             continue;
         }
-        start = apr_time_now();
+        start = hdns_clock_precise_now();
         rv = apr_socket_connect(sock, sa);
         if (rv != APR_SUCCESS) {
             apr_socket_close(sock);
@@ -139,7 +140,7 @@ static void *APR_THREAD_FUNC hdns_net_speed_detect_runner(apr_thread_t *thread,
             continue;
         }
         apr_socket_close(sock);
-        ip->rt = hdns_to_int(apr_time_now() - start);
+        ip->rt = hdns_to_int(hdns_clock_precise_now() - start);
         hdns_list_add(sorted_ips, ip, NULL);
     }
     hdns_list_sort(sorted_ips, hdns_to_list_cmp_fn_t(hdns_ip_cmp));
@@ -386,13 +387,13 @@ void hdns_net_detector_cleanup(hdns_net_detector_t *detector) {
 void hdns_net_type_detector_update_cache(hdns_net_chg_cb_task_t *task) {
     hdns_net_detector_t *detector = task->param;
     hdns_net_type_t net_stack_type;
-    apr_time_t start = apr_time_now();
+    apr_time_t start = hdns_clock_now();
     do {
         net_stack_type = detect_net_stack();
         apr_sleep(APR_USEC_PER_SEC / 2);
         //网络切换后，需要等待一段时间后才能探测到网络栈
     } while (net_stack_type == HDNS_NET_UNKNOWN
-             && apr_time_sec(apr_time_now() - start) < 30
+             && apr_time_sec(hdns_clock_now() - start) < 30
              && !task->stop_signal);
     detector->type_detector->type = net_stack_type;
 }
@@ -0,0 +1,276 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include <apr_atomic.h>
+#include <cjson/cJSON.h>
+#include "hdns_file.h"
+#include "hdns_log.h"
+#include "hdns_utils.h"
+
+#include "hdns_persist.h"
+
+
+static cJSON *create_string_array(const hdns_list_head_t *list) {
+    cJSON *array = cJSON_CreateArray();
+    hdns_list_for_each_entry(cursor, list) {
+        cJSON_AddItemToArray(array, cJSON_CreateString(cursor->data));
+    }
+    return array;
+}
+
+static void parse_string_array(cJSON *array, hdns_list_head_t *list) {
+    if (NULL == array || !cJSON_IsArray(array)) {
+        return;
+    }
+    int size = cJSON_GetArraySize(array);
+    for (int i = 0; i < size; i++) {
+        cJSON *item = cJSON_GetArrayItem(array, i);
+        if (cJSON_IsString(item)) {
+            hdns_list_add(list, item->valuestring, hdns_to_list_clone_fn_t(apr_pstrdup));
+        }
+    }
+}
+
+static APR_INLINE void add_string_to_object(cJSON *object, const char *name, const char *value) {
+    if (value != NULL) {
+        cJSON_AddStringToObject(object, name, value);
+    }
+}
+
+static APR_INLINE char *get_string_from_object(hdns_pool_t *pool, cJSON *object, const char *name) {
+    cJSON *item = cJSON_GetObjectItem(object, name);
+    return cJSON_IsString(item) ? apr_pstrdup(pool, item->valuestring) : NULL;
+}
+
+static cJSON *create_entry_json(const hdns_resv_resp_t *entry) {
+    cJSON *entry_json = cJSON_CreateObject();
+    add_string_to_object(entry_json, "host", entry->host);
+    add_string_to_object(entry_json, "cache_key", entry->cache_key);
+    add_string_to_object(entry_json, "client_ip", entry->client_ip);
+    add_string_to_object(entry_json, "extra", entry->extra);
+    cJSON_AddNumberToObject(entry_json, "type", entry->type);
+    cJSON_AddNumberToObject(entry_json, "ttl", entry->ttl);
+    cJSON_AddNumberToObject(entry_json, "origin_ttl", entry->origin_ttl);
+    // 快照需跨进程重启使用，查询时间换算为日历时间写入；微秒时间戳小于2^53，double可以精确表示
+    cJSON_AddNumberToObject(entry_json, "query_time", (double) hdns_clock_to_wall_time(entry->query_time));
+    cJSON_AddItemToObject(entry_json, "ips", create_string_array(entry->ips));
+    return entry_json;
+}
+
+static hdns_resv_resp_t *parse_entry_json(hdns_pool_t *pool, cJSON *entry_json) {
+    cJSON *type_json = cJSON_GetObjectItem(entry_json, "type");
+    cJSON *ttl_json = cJSON_GetObjectItem(entry_json, "ttl");
+    cJSON *origin_ttl_json = cJSON_GetObjectItem(entry_json, "origin_ttl");
+    cJSON *query_time_json = cJSON_GetObjectItem(entry_json, "query_time");
+    if (!cJSON_IsNumber(type_json)
+        || !cJSON_IsNumber(ttl_json)
+        || !cJSON_IsNumber(origin_ttl_json)
+        || !cJSON_IsNumber(query_time_json)) {
+        return NULL;
+    }
+    if (type_json->valueint != HDNS_RR_TYPE_A && type_json->valueint != HDNS_RR_TYPE_AAAA) {
+        return NULL;
+    }
+    hdns_resv_resp_t *entry = hdns_resv_resp_create_empty(pool,
+                                                          get_string_from_object(pool, entry_json, "host"),
+                                                          type_json->valueint);
+    entry->cache_key = get_string_from_object(pool, entry_json, "cache_key");
+    entry->client_ip = get_string_from_object(pool, entry_json, "client_ip");
+    entry->extra = get_string_from_object(pool, entry_json, "extra");
+    entry->ttl = ttl_json->valueint;
+    entry->origin_ttl = origin_ttl_json->valueint;
+    entry->query_time = hdns_clock_from_wall_time((apr_time_t) query_time_json->valuedouble);
+    parse_string_array(cJSON_GetObjectItem(entry_json, "ips"), entry->ips);
+    if (hdns_str_is_blank(entry->host) || hdns_list_is_empty(entry->ips)) {
+        return NULL;
+    }
+    return entry;
+}
+
+static bool is_entry_too_stale(const hdns_resv_resp_t *entry) {
+    int64_t ttl = entry->origin_ttl > 0 ? entry->origin_ttl : entry->ttl;
+    return entry->query_time + (ttl + HDNS_PERSIST_MAX_STALE_SEC) * APR_USEC_PER_SEC < hdns_clock_now();
+}
+
+hdns_persist_t *hdns_persist_create(hdns_config_t *config,
+                                    hdns_cache_t *cache,
+                                    hdns_scheduler_t *scheduler,
+                                    apr_thread_pool_t *thread_pool) {
+    hdns_pool_new(pool);
+    hdns_persist_t *persist = hdns_palloc(pool, sizeof(hdns_persist_t));
+    persist->pool = pool;
+    persist->config = config;
+    persist->cache = cache;
+    persist->scheduler = scheduler;
+    persist->thread_pool = thread_pool;
+    apr_thread_mutex_lock(config->lock);
+    persist->dir = apr_pstrcat(pool, hdns_get_user_home_dir(pool), "/.httpdns/", config->account_id, NULL);
+    apr_thread_mutex_unlock(config->lock);
+    persist->file_path = apr_pstrcat(pool, persist->dir, "/", HDNS_PERSIST_FILE_NAME, NULL);
+    apr_thread_mutex_create(&persist->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    apr_atomic_set32(&persist->state, HDNS_STATE_INIT);
+    return persist;
+}
+
+int32_t hdns_persist_save(hdns_persist_t *persist) {
+    if (NULL == persist) {
+        return HDNS_ERROR;
+    }
+    hdns_pool_new(pool);
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "version", HDNS_PERSIST_VERSION);
+    apr_thread_mutex_lock(persist->config->lock);
+    cJSON_AddStringToObject(root, "region", persist->config->region);
+    apr_thread_mutex_unlock(persist->config->lock);
+
+    hdns_list_head_t *ipv4_resolvers = hdns_scheduler_get_resolvers(persist->scheduler, true);
+    hdns_list_head_t *ipv6_resolvers = hdns_scheduler_get_resolvers(persist->scheduler, false);
+    cJSON_AddItemToObject(root, "ipv4_resolvers", create_string_array(ipv4_resolvers));
+    cJSON_AddItemToObject(root, "ipv6_resolvers", create_string_array(ipv6_resolvers));
+    hdns_list_free(ipv4_resolvers);
+    hdns_list_free(ipv6_resolvers);
+
+    // 序列化在缓存锁外进行，条目是只读共享的
+    cJSON *entries_json = cJSON_CreateArray();
+    hdns_list_head_t *entries = hdns_cache_get_entries(persist->cache);
+    int32_t entry_count = 0;
+    hdns_list_for_each_entry(cursor, entries) {
+        hdns_resv_resp_t *entry = cursor->data;
+        if (entry->from_localdns || is_entry_too_stale(entry)) {
+            continue;
+        }
+        cJSON_AddItemToArray(entries_json, create_entry_json(entry));
+        entry_count++;
+    }
+    hdns_list_free(entries);
+    cJSON_AddItemToObject(root, "cache", entries_json);
+
+    char *content = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (NULL == content) {
+        hdns_pool_destroy(pool);
+        return HDNS_ERROR;
+    }
+
+    apr_thread_mutex_lock(persist->lock);
+    int32_t ret = HDNS_ERROR;
+    // 先写唯一命名的临时文件再重命名，避免进程中途退出或多个进程同时保存时留下不完整的快照
+    if (hdns_file_create_dir(apr_pstrcat(pool, hdns_get_user_home_dir(pool), "/.httpdns", NULL)) == HDNS_OK
+        && hdns_file_create_dir(persist->dir) == HDNS_OK
+        && hdns_file_write_atomic(persist->file_path, content) == HDNS_OK) {
+        ret = HDNS_OK;
+    }
+    apr_thread_mutex_unlock(persist->lock);
+    cJSON_free(content);
+    hdns_pool_destroy(pool);
+
+    if (ret == HDNS_OK) {
+        hdns_log_debug("save cache snapshot to %s, entries:%d", persist->file_path, entry_count);
+    } else {
+        hdns_log_info("save cache snapshot to %s failed", persist->file_path);
+    }
+    return ret;
+}
+
+int32_t hdns_persist_load(hdns_persist_t *persist) {
+    if (NULL == persist) {
+        return HDNS_ERROR;
+    }
+    hdns_pool_new(pool);
+    apr_thread_mutex_lock(persist->lock);
+    char *content = hdns_file_read(persist->file_path, pool);
+    apr_thread_mutex_unlock(persist->lock);
+    cJSON *root = hdns_str_is_blank(content) ? NULL : cJSON_Parse(content);
+    if (NULL == root) {
+        hdns_log_info("no valid cache snapshot in %s", persist->file_path);
+        hdns_pool_destroy(pool);
+        return HDNS_ERROR;
+    }
+    cJSON *version_json = cJSON_GetObjectItem(root, "version");
+    char *region = get_string_from_object(pool, root, "region");
+    apr_thread_mutex_lock(persist->config->lock);
+    bool region_matched = region != NULL && strcmp(region, persist->config->region) == 0;
+    apr_thread_mutex_unlock(persist->config->lock);
+    // 集群切换后服务IP和解析结果都不再适用
+    if (!cJSON_IsNumber(version_json) || version_json->valueint != HDNS_PERSIST_VERSION || !region_matched) {
+        hdns_log_info("cache snapshot in %s is outdated, ignore it", persist->file_path);
+        cJSON_Delete(root);
+        hdns_pool_destroy(pool);
+        return HDNS_ERROR;
+    }
+
+    hdns_list_head_t *ipv4_resolvers = hdns_list_new(pool);
+    hdns_list_head_t *ipv6_resolvers = hdns_list_new(pool);
+    parse_string_array(cJSON_GetObjectItem(root, "ipv4_resolvers"), ipv4_resolvers);
+    parse_string_array(cJSON_GetObjectItem(root, "ipv6_resolvers"), ipv6_resolvers);
+    hdns_scheduler_set_resolvers(persist->scheduler, ipv4_resolvers, true);
+    hdns_scheduler_set_resolvers(persist->scheduler, ipv6_resolvers, false);
+
+    int32_t entry_count = 0;
+    cJSON *entries_json = cJSON_GetObjectItem(root, "cache");
+    int size = cJSON_IsArray(entries_json) ? cJSON_GetArraySize(entries_json) : 0;
+    for (int i = 0; i < size; i++) {
+        hdns_resv_resp_t *entry = parse_entry_json(pool, cJSON_GetArrayItem(entries_json, i));
+        if (NULL == entry || is_entry_too_stale(entry)) {
+            continue;
+        }
+        hdns_cache_table_add(persist->cache, entry);
+        entry_count++;
+    }
+    cJSON_Delete(root);
+    hdns_pool_destroy(pool);
+    hdns_log_info("load cache snapshot from %s, entries:%d", persist->file_path, entry_count);
+    return HDNS_OK;
+}
+
+static void *APR_THREAD_FUNC hdns_persist_timer_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    hdns_persist_t *persist = data;
+    if (apr_atomic_read32(&persist->state) != HDNS_STATE_RUNNING) {
+        return NULL;
+    }
+    hdns_persist_save(persist);
+    apr_thread_mutex_lock(persist->lock);
+    if (apr_atomic_read32(&persist->state) == HDNS_STATE_RUNNING) {
+        apr_thread_pool_schedule(persist->thread_pool,
+                                 hdns_persist_timer_task,
+                                 persist,
+                                 apr_time_from_sec(HDNS_PERSIST_INTERVAL_SEC),
+                                 persist);
+    }
+    apr_thread_mutex_unlock(persist->lock);
+    return NULL;
+}
+
+hdns_status_t hdns_persist_start_timer(hdns_persist_t *persist) {
+    apr_atomic_set32(&persist->state, HDNS_STATE_RUNNING);
+    apr_status_t status = apr_thread_pool_schedule(persist->thread_pool,
+                                                   hdns_persist_timer_task,
+                                                   persist,
+                                                   apr_time_from_sec(HDNS_PERSIST_INTERVAL_SEC),
+                                                   persist);
+    if (status != APR_SUCCESS) {
+        apr_atomic_set32(&persist->state, HDNS_STATE_INIT);
+        return hdns_status_error(HDNS_RESOLVE_FAIL, HDNS_RESOLVE_FAIL_CODE, "Submit task failed",
+                                 persist->config->session_id);
+    }
+    return hdns_status_ok(persist->config->session_id);
+}
+
+void hdns_persist_stop(hdns_persist_t *persist) {
+    if (persist != NULL) {
+        apr_atomic_set32(&persist->state, HDNS_STATE_STOPPING);
+        // 正在续期的任务完成提交后再取消，之后运行中的任务看到已停止，不会再续期
+        apr_thread_mutex_lock(persist->lock);
+        apr_thread_mutex_unlock(persist->lock);
+        apr_thread_pool_tasks_cancel(persist->thread_pool, persist);
+    }
+}
+
+void hdns_persist_cleanup(hdns_persist_t *persist) {
+    if (persist != NULL) {
+        hdns_persist_stop(persist);
+        apr_thread_mutex_destroy(persist->lock);
+        hdns_pool_destroy(persist->pool);
+    }
+}
@@ -0,0 +1,67 @@
+//
+// 缓存持久化，定期及客户端关闭时将解析缓存和解析服务IP列表写入磁盘，
+// 客户端启动时加载，进程重启后的首批请求可以直接命中缓存
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_PERSIST_H
+#define HDNS_C_SDK_HDNS_PERSIST_H
+
+#include "apr_thread_pool.h"
+
+#include "hdns_cache.h"
+#include "hdns_config.h"
+#include "hdns_scheduler.h"
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+#define HDNS_PERSIST_FILE_NAME        "cache.json"
+#define HDNS_PERSIST_VERSION          1
+// 定期写入快照的间隔
+#define HDNS_PERSIST_INTERVAL_SEC     60
+// 过期超过该时长的条目加载时直接丢弃
+#define HDNS_PERSIST_MAX_STALE_SEC    (24 * 60 * 60)
+
+typedef struct {
+    hdns_pool_t *pool;
+    char *dir;
+    char *file_path;
+    hdns_config_t *config;
+    hdns_cache_t *cache;
+    hdns_scheduler_t *scheduler;
+    apr_thread_pool_t *thread_pool;
+    // 定时任务和关闭时的写入互斥，同时串行化定时任务的续期和停止
+    apr_thread_mutex_t *lock;
+    // hdns_state_e，由定时任务和关闭线程并发读写，通过apr_atomic_*32访问
+    volatile apr_uint32_t state;
+} hdns_persist_t;
+
+/*
+ * 快照位于 ~/.httpdns/<account_id>/cache.json
+ */
+hdns_persist_t *hdns_persist_create(hdns_config_t *config,
+                                    hdns_cache_t *cache,
+                                    hdns_scheduler_t *scheduler,
+                                    apr_thread_pool_t *thread_pool);
+
+/*
+ * 加载快照，剩余TTL按原查询时间计算，已过期的条目作为过期IP保留，由enable_expired_ip决定是否使用
+ */
+int32_t hdns_persist_load(hdns_persist_t *persist);
+
+int32_t hdns_persist_save(hdns_persist_t *persist);
+
+hdns_status_t hdns_persist_start_timer(hdns_persist_t *persist);
+
+/*
+ * 停止定时写入，等待正在执行的写入完成
+ */
+void hdns_persist_stop(hdns_persist_t *persist);
+
+void hdns_persist_cleanup(hdns_persist_t *persist);
+
+HDNS_CPP_END
+
+#endif
@@ -1,14 +1,20 @@
 //
 // Created by caogaoshuai on 2024/1/18.
 //
+#include <apr_thread_proc.h>
 #include <cjson/cJSON.h>
 #include "hdns_log.h"
 #include "hdns_sign.h"
 #include "hdns_http.h"
 #include "hdns_buf.h"
+#include "hdns_clock.h"
 
 #include "hdns_resolver.h"
 
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#endif
+
 #define  HDNS_API_D                   "/d"
 #define  HDNS_API_SIGN_D              "/sign_d"
 #define  HDNS_API_RESOLVE             "/resolve"
@@ -18,6 +24,60 @@
 #define  HDNS_QUERY_TYPE_AAAA     "6"
 #define  HDNS_QUERY_TYPE_BOTH   "4,6"
 
+// 未指定pool时格式化结果使用的线程本地pool
+static apr_threadkey_t *g_hdns_resv_str_pool_key = NULL;
+
+static void destroy_str_pool(void *data) {
+    if (data != NULL) {
+        apr_pool_destroy(data);
+    }
+}
+
+int hdns_resolver_init(hdns_pool_t *parent_pool) {
+    if (apr_threadkey_private_create(&g_hdns_resv_str_pool_key, destroy_str_pool, parent_pool) != APR_SUCCESS) {
+        g_hdns_resv_str_pool_key = NULL;
+        return HDNS_ERROR;
+    }
+    return HDNS_OK;
+}
+
+void hdns_resolver_cleanup() {
+    if (NULL == g_hdns_resv_str_pool_key) {
+        return;
+    }
+    // 其他线程的pool在线程退出时释放，这里只释放当前线程的
+    void *pool = NULL;
+    apr_threadkey_private_get(&pool, g_hdns_resv_str_pool_key);
+    apr_threadkey_private_set(NULL, g_hdns_resv_str_pool_key);
+    destroy_str_pool(pool);
+    apr_threadkey_private_delete(g_hdns_resv_str_pool_key);
+    g_hdns_resv_str_pool_key = NULL;
+}
+
+/*
+ * 当前线程的临时pool，每次取得时清空；不挂在全局pool下，线程退出时独立释放
+ */
+static hdns_pool_t *get_thread_str_pool() {
+    void *pool = NULL;
+    if (NULL == g_hdns_resv_str_pool_key
+        || apr_threadkey_private_get(&pool, g_hdns_resv_str_pool_key) != APR_SUCCESS) {
+        return NULL;
+    }
+    if (pool != NULL) {
+        apr_pool_clear(pool);
+        return pool;
+    }
+    hdns_pool_t *created = NULL;
+    if (apr_pool_create_unmanaged_ex(&created, NULL, NULL) != APR_SUCCESS) {
+        return NULL;
+    }
+    if (apr_threadkey_private_set(created, g_hdns_resv_str_pool_key) != APR_SUCCESS) {
+        apr_pool_destroy(created);
+        return NULL;
+    }
+    return created;
+}
+
 static const char *hdns_query_type_to_string(hdns_query_type_t query_type_e) {
     switch (query_type_e) {
         case HDNS_QUERY_IPV4:
@@ -119,7 +179,7 @@ static void parse_resv_resp_from_json(hdns_list_head_t *resv_resps, cJSON *c_jso
     } else {
         resv_resp->cache_key = apr_pstrdup(resv_resp->pool, resv_resp->host);
     }
-    resv_resp->query_time = apr_time_now();
+    resv_resp->query_time = hdns_clock_now();
 
     bool ips_exist = (cJSON_GetObjectItem(c_json_body, "ips") != NULL);
     bool ipsv6_exist = (cJSON_GetObjectItem(c_json_body, "ipsv6") != NULL);
@@ -181,6 +241,8 @@ static int parse_multi_resv_resp(const char *body, hdns_list_head_t *resv_resps)
         }
     } else {
         hdns_log_info("parse multi resolve failed, body is %s", body);
+        cJSON_Delete(c_json_body);
+        return HDNS_ERROR;
     }
     cJSON_Delete(c_json_body);
     return HDNS_OK;
@@ -222,16 +284,50 @@ hdns_http_response_t *hdns_resv_send_req(hdns_pool_t *req_pool, hdns_resv_req_t
     return http_resp;
 }
 
-void hdns_parse_resv_resp(hdns_resv_req_t *resv_req,
-                          hdns_http_response_t *http_resp,
-                          hdns_pool_t *pool,
-                          hdns_list_head_t *resv_resps) {
+int32_t hdns_parse_resv_resp(hdns_resv_req_t *resv_req,
+                             hdns_http_response_t *http_resp,
+                             hdns_pool_t *pool,
+                             hdns_list_head_t *resv_resps) {
     char *body = hdns_buf_list_content(pool, http_resp->body);
     if (resv_req->using_multi) {
-        parse_multi_resv_resp(body, resv_resps);
-    } else {
-        parse_single_resv_resp(body, resv_resps, resv_req->cache_key);
+        return parse_multi_resv_resp(body, resv_resps);
+    }
+    return parse_single_resv_resp(body, resv_resps, resv_req->cache_key);
+}
+
+static APR_INLINE uint64_t fnv1a_update(uint64_t hash, const char *str) {
+    for (const unsigned char *p = (const unsigned char *) str; p != NULL && *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= UINT64_C(1099511628211);
+    }
+    // 结尾的'\0'同样参与哈希，作为字段分隔符，避免"a=b"+"c"与"a"+"b=c"等拼接歧义
+    hash *= UINT64_C(1099511628211);
+    return hash;
+}
+
+static APR_INLINE uint64_t fmix64(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return hash;
+}
+
+char *hdns_resv_req_sdns_cache_key(hdns_pool_t *pool, const hdns_resv_req_t *req) {
+    if (hdns_str_is_blank(req->host) || NULL == req->sdns_params || hdns_is_empty_table(req->sdns_params)) {
+        return NULL;
     }
+    const hdns_array_header_t *params = hdns_table_elts(req->sdns_params);
+    const apr_table_entry_t *entries = (const apr_table_entry_t *) params->elts;
+    // 每个参数单独哈希、打散后相加，结果与参数顺序无关，且无需拼接字符串；仅保证顺序无关，不等价于对排序后的参数求哈希
+    uint64_t digest = 0;
+    for (int i = 0; i < params->nelts; i++) {
+        uint64_t hash = fnv1a_update(UINT64_C(14695981039346656037), entries[i].key);
+        hash = fnv1a_update(hash, entries[i].val);
+        digest += fmix64(hash);
+    }
+    return apr_psprintf(pool, "%s" HDNS_SDNS_CACHE_KEY_SEPARATOR "%016" APR_UINT64_T_HEX_FMT, req->host, digest);
 }
 
 hdns_resv_req_t *hdns_resv_req_new(hdns_pool_t *pool, hdns_config_t *config) {
@@ -270,6 +366,7 @@ hdns_resv_resp_t *hdns_resv_resp_clone(hdns_pool_t *pool, const hdns_resv_resp_t
     }
     hdns_resv_resp_t *new_resp = hdns_palloc(pool, sizeof(hdns_resv_resp_t));
     new_resp->pool = pool;
+    new_resp->slab = NULL;
     new_resp->host = apr_pstrdup(pool, origin_resp->host);
     new_resp->client_ip = apr_pstrdup(pool, origin_resp->client_ip);
     new_resp->extra = apr_pstrdup(pool, origin_resp->extra);
@@ -281,13 +378,183 @@ hdns_resv_resp_t *hdns_resv_resp_clone(hdns_pool_t *pool, const hdns_resv_resp_t
     new_resp->cache_key = apr_pstrdup(pool, origin_resp->cache_key);
     new_resp->type = origin_resp->type;
     new_resp->from_localdns = origin_resp->from_localdns;
+    apr_atomic_set32(&new_resp->ref_count, 1);
+    apr_atomic_set32(&new_resp->prefetching, 0);
+    apr_atomic_set32(&new_resp->expiry_state, 0);
+    hdns_resv_resp_pack_addrs(new_resp);
     return new_resp;
 }
 
+static APR_INLINE size_t addr_size(hdns_rr_type_t type) {
+    return type == HDNS_RR_TYPE_AAAA ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+}
+
+static APR_INLINE size_t str_size(const char *str) {
+    return str != NULL ? strlen(str) + 1 : 0;
+}
+
+static char *copy_str(char **cursor, const char *str) {
+    if (NULL == str) {
+        return NULL;
+    }
+    size_t size = strlen(str) + 1;
+    char *dst = memcpy(*cursor, str, size);
+    *cursor += size;
+    return dst;
+}
+
+hdns_resv_resp_t *hdns_resv_resp_clone_to_slab(hdns_slab_t *slab, const hdns_resv_resp_t *origin_resp) {
+    size_t count = hdns_list_size(origin_resp->ips);
+    // 布局：结构体、链表头、链表节点、二进制地址、字符串
+    size_t addrs_offset = sizeof(hdns_resv_resp_t) + sizeof(hdns_list_head_t) + count * sizeof(hdns_list_node_t);
+    size_t strs_offset = addrs_offset + count * addr_size(origin_resp->type);
+    size_t size = strs_offset + str_size(origin_resp->host) + str_size(origin_resp->client_ip)
+                  + str_size(origin_resp->extra) + str_size(origin_resp->cache_key);
+    if (count > 0) {
+        hdns_list_for_each_entry(cursor, origin_resp->ips) {
+            size += str_size(cursor->data);
+        }
+    }
+    char *block = hdns_slab_alloc(slab, size);
+    if (NULL == block) {
+        return NULL;
+    }
+    hdns_resv_resp_t *new_resp = (hdns_resv_resp_t *) block;
+    char *strs = block + strs_offset;
+    new_resp->pool = NULL;
+    new_resp->slab = slab;
+    new_resp->host = copy_str(&strs, origin_resp->host);
+    new_resp->client_ip = copy_str(&strs, origin_resp->client_ip);
+    new_resp->extra = copy_str(&strs, origin_resp->extra);
+    new_resp->cache_key = copy_str(&strs, origin_resp->cache_key);
+    // 链表头不带pool，缓存条目只读，不允许再追加节点
+    hdns_list_head_t *ips = (hdns_list_head_t *) (block + sizeof(hdns_resv_resp_t));
+    ips->pool = NULL;
+    ips->data = NULL;
+    ips->next = ips;
+    ips->prev = ips;
+    hdns_list_node_t *node = ips + 1;
+    if (count > 0) {
+        hdns_list_for_each_entry(cursor, origin_resp->ips) {
+            node->pool = NULL;
+            node->data = copy_str(&strs, cursor->data);
+            hdns_list_insert_tail(node, ips);
+            node++;
+        }
+    }
+    new_resp->ips = ips;
+    new_resp->query_time = origin_resp->query_time;
+    new_resp->ttl = origin_resp->ttl;
+    new_resp->origin_ttl = origin_resp->origin_ttl;
+    new_resp->type = origin_resp->type;
+    new_resp->from_localdns = origin_resp->from_localdns;
+    apr_atomic_set32(&new_resp->ref_count, 1);
+    apr_atomic_set32(&new_resp->prefetching, 0);
+    apr_atomic_set32(&new_resp->expiry_state, 0);
+
+    int family = new_resp->type == HDNS_RR_TYPE_AAAA ? AF_INET6 : AF_INET;
+    uint8_t *addrs = (uint8_t *) block + addrs_offset;
+    uint32_t addr_count = 0;
+    hdns_list_for_each_entry(cursor, ips) {
+        if (inet_pton(family, cursor->data, addrs + addr_size(new_resp->type) * addr_count) == 1) {
+            addr_count++;
+        }
+    }
+    new_resp->addrs = addr_count > 0 ? addrs : NULL;
+    new_resp->addr_count = addr_count;
+    return new_resp;
+}
+
+void hdns_resv_resp_pack_addrs(hdns_resv_resp_t *resp) {
+    resp->addrs = NULL;
+    resp->addr_count = 0;
+    int count = hdns_list_size(resp->ips);
+    if (count <= 0) {
+        return;
+    }
+    int family = resp->type == HDNS_RR_TYPE_AAAA ? AF_INET6 : AF_INET;
+    size_t size = addr_size(resp->type);
+    uint8_t *addrs = hdns_palloc(resp->pool, size * count);
+    uint32_t addr_count = 0;
+    hdns_list_for_each_entry(cursor, resp->ips) {
+        if (inet_pton(family, cursor->data, addrs + size * addr_count) == 1) {
+            addr_count++;
+        }
+    }
+    resp->addrs = addrs;
+    resp->addr_count = addr_count;
+}
+
+static void fill_sockaddr(hdns_rr_type_t type, const void *addr, uint16_t port, struct sockaddr_storage *storage) {
+    memset(storage, 0, sizeof(struct sockaddr_storage));
+    if (type == HDNS_RR_TYPE_AAAA) {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) storage;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(port);
+        memcpy(&sin6->sin6_addr, addr, sizeof(struct in6_addr));
+    } else {
+        struct sockaddr_in *sin = (struct sockaddr_in *) storage;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        memcpy(&sin->sin_addr, addr, sizeof(struct in_addr));
+    }
+}
+
+int hdns_resv_resp_to_sockaddrs(const hdns_resv_resp_t *resp,
+                                uint16_t port,
+                                struct sockaddr_storage *addrs,
+                                int max_count) {
+    int count = 0;
+    size_t size = addr_size(resp->type);
+    if (resp->addrs != NULL) {
+        for (uint32_t i = 0; i < resp->addr_count && count < max_count; i++) {
+            fill_sockaddr(resp->type, (const uint8_t *) resp->addrs + size * i, port, &addrs[count++]);
+        }
+        return count;
+    }
+    // 未生成二进制地址的结果（如localdns降级结果）按字符串解析
+    int family = resp->type == HDNS_RR_TYPE_AAAA ? AF_INET6 : AF_INET;
+    struct in6_addr addr;
+    hdns_list_for_each_entry(cursor, resp->ips) {
+        if (count >= max_count) {
+            break;
+        }
+        if (inet_pton(family, cursor->data, &addr) == 1) {
+            fill_sockaddr(resp->type, &addr, port, &addrs[count++]);
+        }
+    }
+    return count;
+}
+
 void hdns_resv_resp_destroy(hdns_resv_resp_t *resp) {
+    if (resp != NULL && !apr_atomic_dec32(&resp->ref_count)) {
+        if (resp->slab != NULL) {
+            hdns_slab_free(resp->slab, resp);
+        } else {
+            hdns_pool_destroy(resp->pool);
+        }
+    }
+}
+
+hdns_resv_resp_t *hdns_resv_resp_retain(hdns_resv_resp_t *resp) {
     if (resp != NULL) {
-        hdns_pool_destroy(resp->pool);
+        apr_atomic_inc32(&resp->ref_count);
     }
+    return resp;
+}
+
+static apr_status_t hdns_resv_resp_release_cleanup(void *data) {
+    hdns_resv_resp_destroy(data);
+    return APR_SUCCESS;
+}
+
+hdns_resv_resp_t *hdns_resv_resp_share(hdns_pool_t *pool, hdns_resv_resp_t *resp) {
+    if (NULL == pool || NULL == resp) {
+        return resp;
+    }
+    hdns_resv_resp_retain(resp);
+    apr_pool_cleanup_register(pool, resp, hdns_resv_resp_release_cleanup, apr_pool_cleanup_null);
+    return resp;
 }
 
 hdns_status_t hdns_resv_req_valid(const hdns_resv_req_t *req) {
@@ -337,6 +604,7 @@ hdns_resv_resp_t *hdns_resv_resp_create_empty(hdns_pool_t *pool, const char *hos
     }
     hdns_resv_resp_t *resv_resp = hdns_palloc(pool, sizeof(hdns_resv_resp_t));
     resv_resp->pool = pool;
+    resv_resp->slab = NULL;
     resv_resp->host = apr_pstrdup(pool, host);
     resv_resp->ips = hdns_list_new(pool);
     resv_resp->client_ip = NULL;
@@ -344,13 +612,21 @@ hdns_resv_resp_t *hdns_resv_resp_create_empty(hdns_pool_t *pool, const char *hos
     resv_resp->type = type;
     resv_resp->origin_ttl = 60;
     resv_resp->ttl = 60;
-    resv_resp->query_time = apr_time_now();
+    resv_resp->query_time = hdns_clock_now();
     resv_resp->cache_key = NULL;
     resv_resp->from_localdns = false;
+    apr_atomic_set32(&resv_resp->ref_count, 1);
+    apr_atomic_set32(&resv_resp->prefetching, 0);
+    apr_atomic_set32(&resv_resp->expiry_state, 0);
+    resv_resp->addrs = NULL;
+    resv_resp->addr_count = 0;
     return resv_resp;
 }
 
 char *hdns_resv_resp_to_str(hdns_pool_t *pool, hdns_resv_resp_t *resp) {
+    if (NULL == pool && resp != NULL) {
+        pool = get_thread_str_pool();
+    }
     if (pool == NULL || resp == NULL) {
         return "hdns_resv_resp_t()";
     }
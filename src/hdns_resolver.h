@@ -8,10 +8,21 @@
 #define HDNS_C_SDK_HDNS_RESOLVER_H
 
 
+#include <apr_atomic.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
 #include "hdns_http.h"
 #include "hdns_config.h"
 #include "hdns_scheduler.h"
 #include "hdns_status.h"
+#include "hdns_slab.h"
 
 #include "hdns_define.h"
 
@@ -27,8 +38,14 @@ typedef enum {
     HDNS_RR_TYPE_AAAA = 28
 } hdns_rr_type_t;
 
+/*
+ * 解析结果。从缓存取得的条目（hdns_cache_table_get及结果列表中共享的条目）整体分配在slab上，
+ * pool为NULL且只读，不能在resp->pool上追加字段
+ */
 typedef struct {
+    // 缓存中的条目整体分配在slab上，此时pool为NULL
     hdns_pool_t *pool;
+    hdns_slab_t *slab;
     char *host;
     char *client_ip;
     char *extra;
@@ -36,9 +53,20 @@ typedef struct {
     hdns_rr_type_t type;
     int origin_ttl;
     int ttl;
+    // 查询时间，取自hdns_clock_now()的单调时间（微秒），只能用于比较和计算间隔，不是日历时间；
+    // 需要日历时间时通过hdns_clock_to_wall_time换算
     int64_t query_time;
     char *cache_key;
     bool from_localdns;
+    // 引用计数，缓存中的条目只读共享，计数归零时才释放pool
+    volatile apr_uint32_t ref_count;
+    // 是否已提交后台预取，避免同一条目重复刷新
+    volatile apr_uint32_t prefetching;
+    // 缓存时间轮维护的过期状态，取值见hdns_cache_entry_state_e
+    volatile apr_uint32_t expiry_state;
+    // 二进制地址，按type连续存放in_addr或in6_addr，建连时无需再解析字符串
+    void *addrs;
+    uint32_t addr_count;
 } hdns_resv_resp_t;
 
 typedef void (*hdns_resv_resp_cb_fn_t)(const hdns_resv_resp_t *resp, void *param);
@@ -66,6 +94,12 @@ typedef struct {
     apr_thread_mutex_t *lock;
 } hdns_resv_req_t;
 
+/*
+ * 创建格式化结果使用的线程本地pool的键，由hdns_sdk_init调用
+ */
+int hdns_resolver_init(hdns_pool_t *parent_pool);
+
+void hdns_resolver_cleanup();
 
 hdns_resv_resp_t *hdns_resv_resp_create_empty(hdns_pool_t *pool, const char *host, hdns_rr_type_t type);
 
@@ -77,17 +111,61 @@ void hdns_resv_req_free(hdns_resv_req_t *req);
 
 hdns_resv_req_t *hdns_resv_req_clone(hdns_pool_t *pool, const hdns_resv_req_t *origin_req);
 
+/*
+ * 根据host和sdns_params派生缓存键，格式为host#参数哈希，参数顺序不影响结果；没有SDNS参数时返回NULL
+ */
+char *hdns_resv_req_sdns_cache_key(hdns_pool_t *pool, const hdns_resv_req_t *req);
+
 hdns_http_response_t *hdns_resv_send_req(hdns_pool_t *req_pool, hdns_resv_req_t *resv_req);
 
 hdns_resv_resp_t *hdns_resv_resp_clone(hdns_pool_t *pool, const hdns_resv_resp_t *origin_resp);
 
-void hdns_resv_resp_destroy(hdns_resv_resp_t *resp);
+/*
+ * 将结果整体拷贝到slab的一个块中，供缓存长期持有；
+ * 结果过大超出slab最大块时返回NULL，由调用方改用hdns_resv_resp_clone
+ */
+hdns_resv_resp_t *hdns_resv_resp_clone_to_slab(hdns_slab_t *slab, const hdns_resv_resp_t *origin_resp);
 
-void hdns_parse_resv_resp(hdns_resv_req_t *resv_req,
-                          hdns_http_response_t *http_resp,
-                          hdns_pool_t *pool,
-                          hdns_list_head_t *resv_resps);
+/*
+ * 释放一次引用，引用计数归零时销毁resp->pool，slab上的条目归还到slab
+ */
+void hdns_resv_resp_destroy(hdns_resv_resp_t *resp);
 
+/*
+ * 增加一次引用，返回同一个resp
+ */
+hdns_resv_resp_t *hdns_resv_resp_retain(hdns_resv_resp_t *resp);
+
+/*
+ * 将resp的一次引用挂到pool上，pool销毁时自动释放，签名与hdns_list_clone_fn_t一致
+ */
+hdns_resv_resp_t *hdns_resv_resp_share(hdns_pool_t *pool, hdns_resv_resp_t *resp);
+
+/*
+ * 根据ips生成二进制地址，无法解析的IP跳过
+ */
+void hdns_resv_resp_pack_addrs(hdns_resv_resp_t *resp);
+
+/*
+ * 将地址写入sockaddr_storage数组，返回写入个数
+ */
+int hdns_resv_resp_to_sockaddrs(const hdns_resv_resp_t *resp,
+                                uint16_t port,
+                                struct sockaddr_storage *addrs,
+                                int max_count);
+
+/*
+ * 解析服务端响应，响应体不是合法JSON时返回HDNS_ERROR
+ */
+int32_t hdns_parse_resv_resp(hdns_resv_req_t *resv_req,
+                             hdns_http_response_t *http_resp,
+                             hdns_pool_t *pool,
+                             hdns_list_head_t *resv_resps);
+
+/*
+ * 在pool上格式化resp；pool为NULL时（如传入缓存条目的resp->pool）使用当前线程的临时pool，
+ * 结果在同一线程下一次以NULL调用前有效
+ */
 char *hdns_resv_resp_to_str(hdns_pool_t *pool, hdns_resv_resp_t *resp);
 
 
@@ -8,6 +8,7 @@
 #include "hdns_buf.h"
 #include "hdns_ip.h"
 #include "hdns_utils.h"
+#include "hdns_clock.h"
 
 #include "hdns_scheduler.h"
 
@@ -97,7 +98,7 @@ hdns_scheduler_t *hdns_scheduler_create(hdns_config_t *config,
     scheduler->cur_ipv6_resolver_index = 0;
     apr_thread_mutex_create(&scheduler->lock, APR_THREAD_MUTEX_DEFAULT, pool);
     scheduler->state = HDNS_STATE_RUNNING;
-    scheduler->next_timer_refresh_time = apr_time_now();
+    scheduler->next_timer_refresh_time = hdns_clock_now();
     scheduler->is_refreshed = false;
     return scheduler;
 }
@@ -219,11 +220,11 @@ static void *APR_THREAD_FUNC hdns_sched_refresh_timer_task(apr_thread_t *thread,
     hdns_sched_refresh_task_param_t *param = data;
     hdns_scheduler_t *scheduler = param->scheduler;
     while (scheduler->state != HDNS_STATE_STOPPING) {
-        if (apr_time_now() > scheduler->next_timer_refresh_time) {
+        if (hdns_clock_now() > scheduler->next_timer_refresh_time) {
             hdns_scheduler_refresh_resolvers(scheduler);
             scheduler->next_timer_refresh_time = (scheduler->is_refreshed ?
-                                                  (apr_time_now() + 6 * 60 * 60 * APR_USEC_PER_SEC) :
-                                                  (apr_time_now() + 5 * 60 * APR_USEC_PER_SEC));
+                                                  (hdns_clock_now() + 6 * 60 * 60 * APR_USEC_PER_SEC) :
+                                                  (hdns_clock_now() + 5 * 60 * APR_USEC_PER_SEC));
         }
         apr_sleep(APR_USEC_PER_SEC / 2);
     }
@@ -387,6 +388,39 @@ void hdns_scheduler_failover(hdns_scheduler_t *scheduler, const char *server) {
     apr_thread_mutex_unlock(scheduler->lock);
 }
 
+hdns_list_head_t *hdns_scheduler_get_resolvers(hdns_scheduler_t *scheduler, bool ipv4) {
+    hdns_list_head_t *resolvers = hdns_list_new(NULL);
+    apr_thread_mutex_lock(scheduler->lock);
+    hdns_list_dup(resolvers,
+                  ipv4 ? scheduler->ipv4_resolvers : scheduler->ipv6_resolvers,
+                  hdns_to_list_clone_fn_t(apr_pstrdup));
+    apr_thread_mutex_unlock(scheduler->lock);
+    return resolvers;
+}
+
+void hdns_scheduler_set_resolvers(hdns_scheduler_t *scheduler, const hdns_list_head_t *resolvers, bool ipv4) {
+    hdns_list_head_t *new_resolvers = hdns_list_new(NULL);
+    hdns_list_filter(new_resolvers,
+                     resolvers,
+                     hdns_to_list_clone_fn_t(apr_pstrdup),
+                     ipv4 ? hdns_to_list_filter_fn_t(hdns_is_valid_ipv4) : hdns_to_list_filter_fn_t(hdns_is_valid_ipv6));
+    if (hdns_list_is_empty(new_resolvers)) {
+        hdns_list_free(new_resolvers);
+        return;
+    }
+    apr_thread_mutex_lock(scheduler->lock);
+    if (ipv4) {
+        hdns_list_free(scheduler->ipv4_resolvers);
+        scheduler->ipv4_resolvers = new_resolvers;
+        scheduler->cur_ipv4_resolver_index = 0;
+    } else {
+        hdns_list_free(scheduler->ipv6_resolvers);
+        scheduler->ipv6_resolvers = new_resolvers;
+        scheduler->cur_ipv6_resolver_index = 0;
+    }
+    apr_thread_mutex_unlock(scheduler->lock);
+}
+
 
 int hdns_scheduler_cleanup(hdns_scheduler_t *scheduler) {
     if (scheduler != NULL) {
@@ -45,6 +45,16 @@ void hdns_scheduler_failover(hdns_scheduler_t *scheduler, const char *server);
 
 int hdns_scheduler_get(hdns_scheduler_t *scheduler, char *resolver);
 
+/*
+ * 获取当前解析服务IP列表的副本，通过hdns_list_free释放
+ */
+hdns_list_head_t *hdns_scheduler_get_resolvers(hdns_scheduler_t *scheduler, bool ipv4);
+
+/*
+ * 使用外部的解析服务IP列表（如磁盘快照）替换当前列表，空列表不生效
+ */
+void hdns_scheduler_set_resolvers(hdns_scheduler_t *scheduler, const hdns_list_head_t *resolvers, bool ipv4);
+
 int hdns_scheduler_cleanup(hdns_scheduler_t *scheduler);
 
 HDNS_CPP_END
@@ -0,0 +1,408 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_htable.h"
+#include "hdns_log.h"
+
+#include "hdns_shm_cache.h"
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__linux__)
+#define HDNS_SHM_ROBUST_MUTEX
+#endif
+
+// 读到正在写入的槽位时的最大重试次数，超过后视为未命中，避免写入进程异常退出时读者一直等待
+#define HDNS_SHM_READ_RETRIES      128
+#define HDNS_SHM_ATTACH_WAIT_MS    1000
+#define HDNS_SHM_HEADER_ALIGN      64
+
+struct hdns_shm_header_s {
+    volatile uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    pthread_mutex_t lock;
+    // 正在写入的槽位，持锁进程异常退出后由下一个写入者清理
+    int64_t dirty_slot;
+};
+
+static APR_INLINE size_t header_size() {
+    return (sizeof(hdns_shm_header_t) + HDNS_SHM_HEADER_ALIGN - 1) & ~((size_t) HDNS_SHM_HEADER_ALIGN - 1);
+}
+
+static APR_INLINE uint32_t seq_load(const volatile uint32_t *seq) {
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static void begin_write(hdns_shm_cache_t *shm_cache, uint32_t index) {
+    hdns_shm_slot_t *slot = &shm_cache->slots[index];
+    shm_cache->header->dirty_slot = index;
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_write(hdns_shm_cache_t *shm_cache, uint32_t index) {
+    hdns_shm_slot_t *slot = &shm_cache->slots[index];
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    shm_cache->header->dirty_slot = -1;
+}
+
+static void recover_dirty_slot(hdns_shm_cache_t *shm_cache) {
+    int64_t index = shm_cache->header->dirty_slot;
+    if (index < 0 || index >= shm_cache->slot_count) {
+        return;
+    }
+    hdns_shm_slot_t *slot = &shm_cache->slots[index];
+    slot->used = 0;
+    if (slot->seq & 1) {
+        __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    }
+    shm_cache->header->dirty_slot = -1;
+    hdns_log_info("recover shm cache slot %d left by a dead writer", (int) index);
+}
+
+static int32_t lock_shm(hdns_shm_cache_t *shm_cache) {
+    int rv = pthread_mutex_lock(&shm_cache->header->lock);
+#ifdef HDNS_SHM_ROBUST_MUTEX
+    if (rv == EOWNERDEAD) {
+        recover_dirty_slot(shm_cache);
+        pthread_mutex_consistent(&shm_cache->header->lock);
+        rv = 0;
+    }
+#endif
+    if (rv != 0) {
+        hdns_log_error("lock shm cache failed, code:%d", rv);
+        return HDNS_ERROR;
+    }
+    return HDNS_OK;
+}
+
+static void unlock_shm(hdns_shm_cache_t *shm_cache) {
+    pthread_mutex_unlock(&shm_cache->header->lock);
+}
+
+static int32_t init_header(hdns_shm_header_t *header, uint32_t slot_count) {
+    header->version = HDNS_SHM_CACHE_VERSION;
+    header->slot_count = slot_count;
+    header->slot_size = sizeof(hdns_shm_slot_t);
+    header->dirty_slot = -1;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef HDNS_SHM_ROBUST_MUTEX
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+    int rv = pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rv != 0) {
+        return HDNS_ERROR;
+    }
+    // magic最后写入，挂载方看到magic即说明初始化完成
+    __atomic_store_n(&header->magic, HDNS_SHM_CACHE_MAGIC, __ATOMIC_RELEASE);
+    return HDNS_OK;
+}
+
+static bool wait_header_ready(const hdns_shm_header_t *header) {
+    for (int i = 0; i < HDNS_SHM_ATTACH_WAIT_MS; i++) {
+        if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == HDNS_SHM_CACHE_MAGIC) {
+            return true;
+        }
+        apr_sleep(1000);
+    }
+    return false;
+}
+
+hdns_shm_cache_t *hdns_shm_cache_open(const char *file_path, uint32_t slot_count) {
+    if (hdns_str_is_blank(file_path)) {
+        return NULL;
+    }
+    if (slot_count < HDNS_SHM_CACHE_PROBE_WINDOW) {
+        slot_count = HDNS_SHM_CACHE_DEFAULT_SLOTS;
+    }
+    hdns_pool_new(pool);
+    apr_shm_t *shm = NULL;
+    size_t size = header_size() + (size_t) slot_count * sizeof(hdns_shm_slot_t);
+    bool created = false;
+    // apr_shm_create会在pool销毁时删除共享段，创建方使用不受管理且从不销毁的pool，
+    // 共享段在创建进程退出后继续保留，需要删除时调用apr_shm_remove
+    apr_pool_t *owner_pool = NULL;
+    apr_status_t rv = apr_pool_create_unmanaged_ex(&owner_pool, NULL, NULL);
+    if (rv == APR_SUCCESS) {
+        rv = apr_shm_create(&shm, size, file_path, owner_pool);
+        if (rv == APR_SUCCESS) {
+            created = true;
+        } else {
+            apr_pool_destroy(owner_pool);
+        }
+    }
+    if (APR_STATUS_IS_EEXIST(rv)) {
+        rv = apr_shm_attach(&shm, file_path, pool);
+    }
+    if (rv != APR_SUCCESS) {
+        char err_msg[128];
+        apr_strerror(rv, err_msg, sizeof(err_msg));
+        hdns_log_error("open shm cache %s failed: %s", file_path, err_msg);
+        hdns_pool_destroy(pool);
+        return NULL;
+    }
+    hdns_shm_header_t *header = apr_shm_baseaddr_get(shm);
+    if (created) {
+        memset(header, 0, size);
+        if (init_header(header, slot_count) != HDNS_OK) {
+            hdns_log_error("init shm cache %s failed", file_path);
+            apr_shm_destroy(shm);
+            apr_pool_destroy(owner_pool);
+            hdns_pool_destroy(pool);
+            return NULL;
+        }
+    } else if (!wait_header_ready(header)
+               || header->version != HDNS_SHM_CACHE_VERSION
+               || header->slot_size != sizeof(hdns_shm_slot_t)
+               || apr_shm_size_get(shm) < header_size() + (size_t) header->slot_count * sizeof(hdns_shm_slot_t)) {
+        hdns_log_error("shm cache %s is incompatible, remove it and retry", file_path);
+        apr_shm_detach(shm);
+        hdns_pool_destroy(pool);
+        return NULL;
+    }
+    hdns_shm_cache_t *shm_cache = hdns_palloc(pool, sizeof(hdns_shm_cache_t));
+    shm_cache->pool = pool;
+    shm_cache->shm = shm;
+    shm_cache->header = header;
+    shm_cache->slots = (hdns_shm_slot_t *) ((char *) header + header_size());
+    shm_cache->slot_count = header->slot_count;
+    hdns_log_info("%s shm cache %s, slots:%u", created ? "create" : "attach", file_path, shm_cache->slot_count);
+    return shm_cache;
+}
+
+static APR_INLINE bool copy_field(char *dst, size_t dst_size, const char *src) {
+    size_t len = src == NULL ? 0 : strlen(src);
+    if (len >= dst_size) {
+        return false;
+    }
+    if (len > 0) {
+        memcpy(dst, src, len);
+    }
+    dst[len] = '\0';
+    return true;
+}
+
+static APR_INLINE bool is_slot_match(const hdns_shm_slot_t *slot,
+                                     uint64_t hash,
+                                     hdns_rr_type_t type,
+                                     const char *key) {
+    return slot->used && slot->hash == hash && slot->type == type && strcmp(slot->key, key) == 0;
+}
+
+/*
+ * 在探测窗口内查找键，返回槽位下标，调用方需持有写锁
+ */
+static int64_t find_slot_locked(hdns_shm_cache_t *shm_cache, uint64_t hash, hdns_rr_type_t type, const char *key) {
+    for (uint32_t i = 0; i < HDNS_SHM_CACHE_PROBE_WINDOW; i++) {
+        uint32_t index = (uint32_t) ((hash + i) % shm_cache->slot_count);
+        if (is_slot_match(&shm_cache->slots[index], hash, type, key)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int32_t hdns_shm_cache_put(hdns_shm_cache_t *shm_cache, const hdns_resv_resp_t *entry) {
+    if (NULL == shm_cache || NULL == entry) {
+        return HDNS_ERROR;
+    }
+    const char *key = hdns_str_is_blank(entry->cache_key) ? entry->host : entry->cache_key;
+    // 先在栈上组装，持锁期间只做一次拷贝
+    hdns_shm_slot_t slot;
+    if (!copy_field(slot.key, sizeof(slot.key), key)
+        || !copy_field(slot.host, sizeof(slot.host), entry->host)
+        || !copy_field(slot.client_ip, sizeof(slot.client_ip), entry->client_ip)
+        || !copy_field(slot.extra, sizeof(slot.extra), entry->extra)) {
+        hdns_log_debug("entry of %s is too large for shm cache", key);
+        return HDNS_ERROR;
+    }
+    // IP数量或长度超出定长字段时整条不写入，避免其他进程读到被截断的结果
+    slot.ip_count = 0;
+    hdns_list_for_each_entry(cursor, entry->ips) {
+        if (slot.ip_count >= HDNS_SHM_CACHE_MAX_IPS
+            || !copy_field(slot.ips[slot.ip_count], HDNS_SHM_CACHE_MAX_IP_LEN, cursor->data)) {
+            hdns_log_debug("ips of %s are too large for shm cache", key);
+            return HDNS_ERROR;
+        }
+        slot.ip_count++;
+    }
+    size_t klen = 0;
+    slot.hash = hdns_htable_hash(slot.key, &klen);
+    slot.type = entry->type;
+    slot.ttl = entry->ttl;
+    slot.origin_ttl = entry->origin_ttl;
+    slot.query_time = entry->query_time;
+    slot.used = 1;
+
+    if (lock_shm(shm_cache) != HDNS_OK) {
+        return HDNS_ERROR;
+    }
+    int64_t found = find_slot_locked(shm_cache, slot.hash, slot.type, slot.key);
+    if (found < 0) {
+        // 优先使用空位，否则覆盖窗口内最旧的条目
+        for (uint32_t i = 0; i < HDNS_SHM_CACHE_PROBE_WINDOW; i++) {
+            uint32_t index = (uint32_t) ((slot.hash + i) % shm_cache->slot_count);
+            const hdns_shm_slot_t *candidate = &shm_cache->slots[index];
+            if (!candidate->used) {
+                found = index;
+                break;
+            }
+            if (found < 0 || candidate->query_time < shm_cache->slots[found].query_time) {
+                found = index;
+            }
+        }
+    }
+    hdns_shm_slot_t *target = &shm_cache->slots[found];
+    begin_write(shm_cache, (uint32_t) found);
+    slot.seq = target->seq;
+    memcpy((char *) target + sizeof(target->seq),
+           (char *) &slot + sizeof(slot.seq),
+           sizeof(hdns_shm_slot_t) - sizeof(slot.seq));
+    end_write(shm_cache, (uint32_t) found);
+    unlock_shm(shm_cache);
+    return HDNS_OK;
+}
+
+/*
+ * seqlock读：seq为偶数且拷贝前后一致才认为读到完整的槽位
+ */
+static bool read_slot(const hdns_shm_slot_t *slot,
+                      uint64_t hash,
+                      hdns_rr_type_t type,
+                      const char *key,
+                      hdns_shm_slot_t *out) {
+    for (int retry = 0; retry < HDNS_SHM_READ_RETRIES; retry++) {
+        uint32_t seq = seq_load(&slot->seq);
+        if (seq & 1) {
+            continue;
+        }
+        // 先比较哈希和类型，不匹配时不拷贝整个槽位
+        bool matched = slot->used && slot->hash == hash && slot->type == type;
+        if (matched) {
+            memcpy(out, (const void *) slot, sizeof(hdns_shm_slot_t));
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+        return matched && strcmp(out->key, key) == 0;
+    }
+    return false;
+}
+
+hdns_resv_resp_t *hdns_shm_cache_get(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type) {
+    if (NULL == shm_cache || hdns_str_is_blank(key)) {
+        return NULL;
+    }
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    if (klen >= HDNS_SHM_CACHE_MAX_KEY_LEN) {
+        return NULL;
+    }
+    hdns_shm_slot_t slot;
+    for (uint32_t i = 0; i < HDNS_SHM_CACHE_PROBE_WINDOW; i++) {
+        uint32_t index = (uint32_t) ((hash + i) % shm_cache->slot_count);
+        if (!read_slot(&shm_cache->slots[index], hash, type, key, &slot)) {
+            continue;
+        }
+        hdns_resv_resp_t *entry = hdns_resv_resp_create_empty(NULL, slot.host, type);
+        entry->cache_key = apr_pstrdup(entry->pool, slot.key);
+        entry->client_ip = slot.client_ip[0] != '\0' ? apr_pstrdup(entry->pool, slot.client_ip) : NULL;
+        entry->extra = slot.extra[0] != '\0' ? apr_pstrdup(entry->pool, slot.extra) : NULL;
+        entry->ttl = slot.ttl;
+        entry->origin_ttl = slot.origin_ttl;
+        entry->query_time = slot.query_time;
+        for (uint32_t j = 0; j < slot.ip_count && j < HDNS_SHM_CACHE_MAX_IPS; j++) {
+            hdns_list_add(entry->ips, slot.ips[j], hdns_to_list_clone_fn_t(apr_pstrdup));
+        }
+        hdns_resv_resp_pack_addrs(entry);
+        return entry;
+    }
+    return NULL;
+}
+
+int32_t hdns_shm_cache_delete(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type) {
+    if (NULL == shm_cache || hdns_str_is_blank(key)) {
+        return HDNS_ERROR;
+    }
+    size_t klen = 0;
+    uint64_t hash = hdns_htable_hash(key, &klen);
+    if (lock_shm(shm_cache) != HDNS_OK) {
+        return HDNS_ERROR;
+    }
+    int64_t found = find_slot_locked(shm_cache, hash, type, key);
+    if (found >= 0) {
+        begin_write(shm_cache, (uint32_t) found);
+        shm_cache->slots[found].used = 0;
+        end_write(shm_cache, (uint32_t) found);
+    }
+    unlock_shm(shm_cache);
+    return HDNS_OK;
+}
+
+void hdns_shm_cache_clean(hdns_shm_cache_t *shm_cache) {
+    if (NULL == shm_cache || lock_shm(shm_cache) != HDNS_OK) {
+        return;
+    }
+    for (uint32_t i = 0; i < shm_cache->slot_count; i++) {
+        if (shm_cache->slots[i].used) {
+            begin_write(shm_cache, i);
+            shm_cache->slots[i].used = 0;
+            end_write(shm_cache, i);
+        }
+    }
+    unlock_shm(shm_cache);
+}
+
+void hdns_shm_cache_close(hdns_shm_cache_t *shm_cache) {
+    if (shm_cache != NULL) {
+        apr_shm_detach(shm_cache->shm);
+        hdns_pool_destroy(shm_cache->pool);
+    }
+}
+
+#else
+
+hdns_shm_cache_t *hdns_shm_cache_open(const char *file_path, uint32_t slot_count) {
+    hdns_unused_var(slot_count);
+    hdns_log_error("shm cache %s is not supported on windows", file_path);
+    return NULL;
+}
+
+int32_t hdns_shm_cache_put(hdns_shm_cache_t *shm_cache, const hdns_resv_resp_t *entry) {
+    hdns_unused_var(shm_cache);
+    hdns_unused_var(entry);
+    return HDNS_ERROR;
+}
+
+hdns_resv_resp_t *hdns_shm_cache_get(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type) {
+    hdns_unused_var(shm_cache);
+    hdns_unused_var(key);
+    hdns_unused_var(type);
+    return NULL;
+}
+
+int32_t hdns_shm_cache_delete(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type) {
+    hdns_unused_var(shm_cache);
+    hdns_unused_var(key);
+    hdns_unused_var(type);
+    return HDNS_ERROR;
+}
+
+void hdns_shm_cache_clean(hdns_shm_cache_t *shm_cache) {
+    hdns_unused_var(shm_cache);
+}
+
+void hdns_shm_cache_close(hdns_shm_cache_t *shm_cache) {
+    hdns_unused_var(shm_cache);
+}
+
+#endif
@@ -0,0 +1,87 @@
+//
+// 跨进程共享内存缓存，多个worker进程挂载同一段共享内存，一个进程的解析结果可被其他进程直接使用。
+// 共享段内只使用偏移和定长字段，不保存指针；读取使用seqlock无锁读，写入使用进程间互斥锁（Linux下为robust mutex）
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_SHM_CACHE_H
+#define HDNS_C_SDK_HDNS_SHM_CACHE_H
+
+#include <apr_shm.h>
+
+#include "hdns_resolver.h"
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+#define HDNS_SHM_CACHE_MAGIC            0x48444e53
+#define HDNS_SHM_CACHE_VERSION          1
+#define HDNS_SHM_CACHE_DEFAULT_SLOTS    4096
+#define HDNS_SHM_CACHE_MAX_KEY_LEN      256
+#define HDNS_SHM_CACHE_MAX_IP_LEN       46
+#define HDNS_SHM_CACHE_MAX_IPS          8
+#define HDNS_SHM_CACHE_MAX_EXTRA_LEN    256
+// 线性探测窗口，窗口内没有空位时覆盖最旧的条目
+#define HDNS_SHM_CACHE_PROBE_WINDOW     8
+
+/*
+ * 共享段中的定长槽位，seq为奇数表示正在写入
+ */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t used;
+    uint64_t hash;
+    int32_t type;
+    int32_t ttl;
+    int32_t origin_ttl;
+    uint32_t ip_count;
+    int64_t query_time;
+    char key[HDNS_SHM_CACHE_MAX_KEY_LEN];
+    char host[HDNS_SHM_CACHE_MAX_KEY_LEN];
+    char client_ip[HDNS_SHM_CACHE_MAX_IP_LEN];
+    char extra[HDNS_SHM_CACHE_MAX_EXTRA_LEN];
+    char ips[HDNS_SHM_CACHE_MAX_IPS][HDNS_SHM_CACHE_MAX_IP_LEN];
+} hdns_shm_slot_t;
+
+typedef struct hdns_shm_header_s hdns_shm_header_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    apr_shm_t *shm;
+    hdns_shm_header_t *header;
+    hdns_shm_slot_t *slots;
+    uint32_t slot_count;
+} hdns_shm_cache_t;
+
+/*
+ * 创建或挂载共享内存缓存，文件不存在时创建并初始化，已存在时直接挂载，槽位数以创建者为准；
+ * 共享段不归属任何进程，所有进程关闭后依然保留，需要删除时调用apr_shm_remove。Windows平台不支持，返回NULL
+ */
+hdns_shm_cache_t *hdns_shm_cache_open(const char *file_path, uint32_t slot_count);
+
+/*
+ * 写入条目，键、IP等超出定长字段或IP数超过HDNS_SHM_CACHE_MAX_IPS的条目不写入共享内存，返回HDNS_ERROR
+ */
+int32_t hdns_shm_cache_put(hdns_shm_cache_t *shm_cache, const hdns_resv_resp_t *entry);
+
+/*
+ * 读取条目的私有副本，使用完毕后通过hdns_resv_resp_destroy释放
+ */
+hdns_resv_resp_t *hdns_shm_cache_get(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type);
+
+int32_t hdns_shm_cache_delete(hdns_shm_cache_t *shm_cache, const char *key, hdns_rr_type_t type);
+
+/*
+ * 清空共享段中的所有条目，会影响挂载同一共享段的所有进程
+ */
+void hdns_shm_cache_clean(hdns_shm_cache_t *shm_cache);
+
+/*
+ * 仅解除本进程的挂载，即使本进程是创建方，共享段也不会删除，由其他进程继续使用
+ */
+void hdns_shm_cache_close(hdns_shm_cache_t *shm_cache);
+
+HDNS_CPP_END
+
+#endif
@@ -0,0 +1,171 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_clock.h"
+#include "hdns_sketch.h"
+
+hdns_sketch_t *hdns_sketch_create(uint32_t width, size_t hot_capacity) {
+    uint32_t actual_width = 1;
+    while (actual_width < width) {
+        actual_width <<= 1;
+    }
+    hdns_pool_new(pool);
+    hdns_sketch_t *sketch = hdns_pcalloc(pool, sizeof(hdns_sketch_t));
+    sketch->pool = pool;
+    sketch->counters = hdns_pcalloc(pool, HDNS_SKETCH_DEPTH * actual_width * sizeof(apr_uint32_t));
+    sketch->width_mask = actual_width - 1;
+    apr_atomic_set32(&sketch->last_decay_sec, (apr_uint32_t) apr_time_sec(hdns_clock_now()));
+    apr_thread_mutex_create(&sketch->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    sketch->hot_capacity = hot_capacity;
+    sketch->hot_keys = hdns_pcalloc(pool, hot_capacity * sizeof(hdns_sketch_hot_key_t));
+    sketch->hot_tags = hdns_pcalloc(pool, hot_capacity * sizeof(apr_uint32_t));
+    sketch->hot_count = 0;
+    apr_atomic_set32(&sketch->hot_threshold, 0);
+    return sketch;
+}
+
+/*
+ * 双重哈希派生各行下标，高位再次打散，与分段选择使用的位错开
+ */
+static APR_INLINE uint32_t counter_index(const hdns_sketch_t *sketch, uint64_t hash, int row) {
+    uint64_t h = hash ^ (hash >> 29);
+    h *= UINT64_C(0xbf58476d1ce4e5b9);
+    uint32_t h1 = (uint32_t) h;
+    uint32_t h2 = (uint32_t) (h >> 32) | 1;
+    return (uint32_t) row * (sketch->width_mask + 1) + ((h1 + (uint32_t) row * h2) & sketch->width_mask);
+}
+
+static APR_INLINE uint32_t hot_tag(uint64_t hash) {
+    return (uint32_t) (hash >> 32) | 1;
+}
+
+static bool is_hot_tag(const hdns_sketch_t *sketch, uint32_t tag) {
+    for (size_t i = 0; i < sketch->hot_capacity; i++) {
+        if (apr_atomic_read32(&sketch->hot_tags[i]) == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 在sketch->lock内调用，按当前估计值刷新热点键的频次和准入阈值，返回频次最小的下标
+ */
+static size_t refresh_hot_counts(hdns_sketch_t *sketch) {
+    size_t min_index = 0;
+    for (size_t i = 0; i < sketch->hot_count; i++) {
+        sketch->hot_keys[i].count = hdns_sketch_estimate(sketch, sketch->hot_keys[i].hash);
+        if (sketch->hot_keys[i].count < sketch->hot_keys[min_index].count) {
+            min_index = i;
+        }
+    }
+    uint32_t threshold = sketch->hot_count == sketch->hot_capacity ? sketch->hot_keys[min_index].count : 0;
+    apr_atomic_set32(&sketch->hot_threshold, threshold);
+    return min_index;
+}
+
+static void offer_hot_key(hdns_sketch_t *sketch, const char *key, uint64_t hash, uint32_t count) {
+    uint32_t tag = hot_tag(hash);
+    apr_thread_mutex_lock(sketch->lock);
+    // 加锁期间其他线程可能已加入同一个键
+    for (size_t i = 0; i < sketch->hot_count; i++) {
+        if (sketch->hot_keys[i].hash == hash && strcmp(sketch->hot_keys[i].key, key) == 0) {
+            apr_thread_mutex_unlock(sketch->lock);
+            return;
+        }
+    }
+    size_t min_index = refresh_hot_counts(sketch);
+    size_t index = sketch->hot_capacity;
+    if (sketch->hot_count < sketch->hot_capacity) {
+        index = sketch->hot_count++;
+    } else if (sketch->hot_keys[min_index].count < count) {
+        index = min_index;
+    }
+    if (index < sketch->hot_capacity) {
+        hdns_sketch_hot_key_t *slot = &sketch->hot_keys[index];
+        apr_cpystrn(slot->key, key, sizeof(slot->key));
+        slot->hash = hash;
+        slot->count = count;
+        apr_atomic_set32(&sketch->hot_tags[index], tag);
+        refresh_hot_counts(sketch);
+    }
+    apr_thread_mutex_unlock(sketch->lock);
+}
+
+uint32_t hdns_sketch_increment(hdns_sketch_t *sketch, const char *key, uint64_t hash) {
+    return hdns_sketch_add(sketch, key, hash, 1);
+}
+
+uint32_t hdns_sketch_add(hdns_sketch_t *sketch, const char *key, uint64_t hash, uint32_t count) {
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < HDNS_SKETCH_DEPTH; row++) {
+        uint32_t row_count = apr_atomic_add32(&sketch->counters[counter_index(sketch, hash, row)], count) + count;
+        if (row_count < estimate) {
+            estimate = row_count;
+        }
+    }
+    // 已在热点集合中的键无需加锁，只有进入热点集合时才加锁
+    if (sketch->hot_capacity > 0
+        && estimate > apr_atomic_read32(&sketch->hot_threshold)
+        && !is_hot_tag(sketch, hot_tag(hash))
+        && strlen(key) < HDNS_SKETCH_MAX_KEY_LENGTH) {
+        offer_hot_key(sketch, key, hash, estimate);
+    }
+    return estimate;
+}
+
+void hdns_sketch_decay(hdns_sketch_t *sketch, uint32_t now_sec) {
+    uint32_t last_decay_sec = apr_atomic_read32(&sketch->last_decay_sec);
+    if (now_sec - last_decay_sec < HDNS_SKETCH_DECAY_INTERVAL_SEC
+        || apr_atomic_cas32(&sketch->last_decay_sec, now_sec, last_decay_sec) != last_decay_sec) {
+        return;
+    }
+    // 与并发的自增存在竞争，丢失少量计数不影响估计
+    size_t count = HDNS_SKETCH_DEPTH * (size_t) (sketch->width_mask + 1);
+    for (size_t i = 0; i < count; i++) {
+        apr_atomic_set32(&sketch->counters[i], apr_atomic_read32(&sketch->counters[i]) >> 1);
+    }
+    apr_thread_mutex_lock(sketch->lock);
+    refresh_hot_counts(sketch);
+    apr_thread_mutex_unlock(sketch->lock);
+}
+
+uint32_t hdns_sketch_estimate(hdns_sketch_t *sketch, uint64_t hash) {
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < HDNS_SKETCH_DEPTH; row++) {
+        uint32_t count = apr_atomic_read32(&sketch->counters[counter_index(sketch, hash, row)]);
+        if (count < estimate) {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+static int32_t compare_hot_item(const void *item1, const void *item2) {
+    uint32_t count1 = ((const hdns_sketch_hot_item_t *) item1)->count;
+    uint32_t count2 = ((const hdns_sketch_hot_item_t *) item2)->count;
+    return count1 == count2 ? 0 : (count1 > count2 ? -1 : 1);
+}
+
+hdns_list_head_t *hdns_sketch_get_hot_keys(hdns_sketch_t *sketch) {
+    hdns_list_head_t *hot_keys = hdns_list_new(NULL);
+    apr_thread_mutex_lock(sketch->lock);
+    refresh_hot_counts(sketch);
+    for (size_t i = 0; i < sketch->hot_count; i++) {
+        hdns_sketch_hot_item_t *item = hdns_palloc(hot_keys->pool, sizeof(hdns_sketch_hot_item_t));
+        item->key = apr_pstrdup(hot_keys->pool, sketch->hot_keys[i].key);
+        item->count = sketch->hot_keys[i].count;
+        hdns_list_add(hot_keys, item, NULL);
+    }
+    apr_thread_mutex_unlock(sketch->lock);
+    hdns_list_sort(hot_keys, compare_hot_item);
+    return hot_keys;
+}
+
+void hdns_sketch_cleanup(hdns_sketch_t *sketch) {
+    if (NULL == sketch) {
+        return;
+    }
+    apr_thread_mutex_destroy(sketch->lock);
+    hdns_pool_destroy(sketch->pool);
+}
@@ -0,0 +1,87 @@
+//
+// 访问频次的近似统计：Count-Min Sketch按多行计数取最小值估计频次，由后台定时任务周期性整体减半，
+// 使频次随时间衰减；同时维护频次最高的K个键作为热点集合
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_SKETCH_H
+#define HDNS_C_SDK_HDNS_SKETCH_H
+
+#include <apr_atomic.h>
+#include <apr_thread_mutex.h>
+
+#include "hdns_list.h"
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+#define HDNS_SKETCH_DEPTH            4
+// 每行计数器个数，会向上取整到2的幂
+#define HDNS_SKETCH_DEFAULT_WIDTH    4096
+#define HDNS_SKETCH_HOT_KEY_CAPACITY 64
+// 超出长度的键不进入热点集合，只计数
+#define HDNS_SKETCH_MAX_KEY_LENGTH   320
+// 两次衰减的最小间隔
+#define HDNS_SKETCH_DECAY_INTERVAL_SEC 60
+
+typedef struct {
+    char key[HDNS_SKETCH_MAX_KEY_LENGTH];
+    uint64_t hash;
+    uint32_t count;
+} hdns_sketch_hot_key_t;
+
+/*
+ * 热点键及其估计频次的快照
+ */
+typedef struct {
+    char *key;
+    uint32_t count;
+} hdns_sketch_hot_item_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    volatile apr_uint32_t *counters;
+    uint32_t width_mask;
+    // 上次衰减的时间，单位秒，多个定时任务共用同一个sketch时只有一个执行衰减
+    volatile apr_uint32_t last_decay_sec;
+    // 保护热点集合的写入，只在键进入或移出热点集合时加锁
+    apr_thread_mutex_t *lock;
+    hdns_sketch_hot_key_t *hot_keys;
+    // 与hot_keys一一对应的哈希标签，空槽位为0，访问时无锁判断是否已在热点集合中
+    volatile apr_uint32_t *hot_tags;
+    size_t hot_capacity;
+    size_t hot_count;
+    // 热点集合已满时其中的最小频次，估计值不超过它的访问无需加锁
+    volatile apr_uint32_t hot_threshold;
+} hdns_sketch_t;
+
+hdns_sketch_t *hdns_sketch_create(uint32_t width, size_t hot_capacity);
+
+/*
+ * 记录一次访问并返回更新后的估计频次，hash为键的64位哈希
+ */
+uint32_t hdns_sketch_increment(hdns_sketch_t *sketch, const char *key, uint64_t hash);
+
+/*
+ * 一次记录count次访问，用于按采样记录的访问
+ */
+uint32_t hdns_sketch_add(hdns_sketch_t *sketch, const char *key, uint64_t hash, uint32_t count);
+
+uint32_t hdns_sketch_estimate(hdns_sketch_t *sketch, uint64_t hash);
+
+/*
+ * 距上次衰减超过HDNS_SKETCH_DECAY_INTERVAL_SEC时将计数整体减半，由后台定时任务调用，不在访问路径上执行
+ */
+void hdns_sketch_decay(hdns_sketch_t *sketch, uint32_t now_sec);
+
+/*
+ * 热点键快照，元素为hdns_sketch_hot_item_t，按频次从高到低排列，通过hdns_list_free释放
+ */
+hdns_list_head_t *hdns_sketch_get_hot_keys(hdns_sketch_t *sketch);
+
+void hdns_sketch_cleanup(hdns_sketch_t *sketch);
+
+HDNS_CPP_END
+
+#endif
@@ -0,0 +1,149 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_slab.h"
+
+// 首个chunk容纳的块数，之后按已切分块数翻倍，直到HDNS_SLAB_CHUNK_SIZE
+#define HDNS_SLAB_MIN_CHUNK_BLOCKS  8
+
+/*
+ * 块头记录所属级别，释放时据此找回空闲链表；按8字节对齐，保证块内结构体的对齐
+ */
+typedef union {
+    uint32_t class_index;
+    apr_uint64_t align;
+    void *ptr;
+} hdns_slab_header_t;
+
+static const size_t hdns_slab_class_sizes[HDNS_SLAB_CLASS_COUNT] = {
+        64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+static int find_class(size_t size) {
+    for (int i = 0; i < HDNS_SLAB_CLASS_COUNT; i++) {
+        if (size <= hdns_slab_class_sizes[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+hdns_slab_t *hdns_slab_create() {
+    hdns_pool_new(pool);
+    if (NULL == pool) {
+        return NULL;
+    }
+    hdns_slab_t *slab = hdns_pcalloc(pool, sizeof(hdns_slab_t));
+    slab->pool = pool;
+    apr_thread_mutex_create(&slab->chunk_lock, APR_THREAD_MUTEX_DEFAULT, pool);
+    for (int i = 0; i < HDNS_SLAB_CLASS_COUNT; i++) {
+        hdns_slab_class_t *slab_class = &slab->classes[i];
+        apr_thread_mutex_create(&slab_class->lock, APR_THREAD_MUTEX_DEFAULT, pool);
+        slab_class->block_size = hdns_slab_class_sizes[i];
+    }
+    apr_atomic_set32(&slab->ref_count, 1);
+    return slab;
+}
+
+/*
+ * 在级别锁内调用，为该级别申请新的chunk
+ */
+static bool grow_class(hdns_slab_t *slab, hdns_slab_class_t *slab_class) {
+    size_t blocks = slab_class->total_blocks;
+    if (blocks < HDNS_SLAB_MIN_CHUNK_BLOCKS) {
+        blocks = HDNS_SLAB_MIN_CHUNK_BLOCKS;
+    }
+    size_t chunk_size = blocks * slab_class->block_size;
+    if (chunk_size > HDNS_SLAB_CHUNK_SIZE) {
+        chunk_size = HDNS_SLAB_CHUNK_SIZE - HDNS_SLAB_CHUNK_SIZE % slab_class->block_size;
+    }
+    apr_thread_mutex_lock(slab->chunk_lock);
+    char *chunk = hdns_palloc(slab->pool, chunk_size);
+    apr_thread_mutex_unlock(slab->chunk_lock);
+    if (NULL == chunk) {
+        return false;
+    }
+    slab_class->chunk_cur = chunk;
+    slab_class->chunk_end = chunk + chunk_size;
+    return true;
+}
+
+static void slab_destroy(hdns_slab_t *slab) {
+    for (int i = 0; i < HDNS_SLAB_CLASS_COUNT; i++) {
+        apr_thread_mutex_destroy(slab->classes[i].lock);
+    }
+    apr_thread_mutex_destroy(slab->chunk_lock);
+    hdns_pool_destroy(slab->pool);
+}
+
+void *hdns_slab_alloc(hdns_slab_t *slab, size_t size) {
+    if (NULL == slab) {
+        return NULL;
+    }
+    int index = find_class(size + sizeof(hdns_slab_header_t));
+    if (index < 0) {
+        return NULL;
+    }
+    hdns_slab_class_t *slab_class = &slab->classes[index];
+    hdns_slab_header_t *header = NULL;
+
+    apr_thread_mutex_lock(slab_class->lock);
+    if (slab_class->free_list != NULL) {
+        header = (hdns_slab_header_t *) slab_class->free_list;
+        slab_class->free_list = slab_class->free_list->next;
+    } else if (slab_class->chunk_cur < slab_class->chunk_end || grow_class(slab, slab_class)) {
+        header = (hdns_slab_header_t *) slab_class->chunk_cur;
+        slab_class->chunk_cur += slab_class->block_size;
+        slab_class->total_blocks++;
+    }
+    if (header != NULL) {
+        slab_class->used_blocks++;
+    }
+    apr_thread_mutex_unlock(slab_class->lock);
+
+    if (NULL == header) {
+        return NULL;
+    }
+    header->class_index = index;
+    apr_atomic_inc32(&slab->ref_count);
+    return header + 1;
+}
+
+void hdns_slab_free(hdns_slab_t *slab, void *ptr) {
+    if (NULL == slab || NULL == ptr) {
+        return;
+    }
+    hdns_slab_header_t *header = (hdns_slab_header_t *) ptr - 1;
+    hdns_slab_class_t *slab_class = &slab->classes[header->class_index];
+    hdns_slab_block_t *block = (hdns_slab_block_t *) header;
+
+    apr_thread_mutex_lock(slab_class->lock);
+    block->next = slab_class->free_list;
+    slab_class->free_list = block;
+    slab_class->used_blocks--;
+    apr_thread_mutex_unlock(slab_class->lock);
+
+    hdns_slab_release(slab);
+}
+
+void hdns_slab_release(hdns_slab_t *slab) {
+    if (slab != NULL && !apr_atomic_dec32(&slab->ref_count)) {
+        slab_destroy(slab);
+    }
+}
+
+void hdns_slab_get_stats(hdns_slab_t *slab, hdns_slab_stats_t *stats) {
+    memset(stats, 0, sizeof(hdns_slab_stats_t));
+    if (NULL == slab) {
+        return;
+    }
+    for (int i = 0; i < HDNS_SLAB_CLASS_COUNT; i++) {
+        hdns_slab_class_t *slab_class = &slab->classes[i];
+        apr_thread_mutex_lock(slab_class->lock);
+        size_t unused = (size_t) (slab_class->chunk_end - slab_class->chunk_cur);
+        stats->used_blocks += slab_class->used_blocks;
+        stats->used_bytes += slab_class->used_blocks * slab_class->block_size;
+        stats->reserved_bytes += slab_class->total_blocks * slab_class->block_size + unused;
+        apr_thread_mutex_unlock(slab_class->lock);
+    }
+}
@@ -0,0 +1,86 @@
+//
+// 缓存条目的分级slab分配器：按大小分级，每级维护独立的空闲链表，
+// 内存从整块chunk中切分，释放后回到所属级别的空闲链表复用，slab销毁时整体归还
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_SLAB_H
+#define HDNS_C_SDK_HDNS_SLAB_H
+
+#include <apr_atomic.h>
+#include <apr_thread_mutex.h>
+
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+// 级别按2的幂及其1.5倍递增，最小64字节，最大4096字节
+#define HDNS_SLAB_MIN_BLOCK_SIZE   64
+#define HDNS_SLAB_MAX_BLOCK_SIZE   4096
+#define HDNS_SLAB_CLASS_COUNT      13
+// 每次向pool申请的chunk大小
+#define HDNS_SLAB_CHUNK_SIZE       (64 * 1024)
+
+typedef struct hdns_slab_block_s hdns_slab_block_t;
+
+struct hdns_slab_block_s {
+    hdns_slab_block_t *next;
+};
+
+typedef struct {
+    apr_thread_mutex_t *lock;
+    size_t block_size;
+    hdns_slab_block_t *free_list;
+    // 当前chunk中尚未切分的区域
+    char *chunk_cur;
+    char *chunk_end;
+    // 已分配出去的块数
+    size_t used_blocks;
+    // 已从chunk中切分的块数，包括空闲链表中的块
+    size_t total_blocks;
+} hdns_slab_class_t;
+
+typedef struct {
+    hdns_pool_t *pool;
+    // 保护pool上的chunk申请
+    apr_thread_mutex_t *chunk_lock;
+    hdns_slab_class_t classes[HDNS_SLAB_CLASS_COUNT];
+    // 持有者和每个已分配的块各占一个引用，条目可能在缓存销毁后仍被调用方持有
+    volatile apr_uint32_t ref_count;
+} hdns_slab_t;
+
+typedef struct {
+    // 分配出去的块占用的字节数，按块大小计算
+    uint64_t used_bytes;
+    // 向pool申请的chunk总字节数
+    uint64_t reserved_bytes;
+    uint64_t used_blocks;
+} hdns_slab_stats_t;
+
+/*
+ * @brief 创建slab，内部使用独立的根pool
+ * @return slab，失败时返回NULL
+ */
+hdns_slab_t *hdns_slab_create();
+
+/*
+ * @brief 分配内存，超过HDNS_SLAB_MAX_BLOCK_SIZE时返回NULL，由调用方改用pool分配
+ */
+void *hdns_slab_alloc(hdns_slab_t *slab, size_t size);
+
+/*
+ * @brief 释放hdns_slab_alloc分配的内存
+ */
+void hdns_slab_free(hdns_slab_t *slab, void *ptr);
+
+/*
+ * @brief 持有者释放slab，所有块释放后才真正销毁
+ */
+void hdns_slab_release(hdns_slab_t *slab);
+
+void hdns_slab_get_stats(hdns_slab_t *slab, hdns_slab_stats_t *stats);
+
+HDNS_CPP_END
+
+#endif
@@ -0,0 +1,129 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_timer_wheel.h"
+
+
+static APR_INLINE void list_init(hdns_timer_wheel_node_t *head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static APR_INLINE bool list_is_empty(const hdns_timer_wheel_node_t *head) {
+    return head->next == head;
+}
+
+static APR_INLINE void list_add_tail(hdns_timer_wheel_node_t *head, hdns_timer_wheel_node_t *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static APR_INLINE void list_unlink(hdns_timer_wheel_node_t *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+/*
+ * 将槽位整体摘到临时链表上，避免遍历过程中回调或下放修改同一槽位
+ */
+static void list_splice(hdns_timer_wheel_node_t *from, hdns_timer_wheel_node_t *to) {
+    list_init(to);
+    if (list_is_empty(from)) {
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init(from);
+}
+
+static void place_node(hdns_timer_wheel_t *wheel, hdns_timer_wheel_node_t *node) {
+    uint64_t expire_tick = node->expire_tick < wheel->next_tick ? wheel->next_tick : node->expire_tick;
+    uint64_t delta = expire_tick - wheel->next_tick;
+    int level = 0;
+    while (level < HDNS_TIMER_WHEEL_LEVELS - 1
+           && delta >= ((uint64_t) 1 << (HDNS_TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    uint64_t max_delta = ((uint64_t) 1 << (HDNS_TIMER_WHEEL_SLOT_BITS * HDNS_TIMER_WHEEL_LEVELS)) - 1;
+    if (delta > max_delta) {
+        // 超出最大跨度时先放在最高层的最远槽位，下放时按真实到期时间重新计算
+        expire_tick = wheel->next_tick + max_delta;
+    }
+    uint64_t slot = (expire_tick >> (HDNS_TIMER_WHEEL_SLOT_BITS * level)) & HDNS_TIMER_WHEEL_SLOT_MASK;
+    list_add_tail(&wheel->slots[level][slot], node);
+}
+
+/*
+ * 将上层槽位中的节点按剩余时间重新放置，返回该层的槽位下标，为0时需要继续下放更上一层
+ */
+static uint64_t cascade(hdns_timer_wheel_t *wheel, int level) {
+    uint64_t slot = (wheel->next_tick >> (HDNS_TIMER_WHEEL_SLOT_BITS * level)) & HDNS_TIMER_WHEEL_SLOT_MASK;
+    hdns_timer_wheel_node_t pending;
+    list_splice(&wheel->slots[level][slot], &pending);
+    while (!list_is_empty(&pending)) {
+        hdns_timer_wheel_node_t *node = pending.next;
+        list_unlink(node);
+        place_node(wheel, node);
+    }
+    return slot;
+}
+
+
+hdns_timer_wheel_t *hdns_timer_wheel_create(hdns_pool_t *pool, uint64_t current_tick) {
+    hdns_timer_wheel_t *wheel = hdns_palloc(pool, sizeof(hdns_timer_wheel_t));
+    wheel->next_tick = current_tick;
+    wheel->count = 0;
+    for (int level = 0; level < HDNS_TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < HDNS_TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+    return wheel;
+}
+
+void hdns_timer_wheel_add(hdns_timer_wheel_t *wheel, hdns_timer_wheel_node_t *node, uint64_t expire_tick) {
+    if (hdns_timer_wheel_node_is_linked(node)) {
+        hdns_timer_wheel_remove(wheel, node);
+    }
+    node->expire_tick = expire_tick;
+    place_node(wheel, node);
+    wheel->count++;
+}
+
+void hdns_timer_wheel_remove(hdns_timer_wheel_t *wheel, hdns_timer_wheel_node_t *node) {
+    if (!hdns_timer_wheel_node_is_linked(node)) {
+        return;
+    }
+    list_unlink(node);
+    wheel->count--;
+}
+
+void hdns_timer_wheel_advance(hdns_timer_wheel_t *wheel,
+                              uint64_t to_tick,
+                              hdns_timer_wheel_expire_fn_t fn,
+                              void *arg) {
+    while (wheel->next_tick <= to_tick) {
+        uint64_t slot = wheel->next_tick & HDNS_TIMER_WHEEL_SLOT_MASK;
+        // 低层转完一圈时，从上一层下放
+        for (int level = 1; level < HDNS_TIMER_WHEEL_LEVELS && slot == 0; level++) {
+            if (cascade(wheel, level) != 0) {
+                break;
+            }
+        }
+        hdns_timer_wheel_node_t expired;
+        list_splice(&wheel->slots[0][slot], &expired);
+        wheel->next_tick++;
+        while (!list_is_empty(&expired)) {
+            hdns_timer_wheel_node_t *node = expired.next;
+            list_unlink(node);
+            wheel->count--;
+            fn(arg, node);
+        }
+    }
+}
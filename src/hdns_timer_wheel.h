@@ -0,0 +1,72 @@
+//
+// 分层时间轮，按tick记录到期时间，增删为O(1)，推进时逐级下放，均摊O(1)；
+// 不做加锁，由调用方保证并发安全
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#ifndef HDNS_C_SDK_HDNS_TIMER_WHEEL_H
+#define HDNS_C_SDK_HDNS_TIMER_WHEEL_H
+
+#include "hdns_define.h"
+
+HDNS_CPP_START
+
+#define HDNS_TIMER_WHEEL_LEVELS     4
+#define HDNS_TIMER_WHEEL_SLOT_BITS  6
+#define HDNS_TIMER_WHEEL_SLOTS      (1 << HDNS_TIMER_WHEEL_SLOT_BITS)
+#define HDNS_TIMER_WHEEL_SLOT_MASK  (HDNS_TIMER_WHEEL_SLOTS - 1)
+
+typedef struct hdns_timer_wheel_node_s hdns_timer_wheel_node_t;
+
+/*
+ * 侵入式定时节点，嵌入在调用方的结构体中，next为NULL表示不在时间轮上
+ */
+struct hdns_timer_wheel_node_s {
+    hdns_timer_wheel_node_t *prev;
+    hdns_timer_wheel_node_t *next;
+    uint64_t expire_tick;
+    // 调用方自定义标记，时间轮不使用
+    uint32_t tag;
+};
+
+typedef struct {
+    // 下一个待处理的tick
+    uint64_t next_tick;
+    size_t count;
+    // 每个槽位是一个带哨兵的双向循环链表
+    hdns_timer_wheel_node_t slots[HDNS_TIMER_WHEEL_LEVELS][HDNS_TIMER_WHEEL_SLOTS];
+} hdns_timer_wheel_t;
+
+/*
+ * 到期回调，回调前节点已从时间轮上摘下，回调内可以重新加入
+ */
+typedef void (*hdns_timer_wheel_expire_fn_t)(void *arg, hdns_timer_wheel_node_t *node);
+
+hdns_timer_wheel_t *hdns_timer_wheel_create(hdns_pool_t *pool, uint64_t current_tick);
+
+/*
+ * 加入时间轮，expire_tick早于当前tick时在下一次推进时到期；超出最大跨度的节点逐级下放时重新计算
+ */
+void hdns_timer_wheel_add(hdns_timer_wheel_t *wheel, hdns_timer_wheel_node_t *node, uint64_t expire_tick);
+
+/*
+ * 从时间轮摘除，节点不在时间轮上时不做处理
+ */
+void hdns_timer_wheel_remove(hdns_timer_wheel_t *wheel, hdns_timer_wheel_node_t *node);
+
+/*
+ * 推进到to_tick（含），对到期节点依次回调
+ */
+void hdns_timer_wheel_advance(hdns_timer_wheel_t *wheel,
+                              uint64_t to_tick,
+                              hdns_timer_wheel_expire_fn_t fn,
+                              void *arg);
+
+static APR_INLINE bool hdns_timer_wheel_node_is_linked(const hdns_timer_wheel_node_t *node) {
+    return node->next != NULL;
+}
+
+HDNS_CPP_END
+
+#endif
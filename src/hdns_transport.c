@@ -12,6 +12,7 @@
 #include "hdns_buf.h"
 #include "hdns_session.h"
 #include "hdns_utils.h"
+#include "hdns_clock.h"
 
 #include "hdns_transport.h"
 
@@ -307,7 +308,7 @@ size_t hdns_curl_default_header_callback(char *buffer, size_t size, size_t nitem
     len = size * nitems;
 
     if (t->resp->extra_info->first_byte_time == 0) {
-        t->resp->extra_info->first_byte_time = apr_time_now();
+        t->resp->extra_info->first_byte_time = hdns_clock_precise_now();
     }
 
     hdns_curl_response_headers_parse(t->pool, t->resp->headers, buffer, len);
@@ -351,7 +352,7 @@ size_t hdns_curl_default_write_callback(char *ptr, size_t size, size_t nmemb, vo
     len = size * nmemb;
 
     if (t->resp->extra_info->first_byte_time == 0) {
-        t->resp->extra_info->first_byte_time = apr_time_now();
+        t->resp->extra_info->first_byte_time = hdns_clock_precise_now();
     }
 
     hdns_curl_transport_headers_done(t);
@@ -561,9 +562,9 @@ int hdns_http_transport_perform(hdns_http_transport_t *t) {
     if (ecode != HDNS_OK) {
         return ecode;
     }
-    t->resp->extra_info->start_time = apr_time_now();
+    t->resp->extra_info->start_time = hdns_clock_precise_now();
     code = curl_easy_perform(t->curl_ctx->session);
-    t->resp->extra_info->finish_time = apr_time_now();
+    t->resp->extra_info->finish_time = hdns_clock_precise_now();
     hdns_move_transport_state(t, TRANS_STATE_DONE);
     t->curl_ctx->curl_code = code;
     hdns_curl_transport_finish(t);
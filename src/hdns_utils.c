@@ -2,6 +2,7 @@
 // Created by caogaoshuai on 2024/6/25.
 //
 #include "hdns_utils.h"
+#include "hdns_string.h"
 #include "apr_env.h"
 #include "hdns_log.h"
 #include "apr_md5.h"
@@ -50,6 +51,81 @@ bool hdns_is_valid_ipv4(const char *ip) {
     return inet_pton(AF_INET, ip, &addr) == 1;
 }
 
+/*
+ * 按8字节一组转小写：整组都是ASCII时，通过加法把'A'~'Z'的字节最高位置1，再右移得到0x20掩码
+ */
+static void lowercase_ascii(char *str, size_t len) {
+    const uint64_t high_bits = UINT64_C(0x8080808080808080);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, str + i, sizeof(uint64_t));
+        if (word & high_bits) {
+            for (size_t j = i; j < i + sizeof(uint64_t); j++) {
+                str[j] = hdns_tolower(str[j]);
+            }
+            continue;
+        }
+        // 0x80-'A'和0x80-'Z'-1，字节不超过0x7F，相加不会向相邻字节进位
+        uint64_t ge_a = word + UINT64_C(0x3f3f3f3f3f3f3f3f);
+        uint64_t gt_z = word + UINT64_C(0x2525252525252525);
+        word |= ((ge_a & ~gt_z) & high_bits) >> 2;
+        memcpy(str + i, &word, sizeof(uint64_t));
+    }
+    for (; i < len; i++) {
+        str[i] = hdns_tolower(str[i]);
+    }
+}
+
+int32_t hdns_canonicalize_host(char *host) {
+    if (NULL == host) {
+        return HDNS_INVALID_ARGUMENT;
+    }
+    size_t len = strlen(host);
+    if (len > 0 && host[len - 1] == '.') {
+        host[--len] = '\0';
+    }
+    if (0 == len || len > HDNS_MAX_DOMAIN_LENGTH) {
+        return HDNS_INVALID_ARGUMENT;
+    }
+    lowercase_ascii(host, len);
+    return HDNS_OK;
+}
+
+bool hdns_is_ip_literal(const char *host) {
+    return hdns_is_valid_ipv4(host) || hdns_is_valid_ipv6(host);
+}
+
+static void mask_prefix(unsigned char *addr, size_t size, int32_t prefix_len) {
+    for (size_t i = 0; i < size; i++) {
+        int32_t bits = prefix_len - (int32_t) (i * 8);
+        if (bits >= 8) {
+            continue;
+        }
+        addr[i] &= bits <= 0 ? 0 : (unsigned char) (0xFF << (8 - bits));
+    }
+}
+
+char *hdns_ip_to_subnet(hdns_pool_t *pool, const char *ip, int32_t ipv4_prefix_len, int32_t ipv6_prefix_len) {
+    if (NULL == ip) {
+        return NULL;
+    }
+    char subnet[INET6_ADDRSTRLEN];
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ip, &addr) == 1) {
+        mask_prefix((unsigned char *) &addr, sizeof(addr), ipv4_prefix_len);
+        inet_ntop(AF_INET, &addr, subnet, sizeof(subnet));
+        return apr_psprintf(pool, "%s/%d", subnet, ipv4_prefix_len);
+    }
+    struct in6_addr addr6;
+    if (inet_pton(AF_INET6, ip, &addr6) == 1) {
+        mask_prefix((unsigned char *) &addr6, sizeof(addr6), ipv6_prefix_len);
+        inet_ntop(AF_INET6, &addr6, subnet, sizeof(subnet));
+        return apr_psprintf(pool, "%s/%d", subnet, ipv6_prefix_len);
+    }
+    return NULL;
+}
+
 void hdns_md5(const char *content, size_t size, char *digest) {
     apr_md5_ctx_t ctx;
     apr_md5_init(&ctx);
@@ -13,6 +13,18 @@ bool hdns_is_valid_ipv6(const char *ipv6);
 
 bool hdns_is_valid_ipv4(const char *ip);
 
+/*
+ * 原地规范化域名：去掉末尾的点并转为小写，长度为0或超过HDNS_MAX_DOMAIN_LENGTH时返回HDNS_INVALID_ARGUMENT
+ */
+int32_t hdns_canonicalize_host(char *host);
+
+bool hdns_is_ip_literal(const char *host);
+
+/*
+ * 计算IP所在子网，格式为"网络地址/前缀长度"，如1.2.3.0/24，IP非法时返回NULL
+ */
+char *hdns_ip_to_subnet(hdns_pool_t *pool, const char *ip, int32_t ipv4_prefix_len, int32_t ipv6_prefix_len);
+
 void hdns_md5(const char* content, size_t size, char* digest);
 
 void hdns_encode_hex(const unsigned char* data, size_t size, char* hex);
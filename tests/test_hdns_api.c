@@ -513,6 +513,267 @@ void test_hdns_get_results_for_hosts_async_without_cache(CuTest *tc) {
     CuAssert(tc, "test_hdns_get_results_for_hosts_async_without_cache failed", success && !hit_cache);
 }
 
+void test_hdns_get_results_for_hosts_from_cache(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_pool_new(pool);
+    hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(pool, "www.aliyun.com", HDNS_RR_TYPE_A);
+    hdns_list_add(resp->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(client->cache, resp);
+    hdns_pool_destroy(pool);
+
+    hdns_list_head_t *hosts = hdns_list_create();
+    hdns_list_add_str(hosts, "www.aliyun.com");
+    hdns_list_head_t *results = NULL;
+    hdns_status_t status = hdns_get_results_for_hosts_from_cache(client, hosts, HDNS_QUERY_IPV4, &results);
+    char ip[HDNS_IP_ADDRESS_STRING_LENGTH];
+    bool is_expected = hdns_status_is_ok(&status)
+                       && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK
+                       && strcmp(ip, "1.1.1.1") == 0;
+    hdns_list_free(results);
+
+    // 未命中的域名返回空结果，不发起网络请求
+    hdns_list_add_str(hosts, "www.taobao.com");
+    status = hdns_get_results_for_hosts_from_cache(client, hosts, HDNS_QUERY_IPV4, &results);
+    is_expected = is_expected && !hdns_status_is_ok(&status) && hdns_list_size(results) == 2;
+    hdns_list_free(results);
+
+    hdns_list_free(hosts);
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_get_results_for_hosts_from_cache failed", is_expected);
+}
+
+void test_hdns_host_canonicalization(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_pool_new(pool);
+    hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(pool, "www.aliyun.com", HDNS_RR_TYPE_A);
+    hdns_list_add(resp->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(client->cache, resp);
+    hdns_pool_destroy(pool);
+
+    // 大小写和末尾的点不同的域名命中同一个缓存条目
+    hdns_list_head_t *hosts = hdns_list_create();
+    hdns_list_add_str(hosts, "WWW.Aliyun.COM.");
+    hdns_list_head_t *results = NULL;
+    hdns_status_t status = hdns_get_results_for_hosts_from_cache(client, hosts, HDNS_QUERY_IPV4, &results);
+    char ip[HDNS_IP_ADDRESS_STRING_LENGTH];
+    bool is_expected = hdns_status_is_ok(&status)
+                       && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK
+                       && strcmp(ip, "1.1.1.1") == 0;
+    hdns_list_free(results);
+    hdns_list_free(hosts);
+
+    // IP字面量直接返回，不查询缓存和服务端
+    status = hdns_get_result_for_host_sync_with_cache(client, "2.2.2.2", HDNS_QUERY_IPV4, NULL, &results);
+    is_expected = is_expected
+                  && hdns_status_is_ok(&status)
+                  && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK
+                  && strcmp(ip, "2.2.2.2") == 0;
+    hdns_list_free(results);
+
+    status = hdns_get_result_for_host_sync_with_cache(client, ".", HDNS_QUERY_IPV4, NULL, &results);
+    is_expected = is_expected && !hdns_status_is_ok(&status) && results == NULL;
+
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_host_canonicalization failed", is_expected);
+}
+
+void test_hdns_client_subnet_cache(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_pool_new(pool);
+    hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(pool, "www.aliyun.com", HDNS_RR_TYPE_A);
+    hdns_list_add(resp->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(client->cache, resp);
+    resp = hdns_resv_resp_create_empty(pool, "www.aliyun.com", HDNS_RR_TYPE_A);
+    resp->cache_key = "www.aliyun.com" HDNS_CLIENT_SUBNET_SEPARATOR "1.2.3.0/24";
+    hdns_list_add(resp->ips, "3.3.3.3", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(client->cache, resp);
+    hdns_pool_destroy(pool);
+
+    // 开启后同一子网的client_ip命中分区条目
+    hdns_client_set_client_subnet_cache(client, true, 24, 56);
+    hdns_list_head_t *results = NULL;
+    char ip[HDNS_IP_ADDRESS_STRING_LENGTH];
+    hdns_status_t status = hdns_get_result_for_host_sync_with_cache(client,
+                                                                    "www.aliyun.com",
+                                                                    HDNS_QUERY_IPV4,
+                                                                    "1.2.3.99",
+                                                                    &results);
+    bool is_expected = hdns_status_is_ok(&status)
+                       && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK
+                       && strcmp(ip, "3.3.3.3") == 0;
+    hdns_list_free(results);
+
+    // 关闭后按域名缓存
+    hdns_client_set_client_subnet_cache(client, false, 0, 0);
+    status = hdns_get_result_for_host_sync_with_cache(client, "www.aliyun.com", HDNS_QUERY_IPV4, "1.2.3.99", &results);
+    is_expected = is_expected
+                  && hdns_status_is_ok(&status)
+                  && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK
+                  && strcmp(ip, "1.1.1.1") == 0;
+    hdns_list_free(results);
+
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_client_subnet_cache failed", is_expected);
+}
+
+void test_hdns_sdns_cache_key(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_pool_new(pool);
+    hdns_resv_req_t *req1 = hdns_resv_req_create(client);
+    hdns_resv_req_t *req2 = hdns_resv_req_create(client);
+    hdns_resv_req_set_host(req1, "www.aliyun.com");
+    hdns_resv_req_set_host(req2, "www.aliyun.com");
+    // 无SDNS参数时不派生
+    bool is_expected = NULL == hdns_resv_req_sdns_cache_key(pool, req1);
+
+    // 参数顺序不影响缓存键
+    hdns_resv_req_append_sdns_param(req1, "region", "hz");
+    hdns_resv_req_append_sdns_param(req1, "isp", "cmcc");
+    hdns_resv_req_append_sdns_param(req2, "isp", "cmcc");
+    hdns_resv_req_append_sdns_param(req2, "region", "hz");
+    char *key1 = hdns_resv_req_sdns_cache_key(pool, req1);
+    char *key2 = hdns_resv_req_sdns_cache_key(pool, req2);
+    is_expected = is_expected
+                  && key1 != NULL
+                  && strncmp(key1, "www.aliyun.com" HDNS_SDNS_CACHE_KEY_SEPARATOR,
+                             strlen("www.aliyun.com" HDNS_SDNS_CACHE_KEY_SEPARATOR)) == 0
+                  && strcmp(key1, key2) == 0;
+
+    // 参数值不同则缓存键不同
+    apr_table_set(req2->sdns_params, "region", "sh");
+    key2 = hdns_resv_req_sdns_cache_key(pool, req2);
+    is_expected = is_expected && strcmp(key1, key2) != 0;
+
+    // 键值边界不同则缓存键不同
+    hdns_resv_req_t *req3 = hdns_resv_req_create(client);
+    hdns_resv_req_t *req4 = hdns_resv_req_create(client);
+    hdns_resv_req_set_host(req3, "www.aliyun.com");
+    hdns_resv_req_set_host(req4, "www.aliyun.com");
+    hdns_resv_req_append_sdns_param(req3, "a=b", "c");
+    hdns_resv_req_append_sdns_param(req4, "a", "b=c");
+    key1 = hdns_resv_req_sdns_cache_key(pool, req3);
+    key2 = hdns_resv_req_sdns_cache_key(pool, req4);
+    is_expected = is_expected && strcmp(key1, key2) != 0;
+
+    hdns_pool_destroy(pool);
+    hdns_resv_req_cleanup(req1);
+    hdns_resv_req_cleanup(req2);
+    hdns_resv_req_cleanup(req3);
+    hdns_resv_req_cleanup(req4);
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_sdns_cache_key failed", is_expected);
+}
+
+typedef struct {
+    int calls;
+    size_t old_count;
+    size_t new_count;
+} host_update_record_t;
+
+static void record_host_update(const char *host,
+                               hdns_rr_type_t type,
+                               const hdns_list_head_t *old_ips,
+                               const hdns_list_head_t *new_ips,
+                               void *param) {
+    hdns_unused_var(host);
+    hdns_unused_var(type);
+    host_update_record_t *record = param;
+    record->calls++;
+    record->old_count = hdns_list_size(old_ips);
+    record->new_count = hdns_list_size(new_ips);
+}
+
+static void add_test_cache_entry(hdns_cache_t *cache, const char *host, const char *ip1, const char *ip2) {
+    hdns_pool_new(pool);
+    hdns_resv_resp_t *resp = hdns_resv_resp_create_empty(pool, host, HDNS_RR_TYPE_A);
+    hdns_list_add(resp->ips, ip1, hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(resp->ips, ip2, hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, resp);
+    hdns_pool_destroy(pool);
+}
+
+void test_hdns_subscribe_host_update(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    host_update_record_t host_record = {0};
+    host_update_record_t global_record = {0};
+    hdns_client_subscribe_host_update(client, "WWW.Aliyun.com", record_host_update, &host_record);
+    hdns_client_subscribe_host_update(client, NULL, record_host_update, &global_record);
+
+    // 首次写入视为变化，IP相同仅顺序不同时不通知
+    add_test_cache_entry(client->cache, "www.aliyun.com", "1.1.1.1", "2.2.2.2");
+    add_test_cache_entry(client->cache, "www.aliyun.com", "2.2.2.2", "1.1.1.1");
+    bool is_expected = host_record.calls == 1 && host_record.old_count == 0 && host_record.new_count == 2;
+    add_test_cache_entry(client->cache, "www.aliyun.com", "1.1.1.1", "3.3.3.3");
+    is_expected = is_expected && host_record.calls == 2 && host_record.old_count == 2;
+    // 其他域名只通知全局订阅者
+    add_test_cache_entry(client->cache, "www.taobao.com", "4.4.4.4", "5.5.5.5");
+    is_expected = is_expected && host_record.calls == 2 && global_record.calls == 3;
+
+    hdns_status_t status = hdns_client_unsubscribe_host_update(client, "www.aliyun.com", record_host_update, &host_record);
+    add_test_cache_entry(client->cache, "www.aliyun.com", "6.6.6.6", "7.7.7.7");
+    is_expected = is_expected && hdns_status_is_ok(&status) && host_record.calls == 2 && global_record.calls == 4;
+
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_subscribe_host_update failed", is_expected);
+}
+
+void test_hdns_account_shared_cache(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client1 = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_client_t *client2 = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_client_t *client3 = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_client_enable_account_shared_cache(client1, true);
+    hdns_client_enable_account_shared_cache(client2, true);
+    hdns_client_enable_account_shared_cache(client3, true);
+    // region不同的客户端不共享
+    hdns_client_set_region(client3, "sg");
+    // 启动前的订阅在加入分组后依然有效
+    host_update_record_t record = {0};
+    hdns_client_subscribe_host_update(client2, "www.aliyun.com", record_host_update, &record);
+    // 后加入成员启动前的缓存设置合并到共享缓存
+    hdns_client_set_cache_capacity(client2, 1024, 0);
+    hdns_client_enable_host_cache_stats(client2, true);
+    hdns_client_start(client1);
+    hdns_client_start(client2);
+    hdns_client_start(client3);
+    bool is_expected = client1->cache == client2->cache
+                       && client1->scheduler == client2->scheduler
+                       && client1->flights == client2->flights
+                       && client1->cache != client3->cache
+                       && client1->cache->max_entries == 1024
+                       && apr_atomic_read32(&client1->cache->host_stats_enabled) == 1;
+
+    add_test_cache_entry(client1->cache, "www.aliyun.com", "1.1.1.1", "2.2.2.2");
+    is_expected = is_expected && record.calls == 1;
+    hdns_list_head_t *results = NULL;
+    hdns_status_t status = hdns_get_result_for_host_sync_with_cache(client2,
+                                                                    "www.aliyun.com",
+                                                                    HDNS_QUERY_IPV4,
+                                                                    NULL,
+                                                                    &results);
+    char ip[HDNS_IP_ADDRESS_STRING_LENGTH];
+    is_expected = is_expected
+                  && hdns_status_is_ok(&status)
+                  && hdns_select_first_ip(results, HDNS_QUERY_IPV4, ip) == HDNS_OK;
+    hdns_list_free(results);
+
+    hdns_client_cleanup(client1);
+    hdns_client_cleanup(client2);
+    hdns_client_cleanup(client3);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_account_shared_cache failed", is_expected);
+}
+
 void test_hdns_log(CuTest *tc) {
     hdns_sdk_init();
 #ifdef TEST_DEBUG_LOG
@@ -739,6 +1000,12 @@ void add_hdns_api_tests(CuSuite *suite) {
     SUITE_ADD_TEST(suite, test_hdns_get_result_for_host_async_without_cache);
     SUITE_ADD_TEST(suite, test_hdns_get_results_for_hosts_async_with_cache);
     SUITE_ADD_TEST(suite, test_hdns_get_results_for_hosts_async_without_cache);
+    SUITE_ADD_TEST(suite, test_hdns_get_results_for_hosts_from_cache);
+    SUITE_ADD_TEST(suite, test_hdns_host_canonicalization);
+    SUITE_ADD_TEST(suite, test_hdns_client_subnet_cache);
+    SUITE_ADD_TEST(suite, test_hdns_sdns_cache_key);
+    SUITE_ADD_TEST(suite, test_hdns_subscribe_host_update);
+    SUITE_ADD_TEST(suite, test_hdns_account_shared_cache);
     SUITE_ADD_TEST(suite, test_hdns_log);
     SUITE_ADD_TEST(suite, test_clean_host_cache);
     SUITE_ADD_TEST(suite, test_hdns_client_enable_update_cache_after_net_change);
@@ -76,6 +76,782 @@ void test_update_cache_entry(CuTest *tc) {
     CuAssert(tc, "test_update_cache_entry failed", is_expected);
 }
 
+void test_shared_cache_entry(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_cache_table_add(client->cache, create_test_cache_entry(client->cache, "k1.com", 60));
+    hdns_cache_entry_t *entry1 = hdns_cache_table_get(client->cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_cache_entry_t *entry2 = hdns_cache_table_get(client->cache, "k1.com", HDNS_RR_TYPE_A);
+    bool is_shared = (NULL != entry1 && entry1 == entry2);
+    // 更新后旧条目仍被持有，读取不受影响
+    hdns_cache_table_add(client->cache, create_test_cache_entry(client->cache, "k1.com", 80));
+    bool is_alive = is_shared && entry1->ttl == 60;
+    hdns_resv_resp_destroy(entry1);
+    hdns_resv_resp_destroy(entry2);
+    hdns_cache_entry_t *entry = hdns_cache_table_get(client->cache, "k1.com", HDNS_RR_TYPE_A);
+    bool is_updated = (NULL != entry && entry->ttl == 80);
+    hdns_resv_resp_destroy(entry);
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_shared_cache_entry failed", is_shared && is_alive && is_updated);
+}
+
+void test_cache_get_both(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *ipv4_entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_cache_entry_t *ipv6_entry = create_test_cache_entry(cache, "k1.com", 10);
+    ipv6_entry->type = HDNS_RR_TYPE_AAAA;
+    hdns_cache_table_add(cache, ipv4_entry);
+    hdns_cache_table_add(cache, ipv6_entry);
+
+    hdns_cache_entry_t *ipv4_resp = NULL;
+    hdns_cache_entry_t *ipv6_resp = NULL;
+    hdns_cache_table_get_both(cache, "k1.com", &ipv4_resp, &ipv6_resp);
+    // 同一域名的两种类型TTL互相独立
+    bool is_expected = ipv4_resp != NULL && ipv4_resp->ttl == 60
+                       && ipv6_resp != NULL && ipv6_resp->ttl == 10;
+    hdns_resv_resp_destroy(ipv4_resp);
+    hdns_resv_resp_destroy(ipv6_resp);
+
+    // 删除一种类型不影响另一种
+    hdns_cache_table_delete(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_cache_table_get_both(cache, "k1.com", &ipv4_resp, &ipv6_resp);
+    is_expected = is_expected && ipv4_resp == NULL && ipv6_resp != NULL;
+    hdns_resv_resp_destroy(ipv6_resp);
+
+    hdns_cache_table_delete(cache, "k1.com", HDNS_RR_TYPE_AAAA);
+    hdns_cache_table_get_both(cache, "k1.com", &ipv4_resp, &ipv6_resp);
+    is_expected = is_expected && ipv4_resp == NULL && ipv6_resp == NULL;
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_get_both failed", is_expected);
+}
+
+void test_cache_lru_eviction(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create_with_shards(1);
+    hdns_cache_table_set_capacity(cache, 2, 0);
+    hdns_cache_table_add(cache, create_test_cache_entry(cache, "k1.com", 60));
+    hdns_cache_table_add(cache, create_test_cache_entry(cache, "k2.com", 60));
+    // 访问k1后，k2成为最久未访问的条目
+    hdns_resv_resp_destroy(hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A));
+    hdns_cache_table_add(cache, create_test_cache_entry(cache, "k3.com", 60));
+    hdns_cache_entry_t *entry1 = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_cache_entry_t *entry2 = hdns_cache_table_get(cache, "k2.com", HDNS_RR_TYPE_A);
+    hdns_cache_entry_t *entry3 = hdns_cache_table_get(cache, "k3.com", HDNS_RR_TYPE_A);
+    bool is_expected = (NULL != entry1 && NULL == entry2 && NULL != entry3
+                        && hdns_cache_table_get_evictions(cache) == 1);
+    hdns_resv_resp_destroy(entry1);
+    hdns_resv_resp_destroy(entry3);
+
+    // 一次淘汰的条目超出内联容量时同样在锁外统一释放
+    hdns_cache_table_set_capacity(cache, 0, 0);
+    char key[32];
+    for (int i = 0; i < 40; i++) {
+        apr_snprintf(key, sizeof(key), "batch%d.com", i);
+        hdns_cache_table_add(cache, create_test_cache_entry(cache, key, 60));
+    }
+    hdns_cache_table_set_capacity(cache, 1, 0);
+    hdns_cache_stats_t stats;
+    hdns_cache_table_get_stats(cache, &stats);
+    is_expected = is_expected && stats.entries == 1 && hdns_cache_table_get_evictions(cache) == 42;
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_lru_eviction failed", is_expected);
+}
+
+void test_cache_entry_prefetch(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *fresh_entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_cache_entry_t *aging_entry = create_test_cache_entry(cache, "k2.com", 60);
+    hdns_list_add(fresh_entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(aging_entry->ips, "1.1.1.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    aging_entry->query_time = hdns_clock_now() - apr_time_from_sec(50);
+    bool is_expected = !hdns_cache_entry_need_prefetch(fresh_entry, 0.75f)
+                       && hdns_cache_entry_need_prefetch(aging_entry, 0.75f)
+                       && !hdns_cache_entry_need_prefetch(aging_entry, 0)
+                       // 同一条目只允许一个调用方触发预取
+                       && hdns_cache_entry_try_mark_prefetch(aging_entry)
+                       && !hdns_cache_entry_try_mark_prefetch(aging_entry);
+    hdns_cache_entry_unmark_prefetch(aging_entry);
+    is_expected = is_expected && hdns_cache_entry_try_mark_prefetch(aging_entry);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_entry_prefetch failed", is_expected);
+}
+
+void test_cache_negative_entry(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    // 没有AAAA记录的域名写入空结果
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 30);
+    entry->type = HDNS_RR_TYPE_AAAA;
+    entry->origin_ttl = 30;
+    entry->query_time = hdns_clock_now() - apr_time_from_sec(25);
+    hdns_cache_table_add(cache, entry);
+    hdns_cache_entry_t *negative_entry = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_AAAA);
+    hdns_cache_entry_t *ipv4_entry = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    bool is_expected = negative_entry != NULL
+                       && hdns_cache_entry_is_negative(negative_entry)
+                       && !hdns_cache_entry_is_expired(negative_entry)
+                       && !hdns_cache_entry_need_prefetch(negative_entry, 0.75f)
+                       && ipv4_entry == NULL;
+    hdns_resv_resp_destroy(negative_entry);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_negative_entry failed", is_expected);
+}
+
+void test_cache_timer_wheel_expiry(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    apr_thread_pool_t *thread_pool = NULL;
+    apr_thread_pool_create(&thread_pool, 1, 1, pool);
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_table_set_refresh_ratio(cache, 0.5f);
+    hdns_cache_table_start_expiry(cache, thread_pool);
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    entry->origin_ttl = 60;
+    apr_time_t now = hdns_clock_now();
+    entry->query_time = now;
+    hdns_cache_table_add(cache, entry);
+
+    hdns_cache_entry_t *cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    bool is_expected = apr_atomic_read32(&cached->expiry_state) == HDNS_CACHE_ENTRY_FRESH
+                       && !hdns_cache_entry_is_expired(cached);
+    // 状态由时间轮推进决定
+    hdns_cache_table_expire(cache, now + apr_time_from_sec(31));
+    is_expected = is_expected && hdns_cache_entry_need_prefetch(cached, 0.5f) && !hdns_cache_entry_is_expired(cached);
+    hdns_cache_table_expire(cache, now + apr_time_from_sec(61));
+    hdns_cache_stats_t stats;
+    hdns_cache_table_get_stats(cache, &stats);
+    is_expected = is_expected && hdns_cache_entry_is_expired(cached) && stats.expirations == 1;
+    hdns_resv_resp_destroy(cached);
+
+    // 过期条目在保留期内仍可作为过期IP读取，超过后回收
+    cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && cached != NULL;
+    hdns_resv_resp_destroy(cached);
+    hdns_cache_table_expire(cache, now + apr_time_from_sec(61 + HDNS_CACHE_STALE_RETENTION_SEC));
+    cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && cached == NULL;
+
+    hdns_cache_table_cleanup(cache);
+    apr_thread_pool_destroy(thread_pool);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_timer_wheel_expiry failed", is_expected);
+}
+
+void test_cache_virtual_clock(CuTest *tc) {
+    hdns_sdk_init();
+    apr_time_t start = apr_time_from_sec(1000);
+    hdns_clock_use_virtual(start);
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    bool is_expected = entry->query_time == start
+                       && !hdns_cache_entry_is_expired(entry)
+                       && !hdns_cache_entry_need_prefetch(entry, 0.75f);
+    // TTL只随时钟推进变化
+    hdns_clock_advance(apr_time_from_sec(50));
+    is_expected = is_expected && !hdns_cache_entry_is_expired(entry) && hdns_cache_entry_need_prefetch(entry, 0.75f);
+    hdns_clock_advance(apr_time_from_sec(10));
+    is_expected = is_expected && hdns_cache_entry_is_expired(entry);
+    // 与日历时间换算后可还原，两次读取日历时间之间的误差远小于1秒
+    apr_time_t wall_time = hdns_clock_to_wall_time(entry->query_time);
+    apr_time_t restored_time = hdns_clock_from_wall_time(wall_time);
+    is_expected = is_expected
+                  && wall_time < apr_time_now()
+                  && restored_time - entry->query_time < APR_USEC_PER_SEC
+                  && entry->query_time - restored_time < APR_USEC_PER_SEC;
+
+    hdns_clock_use_real();
+    apr_time_t now = hdns_clock_now();
+    is_expected = is_expected && now != start + apr_time_from_sec(60) && hdns_clock_now() >= now;
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_virtual_clock failed", is_expected);
+}
+
+void test_cache_stats(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_table_enable_host_stats(cache, true);
+    hdns_cache_entry_t *fresh_entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_cache_entry_t *stale_entry = create_test_cache_entry(cache, "k2.com", 60);
+    stale_entry->query_time = hdns_clock_now() - apr_time_from_sec(120);
+    hdns_cache_table_add(cache, fresh_entry);
+    hdns_cache_table_add(cache, stale_entry);
+
+    hdns_resv_resp_destroy(hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A));
+    hdns_resv_resp_destroy(hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A));
+    hdns_resv_resp_destroy(hdns_cache_table_get(cache, "k2.com", HDNS_RR_TYPE_A));
+    hdns_resv_resp_destroy(hdns_cache_table_get(cache, "k3.com", HDNS_RR_TYPE_A));
+    hdns_cache_entry_t *ipv4_entry = NULL;
+    hdns_cache_entry_t *ipv6_entry = NULL;
+    hdns_cache_table_get_both(cache, "k1.com", &ipv4_entry, &ipv6_entry);
+    hdns_resv_resp_destroy(ipv4_entry);
+
+    hdns_cache_stats_t stats;
+    hdns_cache_table_get_stats(cache, &stats);
+    bool is_expected = stats.hits == 3 && stats.stale_hits == 1 && stats.misses == 2
+                       && stats.inserts == 2 && stats.entries == 2 && stats.bytes > 0;
+    hdns_cache_stats_t host_stats;
+    is_expected = is_expected
+                  && hdns_cache_table_get_host_stats(cache, "k1.com", &host_stats) == HDNS_OK
+                  && host_stats.hits == 3 && host_stats.misses == 1 && host_stats.entries == 1
+                  && hdns_cache_table_get_host_stats(cache, "k3.com", &host_stats) != HDNS_OK;
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_stats failed", is_expected);
+}
+
+void test_cache_entry_sockaddrs(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    entry->type = HDNS_RR_TYPE_AAAA;
+    hdns_list_add(entry->ips, "2001:db8::1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "invalid", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "2001:db8::2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+
+    // 写入缓存时生成二进制地址，无法解析的IP被跳过
+    hdns_cache_entry_t *cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_AAAA);
+    struct sockaddr_storage addrs[4];
+    int count = hdns_resv_resp_to_sockaddrs(cached, 443, addrs, 4);
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &addrs[1];
+    bool is_expected = cached->addrs != NULL && cached->addr_count == 2 && count == 2
+                       && sin6->sin6_family == AF_INET6
+                       && ntohs(sin6->sin6_port) == 443
+                       && sin6->sin6_addr.s6_addr[15] == 2
+                       && hdns_resv_resp_to_sockaddrs(cached, 443, addrs, 1) == 1;
+    hdns_resv_resp_destroy(cached);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_entry_sockaddrs failed", is_expected);
+}
+
+void test_cache_slab_entry(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+
+    // 条目整体分配在slab上，不再独占pool
+    hdns_cache_entry_t *cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_slab_stats_t stats;
+    hdns_slab_get_stats(cache->slab, &stats);
+    bool is_expected = cached != NULL
+                       && cached->pool == NULL
+                       && cached->slab == cache->slab
+                       && cached->host == NULL
+                       && strcmp(cached->cache_key, "k1.com") == 0
+                       && hdns_list_size(cached->ips) == 2
+                       && strcmp(hdns_list_get(cached->ips, 1), "2.2.2.2") == 0
+                       && cached->addr_count == 2
+                       && stats.used_blocks == 1
+                       && stats.used_bytes < 1024;
+    // 缓存条目没有pool，传入resp->pool时在线程本地的临时pool上格式化
+    char *resp_str = cached != NULL ? hdns_resv_resp_to_str(cached->pool, cached) : NULL;
+    is_expected = is_expected && resp_str != NULL && strstr(resp_str, "ips=[1.1.1.1,2.2.2.2]") != NULL;
+
+    // 删除后块回到空闲链表，再次写入时复用，不再申请新的chunk
+    hdns_cache_table_delete(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_resv_resp_destroy(cached);
+    hdns_slab_get_stats(cache->slab, &stats);
+    uint64_t reserved_bytes = stats.reserved_bytes;
+    is_expected = is_expected && stats.used_blocks == 0;
+    hdns_cache_table_add(cache, entry);
+    hdns_slab_get_stats(cache->slab, &stats);
+    is_expected = is_expected && stats.used_blocks == 1 && stats.reserved_bytes == reserved_bytes;
+
+    // 缓存销毁后，调用方持有的条目依然有效
+    cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_cache_table_cleanup(cache);
+    is_expected = is_expected && cached != NULL && strcmp(hdns_list_get(cached->ips, 0), "1.1.1.1") == 0;
+    hdns_resv_resp_destroy(cached);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_slab_entry failed", is_expected);
+}
+
+void test_cache_scratch(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create_scratch();
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+
+    // 临时缓存只有一个分段，条目使用独立pool，不统计访问频次
+    hdns_cache_table_record_access(cache, "k1.com");
+    hdns_cache_entry_t *cached = hdns_cache_table_get(cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_list_head_t *hot_keys = hdns_cache_table_get_hot_keys(cache);
+    bool is_expected = cache->shard_count == 1
+                       && cache->slab == NULL
+                       && cached != NULL
+                       && cached->pool != NULL
+                       && strcmp(hdns_list_get(cached->ips, 0), "1.1.1.1") == 0
+                       && hdns_cache_table_get_access_frequency(cache, "k1.com") == 0
+                       && hdns_list_is_empty(hot_keys);
+    hdns_list_free(hot_keys);
+
+    // 没有时间轮，不能启动过期推进
+    hdns_status_t status = hdns_cache_table_start_expiry(cache, NULL);
+    is_expected = is_expected && !hdns_status_is_ok(&status);
+    hdns_resv_resp_destroy(cached);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_scratch failed", is_expected);
+}
+
+void test_cache_batch(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_pool_new(pool);
+    hdns_list_head_t *entries = hdns_list_new(pool);
+    const char *keys[] = {"k1.com", "k2.com", "k3.com", "k4.com"};
+    for (int i = 0; i < 3; i++) {
+        hdns_cache_entry_t *entry = create_test_cache_entry(cache, (char *) keys[i], 60);
+        hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+        hdns_list_add(entries, entry, NULL);
+    }
+    hdns_cache_entry_t *ipv6_entry = create_test_cache_entry(cache, "k2.com", 60);
+    ipv6_entry->type = HDNS_RR_TYPE_AAAA;
+    hdns_list_add(ipv6_entry->ips, "2001:db8::1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entries, ipv6_entry, NULL);
+    hdns_cache_table_add_batch(cache, entries);
+
+    hdns_cache_entry_t *results[4 * HDNS_CACHE_FAMILY_COUNT];
+    hdns_cache_table_get_batch(cache, keys, 4, true, true, results);
+    bool is_expected = results[0] != NULL && results[1] == NULL
+                       && results[2] != NULL && results[3] != NULL
+                       && results[4] != NULL && results[5] == NULL
+                       && results[6] == NULL && results[7] == NULL
+                       && strcmp(results[2]->cache_key, "k2.com") == 0
+                       && results[3]->type == HDNS_RR_TYPE_AAAA;
+    for (int i = 0; i < 4 * HDNS_CACHE_FAMILY_COUNT; i++) {
+        hdns_resv_resp_destroy(results[i]);
+    }
+    // 只查询A记录时AAAA位置为空
+    hdns_cache_table_get_batch(cache, keys, 4, true, false, results);
+    is_expected = is_expected && results[2] != NULL && results[3] == NULL;
+    for (int i = 0; i < 4 * HDNS_CACHE_FAMILY_COUNT; i++) {
+        hdns_resv_resp_destroy(results[i]);
+    }
+    hdns_cache_stats_t stats;
+    hdns_cache_table_get_stats(cache, &stats);
+    is_expected = is_expected && stats.inserts == 4 && stats.entries == 4;
+
+    hdns_pool_destroy(pool);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_batch failed", is_expected);
+}
+
+void test_cache_key_cursor(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_pool_new(pool);
+    hdns_list_head_t *entries = hdns_list_new(pool);
+    int host_count = 300;
+    for (int i = 0; i < host_count; i++) {
+        hdns_cache_entry_t *entry = create_test_cache_entry(cache, apr_psprintf(pool, "k%d.com", i), 60);
+        hdns_list_add(entries, entry, NULL);
+    }
+    hdns_cache_table_add_batch(cache, entries);
+
+    // 每批不超过limit，遍历结束后键数与写入一致且不重复
+    hdns_cache_key_cursor_t cursor;
+    hdns_cache_key_cursor_init(&cursor, HDNS_RR_TYPE_A);
+    hdns_list_head_t *keys = hdns_list_new(pool);
+    bool is_expected = true;
+    while (!cursor.finished) {
+        size_t count = hdns_cache_key_cursor_next(cache, &cursor, 7, keys);
+        is_expected = is_expected && count <= 7;
+    }
+    hdns_htable_t *seen = hdns_htable_make(pool);
+    hdns_list_for_each_entry(key_cursor, keys) {
+        hdns_htable_set(seen, key_cursor->data, key_cursor->data);
+    }
+    is_expected = is_expected
+                  && hdns_list_size(keys) == (size_t) host_count
+                  && hdns_htable_count(seen) == (size_t) host_count;
+
+    // 没有AAAA条目时直接结束
+    hdns_cache_key_cursor_init(&cursor, HDNS_RR_TYPE_AAAA);
+    is_expected = is_expected
+                  && hdns_cache_key_cursor_next(cache, &cursor, 7, keys) == 0
+                  && cursor.finished;
+
+    hdns_pool_destroy(pool);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_key_cursor failed", is_expected);
+}
+
+void test_cache_hot_keys(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_pool_new(pool);
+    for (int i = 0; i < 100; i++) {
+        hdns_cache_table_record_access(cache, "hot.com");
+        hdns_cache_table_record_access(cache, apr_psprintf(pool, "cold%d.com", i));
+        if (i % 3 == 0) {
+            hdns_cache_table_record_access(cache, "warm.com");
+        }
+    }
+    // 冷门键超出热点集合容量，只保留频次最高的键
+    hdns_list_head_t *hot_keys = hdns_cache_table_get_hot_keys(cache);
+    hdns_sketch_hot_item_t *first = hdns_list_get(hot_keys, 0);
+    hdns_sketch_hot_item_t *second = hdns_list_get(hot_keys, 1);
+    bool is_expected = hdns_list_size(hot_keys) == HDNS_SKETCH_HOT_KEY_CAPACITY
+                       && first != NULL
+                       && strcmp(first->key, "hot.com") == 0
+                       && first->count >= 100
+                       && second != NULL
+                       && strcmp(second->key, "warm.com") == 0
+                       && hdns_cache_table_get_access_frequency(cache, "hot.com") >= 100
+                       && hdns_cache_table_get_access_frequency(cache, "warm.com") >= 34
+                       && hdns_cache_table_get_access_frequency(cache, "cold1.com") < 34
+                       && hdns_cache_table_get_access_frequency(cache, "never.com") < 34;
+    hdns_list_free(hot_keys);
+
+    // 未到衰减间隔时不衰减，超过间隔后频次减半，热点集合保持不变
+    uint32_t frequency = hdns_cache_table_get_access_frequency(cache, "hot.com");
+    hdns_cache_table_decay_access(cache);
+    is_expected = is_expected && hdns_cache_table_get_access_frequency(cache, "hot.com") == frequency;
+    hdns_clock_use_virtual(hdns_clock_now() + apr_time_from_sec(HDNS_SKETCH_DECAY_INTERVAL_SEC));
+    hdns_cache_table_decay_access(cache);
+    hdns_clock_use_real();
+    hot_keys = hdns_cache_table_get_hot_keys(cache);
+    first = hdns_list_get(hot_keys, 0);
+    is_expected = is_expected
+                  && hdns_cache_table_get_access_frequency(cache, "hot.com") == frequency / 2
+                  && first != NULL
+                  && strcmp(first->key, "hot.com") == 0
+                  && first->count == frequency / 2;
+    hdns_list_free(hot_keys);
+
+    hdns_pool_destroy(pool);
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_hot_keys failed", is_expected);
+}
+
+void test_cache_local(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *cache = hdns_cache_table_create();
+    hdns_cache_entry_t *ipv4_entry = NULL;
+    hdns_cache_entry_t *ipv6_entry = NULL;
+    bool is_expected = !hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry);
+
+    hdns_cache_table_enable_local_cache(cache, true);
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry != NULL
+                  && ipv6_entry == NULL;
+    // 重复查找命中本地缓存，不再访问分段
+    hdns_cache_stats_t stats;
+    hdns_cache_table_get_stats(cache, &stats);
+    hdns_cache_entry_t *cached_entry = ipv4_entry;
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry == cached_entry;
+    hdns_cache_stats_t hit_stats;
+    hdns_cache_table_get_stats(cache, &hit_stats);
+    is_expected = is_expected && hit_stats.hits == stats.hits && hit_stats.misses == stats.misses;
+
+    // 其他缓存的写入不影响本缓存的本地缓存
+    hdns_cache_t *other_cache = hdns_cache_table_create();
+    hdns_cache_table_add(other_cache, create_test_cache_entry(other_cache, "k1.com", 60));
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry == cached_entry;
+    hdns_cache_table_get_stats(cache, &hit_stats);
+    is_expected = is_expected && hit_stats.hits == stats.hits && hit_stats.misses == stats.misses;
+    hdns_cache_table_cleanup(other_cache);
+
+    // 写入新条目后本地缓存失效
+    entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry != NULL
+                  && strcmp(hdns_list_first(ipv4_entry->ips)->data, "2.2.2.2") == 0;
+    hdns_cache_table_delete(cache, "k1.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k1.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry == NULL;
+
+    // 本地缓存持有的条目在缓存释放后由SDK清理时回收
+    hdns_cache_table_add(cache, create_test_cache_entry(cache, "k2.com", 60));
+    is_expected = is_expected
+                  && hdns_cache_table_get_both_local(cache, "k2.com", &ipv4_entry, &ipv6_entry)
+                  && ipv4_entry != NULL;
+    hdns_cache_table_cleanup(cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_local failed", is_expected);
+}
+
+static void count_cache_update(const char *host,
+                               hdns_rr_type_t type,
+                               const hdns_list_head_t *old_ips,
+                               const hdns_list_head_t *new_ips,
+                               void *param) {
+    hdns_unused_var(host);
+    hdns_unused_var(type);
+    hdns_unused_var(old_ips);
+    hdns_unused_var(new_ips);
+    (*(int *) param)++;
+}
+
+static void add_subscribed_entry(hdns_cache_t *cache, const char *ip) {
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    entry->host = apr_pstrdup(entry->pool, "k1.com");
+    hdns_list_add(entry->ips, ip, hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+}
+
+void test_cache_subscriber_owner(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_cache_t *own_cache = hdns_cache_table_create();
+    hdns_cache_t *shared_cache = hdns_cache_table_create();
+    int owner1 = 0;
+    int owner2 = 0;
+    int calls1 = 0;
+    int calls2 = 0;
+    // 不同客户端以相同参数订阅时分别登记
+    hdns_cache_table_subscribe(shared_cache, "k1.com", count_cache_update, &calls1, &owner1);
+    hdns_cache_table_subscribe(own_cache, "k1.com", count_cache_update, &calls2, &owner2);
+    hdns_cache_table_subscribe(shared_cache, "k1.com", count_cache_update, &calls2, &owner1);
+
+    // 启动前的订阅随缓存替换转移到共享缓存
+    hdns_cache_table_move_subscribers(own_cache, shared_cache);
+    add_subscribed_entry(shared_cache, "1.1.1.1");
+    bool is_expected = calls1 == 1 && calls2 == 2;
+
+    // 客户端退出时只取消自己的订阅
+    hdns_cache_table_unsubscribe_owner(shared_cache, &owner2);
+    add_subscribed_entry(shared_cache, "2.2.2.2");
+    is_expected = is_expected
+                  && calls1 == 2
+                  && calls2 == 3
+                  && hdns_cache_table_unsubscribe(shared_cache, "k1.com", count_cache_update, &calls2, &owner2) != HDNS_OK
+                  && hdns_cache_table_unsubscribe(shared_cache, "k1.com", count_cache_update, &calls2, &owner1) == HDNS_OK;
+
+    hdns_cache_table_cleanup(own_cache);
+    hdns_cache_table_cleanup(shared_cache);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_subscriber_owner failed", is_expected);
+}
+
+typedef struct {
+    volatile apr_uint32_t entered;
+    volatile apr_uint32_t finished;
+    hdns_cache_t *cache;
+} slow_update_record_t;
+
+static void slow_cache_update(const char *host,
+                              hdns_rr_type_t type,
+                              const hdns_list_head_t *old_ips,
+                              const hdns_list_head_t *new_ips,
+                              void *param) {
+    hdns_unused_var(host);
+    hdns_unused_var(type);
+    hdns_unused_var(old_ips);
+    hdns_unused_var(new_ips);
+    slow_update_record_t *record = param;
+    apr_atomic_inc32(&record->entered);
+    apr_sleep(200 * 1000);
+    apr_atomic_inc32(&record->finished);
+}
+
+static void *APR_THREAD_FUNC add_subscribed_entry_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    add_subscribed_entry(((slow_update_record_t *) data)->cache, "1.1.1.1");
+    return NULL;
+}
+
+static int g_late_unsubscribe_calls = 0;
+
+static void *APR_THREAD_FUNC unsubscribe_later_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    apr_sleep(50 * 1000);
+    hdns_cache_table_unsubscribe(((slow_update_record_t *) data)->cache,
+                                 "k1.com",
+                                 count_cache_update,
+                                 &g_late_unsubscribe_calls,
+                                 data);
+    return NULL;
+}
+
+typedef struct {
+    int calls;
+    hdns_cache_t *cache;
+} self_unsubscribe_record_t;
+
+static void unsubscribe_self_update(const char *host,
+                                    hdns_rr_type_t type,
+                                    const hdns_list_head_t *old_ips,
+                                    const hdns_list_head_t *new_ips,
+                                    void *param) {
+    hdns_unused_var(host);
+    hdns_unused_var(type);
+    hdns_unused_var(old_ips);
+    hdns_unused_var(new_ips);
+    self_unsubscribe_record_t *record = param;
+    record->calls++;
+    hdns_cache_table_unsubscribe(record->cache, "k1.com", unsubscribe_self_update, record, NULL);
+}
+
+void test_cache_subscriber_unsubscribe(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_cache_t *cache = hdns_cache_table_create();
+    slow_update_record_t record = {0, 0, cache};
+    hdns_cache_table_subscribe(cache, "k1.com", slow_cache_update, &record, NULL);
+    apr_thread_t *thread = NULL;
+    apr_thread_create(&thread, NULL, add_subscribed_entry_task, &record, pool);
+    while (apr_atomic_read32(&record.entered) == 0) {
+        apr_sleep(1000);
+    }
+    // 取消订阅时等待其他线程中正在执行的回调返回
+    hdns_cache_table_unsubscribe(cache, "k1.com", slow_cache_update, &record, NULL);
+    bool is_expected = apr_atomic_read32(&record.finished) == 1;
+    apr_status_t thread_status;
+    apr_thread_join(&thread_status, thread);
+    add_subscribed_entry(cache, "2.2.2.2");
+    is_expected = is_expected && apr_atomic_read32(&record.entered) == 1;
+
+    // 回调中取消自身的订阅不会阻塞
+    self_unsubscribe_record_t self_record = {0, cache};
+    hdns_cache_table_subscribe(cache, "k1.com", unsubscribe_self_update, &self_record, NULL);
+    add_subscribed_entry(cache, "3.3.3.3");
+    add_subscribed_entry(cache, "4.4.4.4");
+    is_expected = is_expected && self_record.calls == 1 && apr_atomic_read32(&cache->subscriber_count) == 0;
+
+    // IP重复次数不同视为变化
+    int calls = 0;
+    hdns_cache_table_subscribe(cache, "k1.com", count_cache_update, &calls, NULL);
+    hdns_cache_entry_t *entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+    entry = create_test_cache_entry(cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_list_add(entry->ips, "2.2.2.2", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+    is_expected = is_expected && calls == 2;
+
+    hdns_cache_table_cleanup(cache);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_subscriber_unsubscribe failed", is_expected);
+}
+
+void test_cache_subscriber_unsubscribe_owner(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_cache_t *cache = hdns_cache_table_create();
+    slow_update_record_t record = {0, 0, cache};
+    hdns_cache_table_subscribe(cache, "k1.com", slow_cache_update, &record, &record);
+    hdns_cache_table_subscribe(cache, "k1.com", count_cache_update, &g_late_unsubscribe_calls, &record);
+    apr_thread_t *add_thread = NULL;
+    apr_thread_create(&add_thread, NULL, add_subscribed_entry_task, &record, pool);
+    while (apr_atomic_read32(&record.entered) == 0) {
+        apr_sleep(1000);
+    }
+    // 按属主取消订阅等待回调期间，其他线程取消后续订阅者不会影响遍历
+    apr_thread_t *unsubscribe_thread = NULL;
+    apr_thread_create(&unsubscribe_thread, NULL, unsubscribe_later_task, &record, pool);
+    hdns_cache_table_unsubscribe_owner(cache, &record);
+    bool is_expected = apr_atomic_read32(&record.finished) == 1
+                       && apr_atomic_read32(&cache->subscriber_count) == 0;
+    apr_status_t thread_status;
+    apr_thread_join(&thread_status, add_thread);
+    apr_thread_join(&thread_status, unsubscribe_thread);
+    add_subscribed_entry(cache, "2.2.2.2");
+    is_expected = is_expected && apr_atomic_read32(&record.entered) == 1;
+
+    hdns_cache_table_cleanup(cache);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_cache_subscriber_unsubscribe_owner failed", is_expected);
+}
+
+void test_shm_cache(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    char *shm_file = apr_psprintf(pool, "/tmp/hdns_test_shm_cache_%d.shm", rand());
+    apr_file_remove(shm_file, pool);
+    // 两个缓存挂载同一共享段，模拟两个worker进程
+    hdns_cache_t *writer_cache = hdns_cache_table_create();
+    hdns_cache_t *reader_cache = hdns_cache_table_create();
+    hdns_cache_table_attach_shm(writer_cache, hdns_shm_cache_open(shm_file, 64));
+    hdns_cache_table_attach_shm(reader_cache, hdns_shm_cache_open(shm_file, 0));
+    bool is_expected = writer_cache->shm != NULL && reader_cache->shm != NULL;
+
+    hdns_cache_entry_t *entry = create_test_cache_entry(writer_cache, "k1.com", 60);
+    hdns_list_add(entry->ips, "1.1.1.1", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(writer_cache, entry);
+    hdns_cache_entry_t *shared_entry = hdns_cache_table_get(reader_cache, "k1.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected
+                  && shared_entry != NULL
+                  && shared_entry->ttl == 60
+                  && strcmp(hdns_list_first(shared_entry->ips)->data, "1.1.1.1") == 0;
+    hdns_resv_resp_destroy(shared_entry);
+
+    hdns_cache_table_delete(writer_cache, "k1.com", HDNS_RR_TYPE_A);
+    hdns_cache_table_delete(reader_cache, "k1.com", HDNS_RR_TYPE_A);
+    shared_entry = hdns_cache_table_get(reader_cache, "k1.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && shared_entry == NULL;
+
+    // IP数超出定长字段的条目不写入共享内存，不会被截断后共享
+    entry = create_test_cache_entry(writer_cache, "k2.com", 60);
+    for (int i = 0; i <= HDNS_SHM_CACHE_MAX_IPS; i++) {
+        hdns_list_add(entry->ips, apr_psprintf(pool, "1.1.1.%d", i), hdns_to_list_clone_fn_t(apr_pstrdup));
+    }
+    hdns_cache_table_add(writer_cache, entry);
+    shared_entry = hdns_cache_table_get(reader_cache, "k2.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && shared_entry == NULL;
+
+    // 创建方关闭后共享段依然保留，新挂载的进程可以读到之前写入的条目
+    entry = create_test_cache_entry(writer_cache, "k3.com", 60);
+    hdns_list_add(entry->ips, "3.3.3.3", hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(writer_cache, entry);
+    hdns_cache_table_cleanup(writer_cache);
+    hdns_cache_t *late_cache = hdns_cache_table_create();
+    hdns_cache_table_attach_shm(late_cache, hdns_shm_cache_open(shm_file, 0));
+    shared_entry = hdns_cache_table_get(late_cache, "k3.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && shared_entry != NULL;
+    hdns_resv_resp_destroy(shared_entry);
+
+    // 清空本进程缓存不影响共享段
+    hdns_cache_table_clean(late_cache);
+    shared_entry = hdns_cache_table_get(reader_cache, "k3.com", HDNS_RR_TYPE_A);
+    is_expected = is_expected && shared_entry != NULL;
+    hdns_resv_resp_destroy(shared_entry);
+
+    hdns_cache_table_cleanup(late_cache);
+    hdns_cache_table_cleanup(reader_cache);
+    apr_shm_remove(shm_file, pool);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_shm_cache failed", is_expected);
+}
+
 void test_clean_cache(CuTest *tc) {
     hdns_sdk_init();
     hdns_client_t *client = hdns_client_create(HDNS_TEST_ACCOUNT, HDNS_TEST_SECRET_KEY);
@@ -95,4 +871,25 @@ void add_hdns_cache_tests(CuSuite *suite) {
     SUITE_ADD_TEST(suite, test_hit_cache);
     SUITE_ADD_TEST(suite, test_delete_cache_entry);
     SUITE_ADD_TEST(suite, test_update_cache_entry);
+    SUITE_ADD_TEST(suite, test_shared_cache_entry);
+    SUITE_ADD_TEST(suite, test_cache_get_both);
+    SUITE_ADD_TEST(suite, test_cache_lru_eviction);
+    SUITE_ADD_TEST(suite, test_cache_entry_prefetch);
+    SUITE_ADD_TEST(suite, test_cache_negative_entry);
+    SUITE_ADD_TEST(suite, test_cache_timer_wheel_expiry);
+    SUITE_ADD_TEST(suite, test_cache_virtual_clock);
+    SUITE_ADD_TEST(suite, test_cache_stats);
+    SUITE_ADD_TEST(suite, test_cache_entry_sockaddrs);
+    SUITE_ADD_TEST(suite, test_cache_slab_entry);
+    SUITE_ADD_TEST(suite, test_cache_scratch);
+    SUITE_ADD_TEST(suite, test_cache_batch);
+    SUITE_ADD_TEST(suite, test_cache_key_cursor);
+    SUITE_ADD_TEST(suite, test_cache_hot_keys);
+    SUITE_ADD_TEST(suite, test_cache_local);
+#if !defined(_WIN32)
+    SUITE_ADD_TEST(suite, test_cache_subscriber_owner);
+    SUITE_ADD_TEST(suite, test_cache_subscriber_unsubscribe);
+    SUITE_ADD_TEST(suite, test_cache_subscriber_unsubscribe_owner);
+    SUITE_ADD_TEST(suite, test_shm_cache);
+#endif
 }
\ No newline at end of file
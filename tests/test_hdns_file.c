@@ -41,8 +41,27 @@ void test_file_read(CuTest *tc) {
     CuAssert(tc, "test_file_read failed", is_not_blank);
 }
 
+void test_file_write_atomic(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    char *dir = apr_pstrcat(pool, hdns_get_user_home_dir(pool), "/.httpdns/", NULL);
+    hdns_file_create_dir(dir);
+    char *target_file_path = apr_pstrcat(pool, dir, "/atomic.json", NULL);
+    apr_file_remove(target_file_path, pool);
+    // 目标文件已存在时整体替换
+    int32_t ret = hdns_file_write_atomic(target_file_path, "{\"hello\":123}");
+    ret = ret == HDNS_OK ? hdns_file_write_atomic(target_file_path, "{\"hello\":456}") : ret;
+    char *content = hdns_file_read(target_file_path, pool);
+    bool is_expected = ret == HDNS_OK && content != NULL && strcmp(content, "{\"hello\":456}") == 0;
+    apr_file_remove(target_file_path, pool);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_file_write_atomic failed", is_expected);
+}
+
 
 void add_hdns_file_tests(CuSuite *suite) {
     SUITE_ADD_TEST(suite, test_file_write);
     SUITE_ADD_TEST(suite, test_file_read);
+    SUITE_ADD_TEST(suite, test_file_write_atomic);
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include <apr_atomic.h>
+#include <apr_thread_proc.h>
+
+#include "hdns_flight.h"
+#include "test_suit_list.h"
+
+typedef struct {
+    hdns_flight_group_t *group;
+    hdns_flight_t *flight;
+    hdns_status_t status;
+} flight_waiter_t;
+
+static void *APR_THREAD_FUNC wait_flight_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    flight_waiter_t *waiter = data;
+    waiter->status = hdns_flight_wait(waiter->group, waiter->flight, 5 * APR_USEC_PER_SEC);
+    return NULL;
+}
+
+static void count_flight_callback(hdns_status_t *status, void *param) {
+    if (hdns_status_is_ok(status)) {
+        apr_atomic_inc32(param);
+    }
+}
+
+static bool wait_callback_count(volatile apr_uint32_t *count, apr_uint32_t expected) {
+    for (int i = 0; i < 500 && apr_atomic_read32(count) < expected; i++) {
+        apr_sleep(10 * 1000);
+    }
+    return apr_atomic_read32(count) == expected;
+}
+
+void test_flight_coalesce(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    apr_thread_pool_t *thread_pool = NULL;
+    apr_thread_pool_create(&thread_pool, 1, 1, pool);
+    hdns_flight_group_t *group = hdns_flight_group_create(thread_pool);
+
+    hdns_flight_t *leader = NULL;
+    hdns_flight_t *flight = NULL;
+    bool is_expected = hdns_flight_join(group, "www.aliyun.com|1", &leader);
+    // 相同键的请求合并，不同键的请求互不影响
+    is_expected = is_expected && !hdns_flight_join(group, "www.aliyun.com|1", &flight) && flight == leader;
+    hdns_flight_t *other = NULL;
+    is_expected = is_expected && hdns_flight_join(group, "www.aliyun.com|2", &other) && other != leader;
+
+    flight_waiter_t waiter = {group, flight, hdns_status_ok(NULL)};
+    apr_thread_t *thread = NULL;
+    apr_thread_create(&thread, NULL, wait_flight_task, &waiter, pool);
+
+    volatile apr_uint32_t callback_count = 0;
+    hdns_flight_t *attached = NULL;
+    hdns_status_t status;
+    hdns_flight_join(group, "www.aliyun.com|1", &attached);
+    is_expected = is_expected
+                  && hdns_flight_attach(group, attached, count_flight_callback, (void *) &callback_count, NULL, &status)
+                  && apr_atomic_read32(&callback_count) == 0;
+
+    hdns_status_t result = hdns_status_error(HDNS_RESOLVE_FAIL, HDNS_RESOLVE_FAIL_CODE, "leader failed", NULL);
+    hdns_flight_finish(group, leader, &result);
+    apr_status_t thread_status;
+    apr_thread_join(&thread_status, thread);
+    // 等待方收到发起方的结果，挂载的回调收到失败结果
+    is_expected = is_expected
+                  && waiter.status.code == HDNS_RESOLVE_FAIL
+                  && apr_atomic_read32(&callback_count) == 0;
+
+    hdns_flight_t *late = NULL;
+    hdns_flight_join(group, "www.aliyun.com|2", &late);
+    hdns_status_t ok = hdns_status_ok(NULL);
+    hdns_flight_finish(group, other, &ok);
+    // 请求已完成时挂载失败，直接返回结果
+    is_expected = is_expected
+                  && !hdns_flight_attach(group, late, count_flight_callback, (void *) &callback_count, NULL, &status)
+                  && hdns_status_is_ok(&status);
+
+    // 完成后再次加入时重新发起请求
+    is_expected = is_expected && hdns_flight_join(group, "www.aliyun.com|1", &leader);
+    hdns_flight_join(group, "www.aliyun.com|1", &attached);
+    hdns_flight_attach(group, attached, count_flight_callback, (void *) &callback_count, NULL, &status);
+    hdns_flight_finish(group, leader, &ok);
+    // 挂载的回调在线程池中执行
+    is_expected = is_expected && wait_callback_count(&callback_count, 1);
+
+    apr_thread_pool_destroy(thread_pool);
+    hdns_flight_group_cleanup(group);
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_flight_coalesce failed", is_expected);
+}
+
+void test_flight_wait_timeout(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_flight_group_t *group = hdns_flight_group_create(NULL);
+
+    hdns_flight_t *leader = NULL;
+    hdns_flight_t *flight = NULL;
+    hdns_flight_join(group, "www.aliyun.com|1", &leader);
+    hdns_flight_join(group, "www.aliyun.com|1", &flight);
+    hdns_status_t status = hdns_flight_wait(group, flight, 10 * 1000);
+    bool is_expected = status.code == HDNS_RESOLVE_FAIL;
+
+    // 等待方超时退出后，发起方仍可正常完成
+    hdns_status_t ok = hdns_status_ok(NULL);
+    hdns_flight_finish(group, leader, &ok);
+    is_expected = is_expected && hdns_flight_join(group, "www.aliyun.com|1", &leader);
+    hdns_flight_finish(group, leader, &ok);
+
+    hdns_flight_group_cleanup(group);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_flight_wait_timeout failed", is_expected);
+}
+
+static void count_failed_flight_callback(hdns_status_t *status, void *param) {
+    if (!hdns_status_is_ok(status)) {
+        apr_atomic_inc32(param);
+    }
+}
+
+typedef struct {
+    hdns_flight_group_t *group;
+    volatile apr_uint32_t cleaned;
+} flight_cleanup_record_t;
+
+static void *APR_THREAD_FUNC cleanup_flight_group_task(apr_thread_t *thread, void *data) {
+    hdns_unused_var(thread);
+    flight_cleanup_record_t *record = data;
+    hdns_flight_group_cleanup(record->group);
+    apr_atomic_set32(&record->cleaned, 1);
+    return NULL;
+}
+
+void test_flight_cancel_and_drain(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_flight_group_t *group = hdns_flight_group_create(NULL);
+    int owner1 = 0;
+    int owner2 = 0;
+
+    hdns_flight_t *leader = NULL;
+    hdns_flight_t *attached = NULL;
+    hdns_status_t status;
+    volatile apr_uint32_t ok_count = 0;
+    volatile apr_uint32_t failed_count = 0;
+    hdns_flight_join(group, "www.aliyun.com|1", &leader);
+    hdns_flight_join(group, "www.aliyun.com|1", &attached);
+    hdns_flight_attach(group, attached, count_failed_flight_callback, (void *) &failed_count, &owner1, &status);
+    hdns_flight_join(group, "www.aliyun.com|1", &attached);
+    hdns_flight_attach(group, attached, count_flight_callback, (void *) &ok_count, &owner2, &status);
+    // 只取消指定属主尚未执行的回调，并以失败状态执行
+    hdns_flight_group_cancel(group, &owner1);
+    bool is_expected = apr_atomic_read32(&failed_count) == 1 && apr_atomic_read32(&ok_count) == 0;
+
+    // 请求进行中时释放会等待发起方完成
+    flight_cleanup_record_t record = {group, 0};
+    apr_thread_t *thread = NULL;
+    apr_thread_create(&thread, NULL, cleanup_flight_group_task, &record, pool);
+    apr_sleep(50 * 1000);
+    is_expected = is_expected && apr_atomic_read32(&record.cleaned) == 0;
+    hdns_status_t ok = hdns_status_ok(NULL);
+    hdns_flight_finish(group, leader, &ok);
+    apr_status_t thread_status;
+    apr_thread_join(&thread_status, thread);
+    is_expected = is_expected
+                  && apr_atomic_read32(&record.cleaned) == 1
+                  && apr_atomic_read32(&failed_count) == 1
+                  && apr_atomic_read32(&ok_count) == 1;
+
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_flight_cancel_and_drain failed", is_expected);
+}
+
+void add_hdns_flight_tests(CuSuite *suite) {
+    SUITE_ADD_TEST(suite, test_flight_coalesce);
+    SUITE_ADD_TEST(suite, test_flight_wait_timeout);
+    SUITE_ADD_TEST(suite, test_flight_cancel_and_drain);
+}
@@ -0,0 +1,87 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include "hdns_host_rule.h"
+#include "hdns_config.h"
+#include "test_suit_list.h"
+
+static void add_rule(hdns_pool_t *pool, hdns_hash_t *items, const char *host, int32_t value) {
+    int32_t *value_pr = hdns_palloc(pool, sizeof(int32_t));
+    *value_pr = value;
+    apr_hash_set(items, host, APR_HASH_KEY_STRING, value_pr);
+}
+
+static bool match_value(const hdns_host_rules_t *rules, const char *host, int32_t expected) {
+    int32_t value = -1;
+    return hdns_host_rules_match(rules, host, &value) && value == expected;
+}
+
+void test_host_rules_match(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_hash_t *items = apr_hash_make(pool);
+    add_rule(pool, items, "*.example.com", 1);
+    add_rule(pool, items, "*.cdn.example.com", 2);
+    add_rule(pool, items, "static.cdn.example.com", 3);
+    add_rule(pool, items, "www.aliyun.com", 4);
+    hdns_host_rules_t *rules = hdns_host_rules_compile(pool, items);
+
+    int32_t value;
+    bool is_expected = match_value(rules, "www.example.com", 1)
+                       // 最长的通配后缀优先
+                       && match_value(rules, "img.cdn.example.com", 2)
+                       && match_value(rules, "a.b.cdn.example.com", 2)
+                       // 完全匹配优先于通配
+                       && match_value(rules, "static.cdn.example.com", 3)
+                       && match_value(rules, "cdn.example.com", 1)
+                       && match_value(rules, "www.aliyun.com", 4)
+                       // 通配规则不匹配后缀本身
+                       && !hdns_host_rules_match(rules, "example.com", &value)
+                       && !hdns_host_rules_match(rules, "aliyun.com", &value)
+                       && !hdns_host_rules_match(rules, "m.www.aliyun.com", &value)
+                       && !hdns_host_rules_match(rules, "www.example.org", &value);
+
+    hdns_host_rules_t *empty_rules = hdns_host_rules_compile(pool, apr_hash_make(pool));
+    is_expected = is_expected && !hdns_host_rules_match(empty_rules, "www.example.com", &value);
+
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_host_rules_match failed", is_expected);
+}
+
+void test_host_rules_recompile(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_config_t *config = hdns_config_create();
+    hdns_config_add_custom_ttl_rule(config, "*.example.com", 60);
+    const hdns_host_rules_t *old_rules = hdns_config_get_custom_ttl_rules(config);
+    // 未变化时复用已编译的规则树
+    bool is_expected = old_rules == hdns_config_get_custom_ttl_rules(config)
+                       && match_value(old_rules, "www.example.com", 60);
+
+    // 规则变化后旧规则树暂时保留，正在使用的读取方仍可访问
+    hdns_config_add_custom_ttl_rule(config, "www.example.com", 120);
+    const hdns_host_rules_t *rules = hdns_config_get_custom_ttl_rules(config);
+    is_expected = is_expected
+                  && match_value(rules, "www.example.com", 120)
+                  && match_value(rules, "img.example.com", 60)
+                  && match_value(old_rules, "www.example.com", 60)
+                  && hdns_list_size(config->retired_rules) == 1;
+
+    // 旧规则树不按时间释放，保留到配置释放，之前取得的规则树均可访问
+    hdns_config_add_custom_ttl_rule(config, "img.example.com", 180);
+    is_expected = is_expected
+                  && match_value(rules, "img.example.com", 60)
+                  && match_value(old_rules, "www.example.com", 60)
+                  && match_value(hdns_config_get_custom_ttl_rules(config), "img.example.com", 180)
+                  && hdns_list_size(config->retired_rules) == 2;
+
+    hdns_config_cleanup(config);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_host_rules_recompile failed", is_expected);
+}
+
+void add_hdns_host_rule_tests(CuSuite *suite) {
+    SUITE_ADD_TEST(suite, test_host_rules_match);
+    SUITE_ADD_TEST(suite, test_host_rules_recompile);
+}
@@ -0,0 +1,98 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include "hdns_htable.h"
+#include "test_suit_list.h"
+
+#define TEST_HTABLE_KEY_COUNT 10000
+
+static char **create_test_keys(hdns_pool_t *pool, int count) {
+    char **keys = hdns_palloc(pool, count * sizeof(char *));
+    for (int i = 0; i < count; i++) {
+        keys[i] = apr_psprintf(pool, "host-%d.example.com", i);
+    }
+    return keys;
+}
+
+static int count_callback_fn(void *rec, const char *key, size_t klen, void *value) {
+    hdns_unused_var(key);
+    hdns_unused_var(klen);
+    hdns_unused_var(value);
+    (*(int *) rec)++;
+    return 1;
+}
+
+void test_htable_set_get(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_htable_t *ht = hdns_htable_make(pool);
+    char **keys = create_test_keys(pool, TEST_HTABLE_KEY_COUNT);
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT; i++) {
+        hdns_htable_set(ht, keys[i], keys[i]);
+    }
+    bool is_expected = hdns_htable_count(ht) == TEST_HTABLE_KEY_COUNT;
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT && is_expected; i++) {
+        // 使用不同地址的相同内容查找
+        char *key = apr_pstrdup(pool, keys[i]);
+        is_expected = hdns_htable_get(ht, key) == keys[i];
+    }
+    is_expected = is_expected && hdns_htable_get(ht, "missing.example.com") == NULL;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_htable_set_get failed", is_expected);
+}
+
+void test_htable_replace(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_htable_t *ht = hdns_htable_make(pool);
+    char *old_value = "old";
+    char *new_value = "new";
+    void *replaced1 = hdns_htable_set(ht, "k1.com", old_value);
+    void *replaced2 = hdns_htable_set(ht, "k1.com", new_value);
+    bool is_expected = replaced1 == NULL
+                       && replaced2 == old_value
+                       && hdns_htable_get(ht, "k1.com") == new_value
+                       && hdns_htable_count(ht) == 1;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_htable_replace failed", is_expected);
+}
+
+void test_htable_remove(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_htable_t *ht = hdns_htable_make(pool);
+    char **keys = create_test_keys(pool, TEST_HTABLE_KEY_COUNT);
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT; i++) {
+        hdns_htable_set(ht, keys[i], keys[i]);
+    }
+    bool is_expected = true;
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT; i += 2) {
+        is_expected = is_expected && hdns_htable_remove(ht, keys[i]) == keys[i];
+    }
+    is_expected = is_expected && hdns_htable_count(ht) == TEST_HTABLE_KEY_COUNT / 2;
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT && is_expected; i++) {
+        void *value = hdns_htable_get(ht, keys[i]);
+        is_expected = (i % 2 == 0) ? value == NULL : value == keys[i];
+    }
+    // 墓碑位置可以被重新写入
+    for (int i = 0; i < TEST_HTABLE_KEY_COUNT; i += 2) {
+        hdns_htable_set(ht, keys[i], keys[i]);
+    }
+    int visited = 0;
+    hdns_htable_do(count_callback_fn, &visited, ht);
+    is_expected = is_expected && visited == TEST_HTABLE_KEY_COUNT && hdns_htable_count(ht) == TEST_HTABLE_KEY_COUNT;
+    hdns_htable_clear(ht);
+    is_expected = is_expected && hdns_htable_count(ht) == 0 && hdns_htable_get(ht, keys[1]) == NULL;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_htable_remove failed", is_expected);
+}
+
+void add_hdns_htable_tests(CuSuite *suite) {
+    SUITE_ADD_TEST(suite, test_htable_set_get);
+    SUITE_ADD_TEST(suite, test_htable_replace);
+    SUITE_ADD_TEST(suite, test_htable_remove);
+}
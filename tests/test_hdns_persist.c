@@ -0,0 +1,85 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+#include "hdns_client.h"
+#include "hdns_persist.h"
+#include "test_suit_list.h"
+
+#define HDNS_TEST_PERSIST_ACCOUNT  "139450-persist-test"
+
+static void add_test_cache_entry(hdns_cache_t *cache, const char *host, const char *ip, apr_time_t query_time) {
+    hdns_resv_resp_t *entry = hdns_resv_resp_create_empty(NULL, host, HDNS_RR_TYPE_A);
+    entry->cache_key = apr_pstrdup(entry->pool, host);
+    entry->query_time = query_time;
+    hdns_list_add(entry->ips, ip, hdns_to_list_clone_fn_t(apr_pstrdup));
+    hdns_cache_table_add(cache, entry);
+    hdns_resv_resp_destroy(entry);
+}
+
+static hdns_persist_t *create_test_persist(hdns_client_t *client) {
+    return hdns_persist_create(client->config, client->cache, client->scheduler, client->thread_pool);
+}
+
+void test_persist_save_and_load(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *origin_client = hdns_client_create(HDNS_TEST_PERSIST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    add_test_cache_entry(origin_client->cache, "www.aliyun.com", "1.1.1.1", hdns_clock_now());
+    // 过期太久的条目不会被恢复
+    add_test_cache_entry(origin_client->cache,
+                         "stale.aliyun.com",
+                         "2.2.2.2",
+                         hdns_clock_now() - apr_time_from_sec(2 * HDNS_PERSIST_MAX_STALE_SEC));
+    hdns_persist_t *origin_persist = create_test_persist(origin_client);
+    int32_t save_ret = hdns_persist_save(origin_persist);
+
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_PERSIST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_persist_t *persist = create_test_persist(client);
+    int32_t load_ret = hdns_persist_load(persist);
+    hdns_resv_resp_t *entry = hdns_cache_table_get(client->cache, "www.aliyun.com", HDNS_RR_TYPE_A);
+    hdns_resv_resp_t *stale_entry = hdns_cache_table_get(client->cache, "stale.aliyun.com", HDNS_RR_TYPE_A);
+    bool is_expected = save_ret == HDNS_OK
+                       && load_ret == HDNS_OK
+                       && entry != NULL
+                       && !hdns_cache_entry_is_expired(entry)
+                       && strcmp(hdns_list_first(entry->ips)->data, "1.1.1.1") == 0
+                       && stale_entry == NULL;
+    hdns_resv_resp_destroy(entry);
+    hdns_resv_resp_destroy(stale_entry);
+    apr_file_remove(persist->file_path, persist->pool);
+
+    hdns_persist_cleanup(origin_persist);
+    hdns_persist_cleanup(persist);
+    hdns_client_cleanup(origin_client);
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_persist_save_and_load failed", is_expected);
+}
+
+void test_persist_ignore_other_region(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_client_t *origin_client = hdns_client_create(HDNS_TEST_PERSIST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    add_test_cache_entry(origin_client->cache, "www.aliyun.com", "1.1.1.1", hdns_clock_now());
+    hdns_persist_t *origin_persist = create_test_persist(origin_client);
+    hdns_persist_save(origin_persist);
+
+    hdns_client_t *client = hdns_client_create(HDNS_TEST_PERSIST_ACCOUNT, HDNS_TEST_SECRET_KEY);
+    hdns_client_set_region(client, "sg");
+    hdns_persist_t *persist = create_test_persist(client);
+    int32_t load_ret = hdns_persist_load(persist);
+    hdns_resv_resp_t *entry = hdns_cache_table_get(client->cache, "www.aliyun.com", HDNS_RR_TYPE_A);
+    bool is_expected = load_ret == HDNS_ERROR && entry == NULL;
+    hdns_resv_resp_destroy(entry);
+    apr_file_remove(persist->file_path, persist->pool);
+
+    hdns_persist_cleanup(origin_persist);
+    hdns_persist_cleanup(persist);
+    hdns_client_cleanup(origin_client);
+    hdns_client_cleanup(client);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_persist_ignore_other_region failed", is_expected);
+}
+
+void add_hdns_persist_tests(CuSuite *suite) {
+    SUITE_ADD_TEST(suite, test_persist_save_and_load);
+    SUITE_ADD_TEST(suite, test_persist_ignore_other_region);
+}
@@ -0,0 +1,82 @@
+//
+// Created by caogaoshuai on 2026/10/17.
+//
+
+#include "hdns_timer_wheel.h"
+#include "test_suit_list.h"
+
+#define TEST_TIMER_COUNT 1000
+
+typedef struct {
+    uint64_t now;
+    int fired;
+    // 到期时间早于推进位置的节点数，应为0
+    int early;
+} test_timer_wheel_param_t;
+
+static void count_expired_fn(void *arg, hdns_timer_wheel_node_t *node) {
+    test_timer_wheel_param_t *param = arg;
+    param->fired++;
+    if (node->expire_tick > param->now) {
+        param->early++;
+    }
+}
+
+static void advance_by_tick(hdns_timer_wheel_t *wheel, test_timer_wheel_param_t *param, uint64_t to_tick) {
+    while (param->now < to_tick) {
+        param->now++;
+        hdns_timer_wheel_advance(wheel, param->now, count_expired_fn, param);
+    }
+}
+
+void test_timer_wheel_expire(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_timer_wheel_t *wheel = hdns_timer_wheel_create(pool, 100);
+    hdns_timer_wheel_node_t *nodes = hdns_pcalloc(pool, TEST_TIMER_COUNT * sizeof(hdns_timer_wheel_node_t));
+    // 到期时间跨越多层，覆盖逐级下放
+    for (int i = 0; i < TEST_TIMER_COUNT; i++) {
+        hdns_timer_wheel_add(wheel, &nodes[i], 100 + (uint64_t) i * 37);
+    }
+    test_timer_wheel_param_t param = {99, 0, 0};
+    advance_by_tick(wheel, &param, 100 + (TEST_TIMER_COUNT - 1) * 37 - 1);
+    bool is_expected = param.fired == TEST_TIMER_COUNT - 1 && param.early == 0 && wheel->count == 1;
+    advance_by_tick(wheel, &param, 100 + (TEST_TIMER_COUNT - 1) * 37);
+    is_expected = is_expected && param.fired == TEST_TIMER_COUNT && wheel->count == 0;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_timer_wheel_expire failed", is_expected);
+}
+
+void test_timer_wheel_remove(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    hdns_timer_wheel_t *wheel = hdns_timer_wheel_create(pool, 0);
+    hdns_timer_wheel_node_t near_node = {0};
+    hdns_timer_wheel_node_t far_node = {0};
+    hdns_timer_wheel_node_t past_node = {0};
+    hdns_timer_wheel_add(wheel, &near_node, 10);
+    hdns_timer_wheel_add(wheel, &far_node, 100000);
+    hdns_timer_wheel_remove(wheel, &near_node);
+    hdns_timer_wheel_remove(wheel, &near_node);
+    bool is_expected = !hdns_timer_wheel_node_is_linked(&near_node) && wheel->count == 1;
+
+    // 一次推进跨越较长时间，跳过的tick同样会触发
+    test_timer_wheel_param_t param = {200000, 0, 0};
+    hdns_timer_wheel_advance(wheel, param.now, count_expired_fn, &param);
+    is_expected = is_expected && param.fired == 1 && param.early == 0 && wheel->count == 0;
+
+    // 早于当前位置加入的节点在下一次推进时到期
+    hdns_timer_wheel_add(wheel, &past_node, 5);
+    param.now++;
+    hdns_timer_wheel_advance(wheel, param.now, count_expired_fn, &param);
+    is_expected = is_expected && param.fired == 2;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_timer_wheel_remove failed", is_expected);
+}
+
+void add_hdns_timer_wheel_tests(CuSuite *suite) {
+    SUITE_ADD_TEST(suite, test_timer_wheel_expire);
+    SUITE_ADD_TEST(suite, test_timer_wheel_remove);
+}
@@ -41,10 +41,47 @@ void test_hdns_encode_hex(CuTest *tc) {
     CuAssert(tc, "test_hdns_encode_hex failed", success);
 }
 
+void test_hdns_canonicalize_host(CuTest *tc) {
+    char host1[] = "WWW.Example.com.";
+    char host2[] = "Mixed-CASE.Sub.Domain.EXAMPLE.Org";
+    char host3[] = ".";
+    char host4[300];
+    memset(host4, 'a', sizeof(host4) - 1);
+    host4[sizeof(host4) - 1] = '\0';
+    // 非ASCII字节保持不变，同组的ASCII字节逐个转换
+    char host5[] = "ABC\xc3\x84" "DEFGH.com";
+    bool success = hdns_canonicalize_host(host1) == HDNS_OK && strcmp(host1, "www.example.com") == 0
+                   && hdns_canonicalize_host(host2) == HDNS_OK
+                   && strcmp(host2, "mixed-case.sub.domain.example.org") == 0
+                   && hdns_canonicalize_host(host3) == HDNS_INVALID_ARGUMENT
+                   && hdns_canonicalize_host(host4) == HDNS_INVALID_ARGUMENT
+                   && hdns_canonicalize_host(host5) == HDNS_OK && strcmp(host5, "abc\xc3\x84" "defgh.com") == 0
+                   && hdns_is_ip_literal("1.1.1.1")
+                   && hdns_is_ip_literal("2001:db8::1")
+                   && !hdns_is_ip_literal("www.aliyun.com");
+    CuAssert(tc, "test_hdns_canonicalize_host failed", success);
+}
+
+void test_hdns_ip_to_subnet(CuTest *tc) {
+    hdns_sdk_init();
+    hdns_pool_new(pool);
+    char *ipv4_subnet = hdns_ip_to_subnet(pool, "1.2.3.4", 24, 56);
+    char *ipv4_subnet_20 = hdns_ip_to_subnet(pool, "10.1.255.4", 20, 56);
+    char *ipv6_subnet = hdns_ip_to_subnet(pool, "2001:db8:1234:5678::1", 24, 56);
+    bool success = ipv4_subnet != NULL && strcmp(ipv4_subnet, "1.2.3.0/24") == 0
+                   && ipv4_subnet_20 != NULL && strcmp(ipv4_subnet_20, "10.1.240.0/20") == 0
+                   && ipv6_subnet != NULL && strcmp(ipv6_subnet, "2001:db8:1234:5600::/56") == 0
+                   && hdns_ip_to_subnet(pool, "www.aliyun.com", 24, 56) == NULL;
+    hdns_pool_destroy(pool);
+    hdns_sdk_cleanup();
+    CuAssert(tc, "test_hdns_ip_to_subnet failed", success);
+}
 
 void add_hdns_utils_tests(CuSuite *suite) {
     SUITE_ADD_TEST(suite, test_hdns_is_valid_ipv4);
     SUITE_ADD_TEST(suite, test_hdns_is_valid_ipv6);
     SUITE_ADD_TEST(suite, test_hdns_md5);
     SUITE_ADD_TEST(suite, test_hdns_encode_hex);
+    SUITE_ADD_TEST(suite, test_hdns_canonicalize_host);
+    SUITE_ADD_TEST(suite, test_hdns_ip_to_subnet);
 }
\ No newline at end of file
@@ -37,5 +37,15 @@ void add_hdns_file_tests(CuSuite *suite);
 
 void add_hdns_utils_tests(CuSuite *suite);
 
+void add_hdns_htable_tests(CuSuite *suite);
+
+void add_hdns_persist_tests(CuSuite *suite);
+
+void add_hdns_timer_wheel_tests(CuSuite *suite);
+
+void add_hdns_host_rule_tests(CuSuite *suite);
+
+void add_hdns_flight_tests(CuSuite *suite);
+
 
 #endif
@@ -21,6 +21,11 @@ int main(void) {
     add_hdns_thread_safe_tests(suite);
     add_hdns_file_tests(suite);
     add_hdns_utils_tests(suite);
+    add_hdns_htable_tests(suite);
+    add_hdns_persist_tests(suite);
+    add_hdns_timer_wheel_tests(suite);
+    add_hdns_host_rule_tests(suite);
+    add_hdns_flight_tests(suite);
 
     CuSuiteRun(suite);
     CuSuiteSummary(suite, output);